@@ -14,6 +14,7 @@ uniform float fogEnd;
 in GS_OUT {
 	flat int texId;
 	flat vec3 normal;
+	flat float brightness;
 	vec3 cameraCoords;
 	vec2 vertexUV;
 } fs_in;
@@ -26,7 +27,7 @@ void main() {
 	if(fragColor.a == 0) discard;
 	
 	float light = ambientLight + diffuseLight*max(dot(lightSrcDir, fs_in.normal), 0);
-	fragColor.rgb *= min(light, 1);
+	fragColor.rgb *= min(light, 1) * fs_in.brightness;
 	
 	if(applyFog) {
 		float dist = length(fs_in.cameraCoords);
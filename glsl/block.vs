@@ -2,15 +2,32 @@
 
 layout(location = 0) in uvec3 attrPos;
 layout(location = 1) in int attrSide;
-layout(location = 2) in int attrTexId;
+layout(location = 2) in uvec2 attrSize;
+layout(location = 3) in uvec2 attrLight; // sky light, block light
+layout(location = 4) in int attrTexId;
+
+// Faces stored in the chunk arena are positioned relative to the origin of their chunk
+uniform bool useChunkOrigins;
+uniform isamplerBuffer chunkOrigins;
+uniform int originBlockSize;
 
 out VS_OUT {
 	int side;
+	vec2 size;
+	float brightness;
 	int texId;
 } vs_out;
 
 void main() {;
-	gl_Position = vec4(attrPos, 1.0);
+	vec3 pos = vec3(attrPos);
+	if(useChunkOrigins) {
+		ivec2 origin = texelFetch(chunkOrigins, gl_VertexID / originBlockSize).xy;
+		pos += vec3(origin.x, 0.0, origin.y);
+	}
+	gl_Position = vec4(pos, 1.0);
 	vs_out.side = attrSide;
+	vs_out.size = vec2(attrSize);
+	// Each light level is 80% as bright as the one above, and blocks in the dark stay faintly visible
+	vs_out.brightness = 0.05 + 0.95 * pow(0.8, 15.0 - float(max(attrLight.x, attrLight.y)));
 	vs_out.texId = attrTexId;
 }
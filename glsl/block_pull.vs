@@ -0,0 +1,57 @@
+#version 330 core
+
+// Alternative to block.vs + block.gs: the faces are read from the chunk arena through a texture buffer,
+// and each one is drawn as two indexed triangles, without a geometry shader.
+
+uniform mat4 model;
+uniform bool applyView;
+uniform mat4 view;
+
+uniform mat4 proj;
+uniform mat3 sideTransforms[6];
+
+uniform usamplerBuffer faceData; // the arena as 16-bit words, 6 per face
+uniform isamplerBuffer chunkOrigins;
+uniform int originBlockSize;
+
+out GS_OUT {
+	flat int texId;
+	flat vec3 normal;
+	flat float brightness;
+	vec3 cameraCoords;
+	vec2 vertexUV;
+} vs_out;
+
+void main() {
+	// The corners of each face are numbered like block.gs emits them
+	int face = gl_VertexID / 4;
+	vec2 corner = vec2(gl_VertexID % 2, (gl_VertexID / 2) % 2);
+	
+	// FaceData layout: offsetX, offsetY, offsetZ, side, width, height, skyLight, blockLight (8 bits each), texId (32 bits)
+	uint word0 = texelFetch(faceData, 6*face).r;
+	uint word1 = texelFetch(faceData, 6*face + 1).r;
+	uint word2 = texelFetch(faceData, 6*face + 2).r;
+	uint word3 = texelFetch(faceData, 6*face + 3).r;
+	uint word4 = texelFetch(faceData, 6*face + 4).r;
+	uint word5 = texelFetch(faceData, 6*face + 5).r;
+	vec3 offset = vec3(word0 & 0xFFu, word0 >> 8, word1 & 0xFFu);
+	int side = int(word1 >> 8);
+	vec2 size = vec2(word2 & 0xFFu, word2 >> 8);
+	uint light = max(word3 & 0xFFu, word3 >> 8);
+	
+	ivec2 origin = texelFetch(chunkOrigins, face / originBlockSize).xy;
+	offset += vec3(origin.x, 0.0, origin.y);
+	
+	mat3 sideTransform = sideTransforms[side];
+	vs_out.texId = int(word4 | (word5 << 16));
+	vs_out.brightness = 0.05 + 0.95 * pow(0.8, 15.0 - float(light)); // same as block.vs
+	vs_out.normal = normalize(mat3(model) * sideTransform * vec3(0, 0, 1));
+	if(!applyView) vs_out.normal = mat3(inverse(view)) * vs_out.normal;
+	
+	vec4 cameraCoords = model * vec4(offset + sideTransform * vec3(corner*size - 0.5, 0.5), 1.0);
+	if(applyView)
+		cameraCoords = view * cameraCoords;
+	vs_out.cameraCoords = vec3(cameraCoords);
+	gl_Position = proj * cameraCoords;
+	vs_out.vertexUV = corner * size; // the texture repeats across merged faces
+}
@@ -12,6 +12,7 @@ with open("src/pixcraft/client/shaders_src.cpp", "w") as out:
 	include("glsl/block.vs", "blockVS")
 	include("glsl/block.gs", "blockGS")
 	include("glsl/block.fs", "blockFS")
+	include("glsl/block_pull.vs", "blockPullVS")
 	
 	include("glsl/entity.vs", "entityVS")
 	include("glsl/entity.fs", "entityFS")
@@ -0,0 +1,454 @@
+// Microbenchmarks of the engine's hot paths, built and run by "make bench".
+// Usage: pixcraft_bench [results.json] [name filter]
+// Everything runs on fixed seeds, so that the checksums of the results match between runs and builds;
+// a changed checksum means the benchmark didn't do the same work.
+// Meshing is first checked on small hand-built shapes, and the program exits with 1 if it is wrong.
+
+#include <cstdint>
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <memory>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <functional>
+#include <tuple>
+
+#include "pixcraft/util/glm.hpp"
+#include "pixcraft/util/random.hpp"
+#include "pixcraft/util/pairing_heap.hpp"
+#include "pixcraft/util/version.hpp"
+#include "pixcraft/server/world.hpp"
+#include "pixcraft/server/worldgen.hpp"
+#include "pixcraft/server/chunk.hpp"
+#include "pixcraft/server/blocks.hpp"
+#include "pixcraft/server/mob.hpp"
+#include "pixcraft/server/player.hpp"
+#include "pixcraft/client/chunk_mesher.hpp"
+#include "pixcraft/client/block_textures.hpp"
+#include "pixcraft/client/view_frustum.hpp"
+
+using namespace PixCraft;
+
+#define BENCH_SEED 1234
+#define BENCH_REPETITIONS 7 // timed runs of each benchmark, after one warm-up run
+#define BENCH_WORLD_FILE "bench_world.bin"
+
+namespace {
+	typedef std::chrono::steady_clock Clock;
+	
+	struct BenchResult {
+		std::string name;
+		size_t opsPerRun;
+		std::vector<double> runNs; // duration of each timed run, sorted
+		uint64_t checksum;
+	};
+	
+	// Times run, which does opsPerRun operations and returns a checksum of their results;
+	// using the results keeps the compiler from optimizing the work out.
+	BenchResult measure(const char* name, size_t opsPerRun, std::function<uint64_t()> run) {
+		BenchResult result { name, opsPerRun, {}, run() };
+		for(int i = 0; i < BENCH_REPETITIONS; ++i) {
+			auto start = Clock::now();
+			uint64_t checksum = run();
+			std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+			result.runNs.push_back(elapsed.count());
+			if(checksum != result.checksum) std::cerr << name << ": results differ between runs" << std::endl;
+		}
+		std::sort(result.runNs.begin(), result.runNs.end());
+		return result;
+	}
+	
+	std::unique_ptr<World> makeWorld(int32_t minChunk, int32_t maxChunk) {
+		std::unique_ptr<World> world(new World(BENCH_SEED));
+		for(int32_t chunkX = minChunk; chunkX <= maxChunk; ++chunkX) {
+			for(int32_t chunkZ = minChunk; chunkZ <= maxChunk; ++chunkZ) {
+				world->genChunk(chunkX, chunkZ);
+			}
+		}
+		return world;
+	}
+	
+	BenchResult benchChunkGetSet() {
+		const size_t COUNT = 1 << 16;
+		const BlockId ids[4] = { 0, BlockRegistry::STONE_ID, BlockRegistry::DIRT_ID, BlockRegistry::PLANKS_ID };
+		std::unique_ptr<Chunk> chunk(new Chunk());
+		std::mt19937 random(BENCH_SEED);
+		std::vector<glm::ivec3> positions;
+		std::vector<BlockId> values;
+		for(size_t i = 0; i < COUNT; ++i) {
+			positions.emplace_back(random() % CHUNK_SIZE, random() % CHUNK_HEIGHT, random() % CHUNK_SIZE);
+			values.push_back(ids[random() % 4]);
+		}
+		
+		return measure("chunk_get_set", 2*COUNT, [&]() {
+			for(size_t i = 0; i < COUNT; ++i) {
+				chunk->setBlockId(positions[i].x, positions[i].y, positions[i].z, values[i], values[i] != 0);
+			}
+			uint64_t sum = 0;
+			for(size_t i = 0; i < COUNT; ++i) {
+				sum += chunk->getBlockId(positions[i].x, positions[i].y, positions[i].z) * (i + 1);
+			}
+			return sum;
+		});
+	}
+	
+	BenchResult benchWorldGetBlock() {
+		const size_t COUNT = 1 << 16;
+		std::unique_ptr<World> world = makeWorld(-2, 1);
+		// Consecutive queries alternate between the two sides of a chunk border
+		std::mt19937 random(BENCH_SEED);
+		std::vector<glm::ivec3> positions;
+		for(size_t i = 0; i < COUNT; ++i) {
+			int32_t border = CHUNK_SIZE * ((int32_t) (random() % 3) - 1) - (int32_t) (i % 2);
+			int32_t other = (int32_t) (random() % (4*CHUNK_SIZE)) - 2*CHUNK_SIZE;
+			int32_t y = random() % CHUNK_HEIGHT;
+			if(random() % 2 == 0) {
+				positions.emplace_back(border, y, other);
+			} else {
+				positions.emplace_back(other, y, border);
+			}
+		}
+		
+		return measure("world_get_block_borders", COUNT, [&]() {
+			uint64_t sum = 0;
+			for(size_t i = 0; i < COUNT; ++i) {
+				Block* block = world->getBlock(positions[i].x, positions[i].y, positions[i].z);
+				if(block != nullptr) sum += block->id() * (i + 1);
+			}
+			return sum;
+		});
+	}
+	
+	std::vector<RaycastQuery> makeRaycastQueries(size_t count) {
+		std::mt19937 random(BENCH_SEED);
+		std::uniform_real_distribution<float> horizontal(-3.0f*CHUNK_SIZE, 3.0f*CHUNK_SIZE);
+		std::uniform_real_distribution<float> height(35.0f, 55.0f);
+		std::normal_distribution<float> direction;
+		std::vector<RaycastQuery> queries;
+		for(size_t i = 0; i < count; ++i) {
+			glm::vec3 pos(horizontal(random), height(random), horizontal(random));
+			glm::vec3 dir = glm::normalize(glm::vec3(direction(random), direction(random), direction(random)));
+			queries.push_back({ pos, dir, 32.0f, false });
+		}
+		return queries;
+	}
+	
+	uint64_t hitChecksum(const RaycastHit& hit) {
+		if(!hit.hit) return 0;
+		return 1 + (uint64_t) ((hit.x * 73856093) ^ (hit.y * 19349663) ^ (hit.z * 83492791) ^ hit.face);
+	}
+	
+	BenchResult benchRaycast() {
+		const size_t COUNT = 4096;
+		std::unique_ptr<World> world = makeWorld(-4, 3);
+		std::vector<RaycastQuery> queries = makeRaycastQueries(COUNT);
+		
+		return measure("world_raycast", COUNT, [&]() {
+			uint64_t sum = 0;
+			for(RaycastQuery& query : queries) {
+				sum += hitChecksum(world->raycast(query.pos, query.dir, query.maxDist, query.hitFluids));
+			}
+			return sum;
+		});
+	}
+	
+	BenchResult benchRaycastBatch() {
+		const size_t COUNT = 4096;
+		std::unique_ptr<World> world = makeWorld(-4, 3);
+		std::vector<RaycastQuery> queries = makeRaycastQueries(COUNT);
+		std::vector<RaycastHit> hits;
+		
+		return measure("world_raycast_batch", COUNT, [&]() {
+			world->raycast(queries, hits);
+			uint64_t sum = 0;
+			for(RaycastHit& hit : hits) sum += hitChecksum(hit);
+			return sum;
+		});
+	}
+	
+	BenchResult benchMeshing() {
+		std::unique_ptr<World> world = makeWorld(-2, 2);
+		std::unique_ptr<ChunkSnapshot> snapshot(new ChunkSnapshot());
+		std::vector<FaceData> faces, translucentFaces;
+		
+		return measure("mesh_chunk", 9, [&]() {
+			uint64_t sum = 0;
+			for(int32_t chunkX = -1; chunkX <= 1; ++chunkX) {
+				for(int32_t chunkZ = -1; chunkZ <= 1; ++chunkZ) {
+					faces.clear();
+					translucentFaces.clear();
+					snapshot->capture(*world, chunkX, chunkZ);
+					meshChunk(*snapshot, faces, translucentFaces);
+					sum = sum * 31 + faces.size() * 1000 + translucentFaces.size();
+				}
+			}
+			return sum;
+		});
+	}
+	
+	// Section-sized boxes around a camera looking along a diagonal, about a quarter of which are in view
+	std::vector<AABB> makeFrustumBoxes(size_t count) {
+		std::mt19937 random(BENCH_SEED);
+		std::uniform_real_distribution<float> coord(-256.0f, 256.0f);
+		std::vector<AABB> boxes;
+		for(size_t i = 0; i < count; ++i) {
+			glm::vec3 min(std::floor(coord(random)), std::floor(coord(random) / 4.0f), std::floor(coord(random)));
+			boxes.push_back({ min, min + glm::vec3(CHUNK_SIZE, SECTION_HEIGHT, CHUNK_SIZE) });
+		}
+		return boxes;
+	}
+	
+	ViewFrustum makeBenchFrustum() {
+		return computeViewFrustum(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 300.0f, glm::vec3(0.0f, 40.0f, 0.0f), glm::vec3(-0.2f, TAU/8, 0.0f));
+	}
+	
+	// Both frustum benchmarks have the same checksum, as the boxes are found visible the same way
+	BenchResult benchTestBox() {
+		const size_t COUNT = 4096;
+		std::vector<AABB> boxes = makeFrustumBoxes(COUNT);
+		ViewFrustum vf = makeBenchFrustum();
+		
+		return measure("frustum_test_box", COUNT, [&]() {
+			uint64_t sum = 0;
+			for(size_t i = 0; i < COUNT; ++i) {
+				if(testBox(vf, boxes[i]) != FrustumTest::outside) sum += i + 1;
+			}
+			return sum;
+		});
+	}
+	
+	BenchResult benchTestBoxes() {
+		const size_t COUNT = 4096;
+		std::vector<AABB> boxes = makeFrustumBoxes(COUNT);
+		std::vector<AABB4> boxes4(COUNT / 4);
+		for(size_t i = 0; i < COUNT; ++i) {
+			AABB4& group = boxes4[i / 4];
+			int lane = i % 4;
+			group.minX[lane] = boxes[i].min.x; group.minY[lane] = boxes[i].min.y; group.minZ[lane] = boxes[i].min.z;
+			group.maxX[lane] = boxes[i].max.x; group.maxY[lane] = boxes[i].max.y; group.maxZ[lane] = boxes[i].max.z;
+		}
+		ViewFrustum vf = makeBenchFrustum();
+		
+		return measure("frustum_test_boxes", COUNT, [&]() {
+			uint64_t sum = 0;
+			for(size_t i = 0; i < COUNT / 4; ++i) {
+				uint8_t visible = testBoxes(vf, boxes4[i]);
+				for(int lane = 0; lane < 4; ++lane) {
+					if(visible & (1 << lane)) sum += 4*i + lane + 1;
+				}
+			}
+			return sum;
+		});
+	}
+	
+	BenchResult benchGenerateChunk() {
+		const int32_t SIDE = 4;
+		WorldGenerator gen(BENCH_SEED);
+		
+		return measure("generate_chunk", SIDE*SIDE, [&]() {
+			uint64_t sum = 0;
+			for(int32_t chunkX = 0; chunkX < SIDE; ++chunkX) {
+				for(int32_t chunkZ = 0; chunkZ < SIDE; ++chunkZ) {
+					std::unique_ptr<Chunk> chunk(new Chunk());
+					gen.generateChunk(*chunk, chunkX, chunkZ);
+					for(uint8_t y = 0; y < CHUNK_HEIGHT; ++y) {
+						sum = sum * 31 + chunk->getBlockId(y % CHUNK_SIZE, y, (y * 7) % CHUNK_SIZE);
+					}
+				}
+			}
+			return sum;
+		});
+	}
+	
+	BenchResult benchDistributeObjects() {
+		const int32_t SIDE = 16;
+		uint64_t seed = getFeatureSeed(BENCH_SEED, FeatureType::trees);
+		
+		return measure("distribute_objects", SIDE*SIDE, [&]() {
+			uint64_t sum = 0;
+			for(int32_t chunkX = 0; chunkX < SIDE; ++chunkX) {
+				for(int32_t chunkZ = 0; chunkZ < SIDE; ++chunkZ) {
+					// Same parameters as the trees in WorldGenerator
+					std::pmr::vector<float> points = distributeObjects(seed, chunkX*CHUNK_SIZE - 0.5, chunkZ*CHUNK_SIZE - 0.5, CHUNK_SIZE, 6, 2.5);
+					for(float coord : points) sum = sum * 31 + (uint64_t) std::lround(coord * 1000);
+				}
+			}
+			return sum;
+		});
+	}
+	
+	BenchResult benchSaveWorld() {
+		std::unique_ptr<World> world = makeWorld(-4, 3);
+		world->mobs.emplace_back(new Player(*world, glm::vec3(8.0f, 50.0f, 8.0f)));
+		
+		// Timed per chunk, of which there are 8x8
+		return measure("save_world", 64, [&]() {
+			world->saveToFile(BENCH_WORLD_FILE);
+			std::ifstream file(BENCH_WORLD_FILE, std::ios::binary | std::ios::ate);
+			return (uint64_t) file.tellg();
+		});
+	}
+	
+	BenchResult benchLoadWorld() {
+		{
+			std::unique_ptr<World> world = makeWorld(-4, 3);
+			world->mobs.emplace_back(new Player(*world, glm::vec3(8.0f, 50.0f, 8.0f)));
+			world->saveToFile(BENCH_WORLD_FILE);
+		}
+		std::unique_ptr<World> world(new World(BENCH_SEED));
+		
+		BenchResult result = measure("load_world", 64, [&]() {
+			world->loadFromFile(BENCH_WORLD_FILE);
+			return (uint64_t) world->loadedChunkCount() * 1000 + world->mobs.size();
+		});
+		std::remove(BENCH_WORLD_FILE);
+		return result;
+	}
+	
+	BenchResult benchPairingHeap() {
+		const size_t COUNT = 1 << 10; // melds copy subheaps, so operations get slow on large heaps
+		std::mt19937 random(BENCH_SEED);
+		std::vector<uint32_t> values;
+		for(size_t i = 0; i < COUNT; ++i) values.push_back(random());
+		
+		return measure("pairing_heap", 2*COUNT, [&]() {
+			PairingHeap<uint32_t> heap;
+			for(uint32_t value : values) heap.insert(value);
+			uint64_t sum = 0;
+			for(size_t i = 0; i < COUNT; ++i) {
+				sum += heap.min() * (i + 1);
+				heap.removeMin();
+			}
+			return sum;
+		});
+	}
+	
+	struct ExpectedFace {
+		uint8_t side;
+		uint8_t width, height;
+		
+		bool operator<(const ExpectedFace& other) const {
+			return std::tie(side, width, height) < std::tie(other.side, other.width, other.height);
+		}
+		bool operator==(const ExpectedFace& other) const {
+			return side == other.side && width == other.width && height == other.height;
+		}
+	};
+	
+	// Meshes stone blocks alone in a lit snapshot, and compares the merged faces with the expected ones
+	bool checkMeshedShape(const char* name, const std::vector<glm::ivec3>& blocks, std::vector<ExpectedFace> expected) {
+		std::unique_ptr<ChunkSnapshot> snapshot(new ChunkSnapshot());
+		for(int y = -1; y <= CHUNK_HEIGHT; ++y) {
+			for(int z = -1; z <= CHUNK_SIZE; ++z) {
+				for(int x = -1; x <= CHUNK_SIZE; ++x) {
+					snapshot->set(x, y, z, 0);
+					snapshot->setLight(x, y, z, MAX_LIGHT << 4);
+				}
+			}
+		}
+		for(glm::ivec3 pos : blocks) snapshot->set(pos.x, pos.y, pos.z, BlockRegistry::STONE_ID);
+		
+		std::vector<FaceData> faces, translucentFaces;
+		meshChunk(*snapshot, faces, translucentFaces);
+		std::vector<ExpectedFace> actual;
+		for(FaceData& face : faces) actual.push_back({ face.side, face.width, face.height });
+		std::sort(actual.begin(), actual.end());
+		std::sort(expected.begin(), expected.end());
+		if(actual == expected && translucentFaces.empty()) return true;
+		
+		std::cerr << "Meshing check \"" << name << "\" failed, faces (side: width x height):" << std::endl;
+		for(ExpectedFace& face : actual) {
+			std::cerr << "  " << (int) face.side << ": " << (int) face.width << " x " << (int) face.height << std::endl;
+		}
+		return false;
+	}
+	
+	// Small shapes whose greedy meshes are known, so that meshing can be checked without a GPU.
+	// Sides are +z, +x, -z, -x, -y, +y; the faces of horizontal sides are sized along x, then z.
+	bool checkMeshing() {
+		bool ok = checkMeshedShape("2x2 slab", { { 3, 10, 5 }, { 4, 10, 5 }, { 3, 10, 6 }, { 4, 10, 6 } }, {
+			{ 0, 2, 1 }, { 1, 2, 1 }, { 2, 2, 1 }, { 3, 2, 1 }, { 4, 2, 2 }, { 5, 2, 2 }
+		});
+		ok &= checkMeshedShape("L shape", { { 3, 10, 5 }, { 4, 10, 5 }, { 5, 10, 5 }, { 3, 10, 6 }, { 3, 10, 7 } }, {
+			{ 0, 2, 1 }, { 0, 1, 1 }, { 1, 1, 1 }, { 1, 2, 1 }, { 2, 3, 1 }, { 3, 3, 1 },
+			{ 4, 3, 1 }, { 4, 1, 2 }, { 5, 3, 1 }, { 5, 1, 2 }
+		});
+		// Faces are split where the pillar crosses from one section to the next
+		std::vector<glm::ivec3> pillar;
+		for(int y = SECTION_HEIGHT - 4; y < SECTION_HEIGHT + 4; ++y) pillar.push_back({ 8, y, 8 });
+		ok &= checkMeshedShape("pillar across sections", pillar, {
+			{ 0, 1, 4 }, { 0, 1, 4 }, { 1, 1, 4 }, { 1, 1, 4 }, { 2, 1, 4 }, { 2, 1, 4 }, { 3, 1, 4 }, { 3, 1, 4 },
+			{ 4, 1, 1 }, { 5, 1, 1 }
+		});
+		return ok;
+	}
+	
+	const std::vector<std::pair<const char*, std::function<BenchResult()>>> benchmarks = {
+		{ "chunk_get_set", benchChunkGetSet },
+		{ "world_get_block_borders", benchWorldGetBlock },
+		{ "world_raycast", benchRaycast },
+		{ "world_raycast_batch", benchRaycastBatch },
+		{ "mesh_chunk", benchMeshing },
+		{ "frustum_test_box", benchTestBox },
+		{ "frustum_test_boxes", benchTestBoxes },
+		{ "generate_chunk", benchGenerateChunk },
+		{ "distribute_objects", benchDistributeObjects },
+		{ "save_world", benchSaveWorld },
+		{ "load_world", benchLoadWorld },
+		{ "pairing_heap", benchPairingHeap },
+	};
+	
+	void writeJson(std::ostream& out, const std::vector<BenchResult>& results) {
+		out << std::fixed << std::setprecision(2);
+		out << "{" << std::endl;
+		out << "  \"version\": \"" << getVersionString() << "\"," << std::endl;
+		out << "  \"seed\": " << BENCH_SEED << "," << std::endl;
+		out << "  \"repetitions\": " << BENCH_REPETITIONS << "," << std::endl;
+		out << "  \"benchmarks\": [" << std::endl;
+		for(size_t i = 0; i < results.size(); ++i) {
+			const BenchResult& result = results[i];
+			double ops = result.opsPerRun;
+			out << "    { \"name\": \"" << result.name << "\", \"ops_per_run\": " << result.opsPerRun
+				<< ", \"min_ns_per_op\": " << result.runNs.front() / ops
+				<< ", \"median_ns_per_op\": " << result.runNs[result.runNs.size() / 2] / ops
+				<< ", \"max_ns_per_op\": " << result.runNs.back() / ops
+				<< ", \"checksum\": " << result.checksum << " }" << (i + 1 < results.size() ? "," : "") << std::endl;
+		}
+		out << "  ]" << std::endl;
+		out << "}" << std::endl;
+	}
+}
+
+int main(int argc, char** argv) {
+	std::string outputPath = argc > 1 ? argv[1] : "bench_results.json";
+	std::string filter = argc > 2 ? argv[2] : "";
+	
+	BlockRegistry::defineBlocks();
+	BlockTextures::defineTextures();
+	
+	if(!checkMeshing()) return 1;
+	
+	std::vector<BenchResult> results;
+	for(auto& benchmark : benchmarks) {
+		if(std::string(benchmark.first).find(filter) == std::string::npos) continue;
+		results.push_back(benchmark.second());
+		const BenchResult& result = results.back();
+		std::cout << std::left << std::setw(28) << result.name << std::right << std::fixed << std::setprecision(1)
+			<< std::setw(14) << result.runNs[result.runNs.size() / 2] / result.opsPerRun << " ns/op (median)" << std::endl;
+	}
+	
+	std::ofstream file(outputPath.c_str());
+	if(!file) {
+		std::cerr << "Can't write results to " << outputPath << std::endl;
+		return 1;
+	}
+	writeJson(file, results);
+	std::cout << "Results written to " << outputPath << std::endl;
+	return 0;
+}
@@ -0,0 +1,46 @@
+#include "block_textures.hpp"
+
+#include <array>
+#include <vector>
+
+#include "pixcraft/server/blocks.hpp"
+
+using namespace PixCraft;
+
+namespace PixCraft::BlockTextures {
+	namespace {
+		// Indexed by block id; read by the meshing workers, so it isn't changed after defineTextures
+		std::vector<std::array<TexId, 6>> faceTextures;
+		
+		void define(BlockId id, TexId sides, TexId bottom, TexId top) {
+			faceTextures[id] = { sides, sides, sides, sides, bottom, top };
+		}
+		
+		void define(BlockId id, TexId texture) {
+			define(id, texture, texture, texture);
+		}
+	}
+	
+	void defineTextures() {
+		std::array<TexId, 6> placeholder;
+		placeholder.fill(TEX(PLACEHOLDER));
+		faceTextures.assign(BlockRegistry::registeredCount() + 1, placeholder);
+		
+		define(BlockRegistry::STONE_ID, TEX(STONE));
+		define(BlockRegistry::DIRT_ID, TEX(DIRT));
+		define(BlockRegistry::GRASS_ID, TEX(GRASS_SIDE), TEX(DIRT), TEX(GRASS_TOP));
+		define(BlockRegistry::TRUNK_ID, TEX(TRUNK_SIDE), TEX(TRUNK_INSIDE), TEX(TRUNK_INSIDE));
+		define(BlockRegistry::LEAVES_ID, TEX(LEAVES));
+		define(BlockRegistry::WATER_ID, TEX(WATER));
+		define(BlockRegistry::PLANKS_ID, TEX(PLANKS));
+		define(BlockRegistry::LAMP_ID, TEX(LAMP));
+	}
+	
+	TexId faceTexture(BlockId id, uint8_t face) {
+		return faceTextures[id][face];
+	}
+	
+	TexId mainTexture(BlockId id) {
+		return faceTextures[id][0];
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+#include "textures.hpp"
+
+#include "pixcraft/server/world_module.hpp"
+
+namespace PixCraft {
+	// The textures of the blocks, kept out of the block registry so that the server doesn't depend on rendering
+	namespace BlockTextures {
+		// Called after BlockRegistry::defineBlocks
+		void defineTextures();
+		
+		// Faces are in the order of sideVectors; 4 and 5 are the bottom and top
+		TexId faceTexture(BlockId id, uint8_t face);
+		// The texture of the sides, e.g. for the bits of a broken block
+		TexId mainTexture(BlockId id);
+	}
+}
@@ -0,0 +1,343 @@
+#include "chunk_mesher.hpp"
+
+#include <algorithm>
+
+#include "pixcraft/server/world.hpp"
+#include "pixcraft/server/blocks.hpp"
+#include "pixcraft/util/util.hpp"
+#include "pixcraft/util/trace.hpp"
+#include "block_textures.hpp"
+
+using namespace PixCraft;
+
+namespace {
+	// Index of the axis (x, y, z) along the normal of each side
+	const int normalAxes[6] = { 2, 0, 2, 0, 1, 1 };
+	
+	// Directions of the face's own x and y axes for each side; these must match sideTransforms in face_renderer.cpp
+	const int sideAxes[6][2][3] = {
+		{ { 1, 0, 0 }, { 0, 1, 0 } },
+		{ { 0, 0, -1 }, { 0, 1, 0 } },
+		{ { -1, 0, 0 }, { 0, 1, 0 } },
+		{ { 0, 0, 1 }, { 0, 1, 0 } },
+		{ { 1, 0, 0 }, { 0, 0, 1 } },
+		{ { 1, 0, 0 }, { 0, 0, -1 } }
+	};
+	
+	const int chunkDims[3] = { CHUNK_SIZE, CHUNK_HEIGHT, CHUNK_SIZE };
+	
+	bool isOpaqueCube(BlockId id) {
+		return id != 0 && Block::fromId(id).rendering() == BlockRendering::opaqueCube;
+	}
+	
+	// 0 if the face isn't rendered, otherwise identifies which faces can be merged with it:
+	// texture, then light, then whether the block is translucent
+	uint32_t getFaceKey(ChunkSnapshot& snapshot, uint8_t side, int x, int y, int z) {
+		BlockId id = snapshot.get(x, y, z);
+		if(id == 0) return 0;
+		int x2 = x + sideVectors[side][0], y2 = y + sideVectors[side][1], z2 = z + sideVectors[side][2];
+		BlockId neighbor = snapshot.get(x2, y2, z2);
+		if(neighbor != 0 && (isOpaqueCube(neighbor) || neighbor == id)) return 0;
+		
+		Block& block = Block::fromId(id);
+		bool translucent = block.rendering() == BlockRendering::translucentCube;
+		return ((BlockTextures::faceTexture(id, side) + 1) << 9) | (snapshot.getLight(x2, y2, z2) << 1) | (translucent ? 1 : 0);
+	}
+	
+	// Meshes the rows of a slice from startB to endB (exclusive) along its second axis
+	void meshSliceRows(ChunkSnapshot& snapshot, uint8_t side, uint8_t layer, int startB, int endB,
+			std::vector<FaceData>& faces, std::vector<FaceData>& translucentFaces) {
+		// The slice is scanned along two world axes: a, then b
+		int normalAxis = normalAxes[side];
+		int axisA = normalAxis == 0 ? 2 : 0;
+		int axisB = normalAxis == 1 ? 2 : 1;
+		int sizeA = chunkDims[axisA];
+		
+		uint32_t mask[CHUNK_SIZE*CHUNK_HEIGHT];
+		int pos[3];
+		pos[normalAxis] = layer;
+		for(int b = startB; b < endB; ++b) {
+			pos[axisB] = b;
+			for(int a = 0; a < sizeA; ++a) {
+				pos[axisA] = a;
+				mask[a + sizeA*b] = getFaceKey(snapshot, side, pos[0], pos[1], pos[2]);
+			}
+		}
+		
+		for(int b = startB; b < endB; ++b) {
+			for(int a = 0; a < sizeA;) {
+				uint32_t key = mask[a + sizeA*b];
+				if(key == 0) {
+					++a;
+					continue;
+				}
+				
+				int width = 1;
+				while(a + width < sizeA && mask[a + width + sizeA*b] == key) ++width;
+				int height = 1;
+				while(b + height < endB && (axisB != 1 || (b + height) % SECTION_HEIGHT != 0)) {
+					uint32_t* row = &mask[a + sizeA*(b + height)];
+					if(!std::all_of(row, row + width, [key](uint32_t k) { return k == key; })) break;
+					++height;
+				}
+				for(int b2 = b; b2 < b + height; ++b2) {
+					std::fill(&mask[a + sizeA*b2], &mask[a + width + sizeA*b2], 0);
+				}
+				
+				// The face is anchored at the block where the face's own x and y coordinates are lowest
+				int minPos[3], extent[3], anchor[3];
+				minPos[normalAxis] = layer; extent[normalAxis] = 1;
+				minPos[axisA] = a; extent[axisA] = width;
+				minPos[axisB] = b; extent[axisB] = height;
+				std::copy(minPos, minPos + 3, anchor);
+				uint8_t size[2];
+				for(int l = 0; l < 2; ++l) {
+					for(int axis = 0; axis < 3; ++axis) {
+						int dir = sideAxes[side][l][axis];
+						if(dir == 0) continue;
+						size[l] = extent[axis];
+						if(dir < 0) anchor[axis] = minPos[axis] + extent[axis] - 1;
+					}
+				}
+				
+				uint8_t light = key >> 1;
+				FaceData face = {
+					(uint8_t) anchor[0], (uint8_t) anchor[1], (uint8_t) anchor[2], side,
+					size[0], size[1], (uint8_t) (light >> 4), (uint8_t) (light & 0xf), (key >> 9) - 1
+				};
+				if(key & 1) {
+					translucentFaces.push_back(face);
+				} else {
+					faces.push_back(face);
+				}
+				
+				a += width;
+			}
+		}
+	}
+}
+
+ChunkSnapshot::ChunkSnapshot() { }
+
+void ChunkSnapshot::capture(World& world, int32_t chunkX, int32_t chunkZ) {
+	world.fetchBlockIds(chunkX*CHUNK_SIZE - 1, -1, chunkZ*CHUNK_SIZE - 1, SIZE_X, SIZE_Y, SIZE_Z, blocks);
+	world.fetchLight(chunkX*CHUNK_SIZE - 1, -1, chunkZ*CHUNK_SIZE - 1, SIZE_X, SIZE_Y, SIZE_Z, light);
+}
+
+void ChunkSnapshot::capture(World& world, int32_t chunkX, int32_t chunkZ, const int min[3], const int max[3]) {
+	// Column by column, since the snapshot's rows are wider than the box
+	int sizeY = max[1] - min[1] + 1;
+	BlockId columnBlocks[SIZE_Y];
+	uint8_t columnLight[SIZE_Y];
+	for(int z = min[2]; z <= max[2]; ++z) {
+		for(int x = min[0]; x <= max[0]; ++x) {
+			world.fetchBlockIds(chunkX*CHUNK_SIZE + x, min[1], chunkZ*CHUNK_SIZE + z, 1, sizeY, 1, columnBlocks);
+			world.fetchLight(chunkX*CHUNK_SIZE + x, min[1], chunkZ*CHUNK_SIZE + z, 1, sizeY, 1, columnLight);
+			for(int dy = 0; dy < sizeY; ++dy) {
+				int idx = (x+1) + SIZE_X*(z+1) + SIZE_X*SIZE_Z*(min[1] + dy + 1);
+				blocks[idx] = columnBlocks[dy];
+				light[idx] = columnLight[dy];
+			}
+		}
+	}
+}
+
+BlockId ChunkSnapshot::get(int x, int y, int z) {
+	return blocks[(x+1) + SIZE_X*(z+1) + SIZE_X*SIZE_Z*(y+1)];
+}
+
+void ChunkSnapshot::set(int x, int y, int z, BlockId id) {
+	blocks[(x+1) + SIZE_X*(z+1) + SIZE_X*SIZE_Z*(y+1)] = id;
+}
+
+uint8_t ChunkSnapshot::getLight(int x, int y, int z) {
+	return light[(x+1) + SIZE_X*(z+1) + SIZE_X*SIZE_Z*(y+1)];
+}
+
+void ChunkSnapshot::setLight(int x, int y, int z, uint8_t level) {
+	light[(x+1) + SIZE_X*(z+1) + SIZE_X*SIZE_Z*(y+1)] = level;
+}
+
+
+uint32_t PixCraft::getSliceIndex(uint8_t side, uint8_t layer) {
+	if(side < 4) return side*CHUNK_SIZE + layer;
+	return 4*CHUNK_SIZE + (side-4)*CHUNK_HEIGHT + layer;
+}
+
+uint8_t PixCraft::getSliceLayer(uint8_t side, uint8_t x, uint8_t y, uint8_t z) {
+	const uint8_t coords[3] = { x, y, z };
+	return coords[normalAxes[side]];
+}
+
+uint32_t PixCraft::getFaceSlice(const FaceData& face) {
+	return getSliceIndex(face.side, getSliceLayer(face.side, face.offsetX, face.offsetY, face.offsetZ));
+}
+
+uint32_t PixCraft::getSectionSliceIndex(uint8_t side, uint8_t layer) {
+	if(side < 4) return side*CHUNK_SIZE + layer;
+	return 4*CHUNK_SIZE + (side-4)*SECTION_HEIGHT + layer % SECTION_HEIGHT;
+}
+
+uint32_t PixCraft::getFaceSectionSlice(const FaceData& face) {
+	return getSectionSliceIndex(face.side, getSliceLayer(face.side, face.offsetX, face.offsetY, face.offsetZ));
+}
+
+uint8_t PixCraft::getFaceSection(const FaceData& face) {
+	// Faces don't cross sections, and the anchor is always at their lowest y
+	return face.offsetY / SECTION_HEIGHT;
+}
+
+SectionConnectivity PixCraft::computeSectionConnectivity(ChunkSnapshot& snapshot, uint8_t section) {
+	const int CELLS = CHUNK_SIZE*SECTION_HEIGHT*CHUNK_SIZE;
+	bool visited[CELLS] = {};
+	uint16_t stack[CELLS];
+	SectionConnectivity connectivity = 0;
+	int baseY = section*SECTION_HEIGHT;
+	
+	for(int start = 0; start < CELLS; ++start) {
+		if(visited[start]) continue;
+		visited[start] = true;
+		if(isOpaqueCube(snapshot.get(start % CHUNK_SIZE, baseY + start / (CHUNK_SIZE*CHUNK_SIZE), (start / CHUNK_SIZE) % CHUNK_SIZE)))
+			continue;
+		
+		// Flood-fill the non-opaque cells, collecting the faces of the section they touch
+		uint8_t touched = 0;
+		int stackSize = 0;
+		stack[stackSize++] = start;
+		while(stackSize > 0) {
+			int cell = stack[--stackSize];
+			int pos[3] = { cell % CHUNK_SIZE, cell / (CHUNK_SIZE*CHUNK_SIZE), (cell / CHUNK_SIZE) % CHUNK_SIZE };
+			for(uint8_t side = 0; side < 6; ++side) {
+				int x = pos[0] + sideVectors[side][0];
+				int y = pos[1] + sideVectors[side][1];
+				int z = pos[2] + sideVectors[side][2];
+				if(x < 0 || x >= CHUNK_SIZE || y < 0 || y >= SECTION_HEIGHT || z < 0 || z >= CHUNK_SIZE) {
+					touched |= 1 << side;
+					continue;
+				}
+				int neighbor = x + CHUNK_SIZE*z + CHUNK_SIZE*CHUNK_SIZE*y;
+				if(visited[neighbor]) continue;
+				visited[neighbor] = true;
+				if(!isOpaqueCube(snapshot.get(x, baseY + y, z))) stack[stackSize++] = neighbor;
+			}
+		}
+		
+		for(uint8_t side1 = 0; side1 < 6; ++side1) {
+			if(!(touched & (1 << side1))) continue;
+			for(uint8_t side2 = 0; side2 < 6; ++side2) {
+				if(touched & (1 << side2)) connectivity |= SectionConnectivity(1) << (side1*6 + side2);
+			}
+		}
+	}
+	return connectivity;
+}
+
+bool PixCraft::areSectionFacesConnected(SectionConnectivity connectivity, uint8_t side1, uint8_t side2) {
+	return (connectivity >> (side1*6 + side2)) & 1;
+}
+
+void PixCraft::meshSlice(ChunkSnapshot& snapshot, uint8_t side, uint8_t layer,
+		std::vector<FaceData>& faces, std::vector<FaceData>& translucentFaces) {
+	meshSliceRows(snapshot, side, layer, 0, chunkDims[normalAxes[side] == 1 ? 2 : 1], faces, translucentFaces);
+}
+
+void PixCraft::meshSectionSlice(ChunkSnapshot& snapshot, uint8_t section, uint8_t side, uint8_t layer,
+		std::vector<FaceData>& faces, std::vector<FaceData>& translucentFaces) {
+	// Horizontal slices lie in a single section; vertical ones are cut to the section's rows
+	if(side >= 4) meshSliceRows(snapshot, side, layer, 0, CHUNK_SIZE, faces, translucentFaces);
+	else meshSliceRows(snapshot, side, layer, section*SECTION_HEIGHT, (section+1)*SECTION_HEIGHT, faces, translucentFaces);
+}
+
+void PixCraft::addSectionSliceReads(uint8_t section, uint8_t side, uint8_t layer, int min[3], int max[3]) {
+	int readMin[3] = { 0, section*SECTION_HEIGHT, 0 };
+	int readMax[3] = { CHUNK_SIZE - 1, (section+1)*SECTION_HEIGHT - 1, CHUNK_SIZE - 1 };
+	// Along the normal, the slice's layer and the layer in front of its faces
+	int normalAxis = normalAxes[side];
+	int dir = sideVectors[side][normalAxis];
+	readMin[normalAxis] = layer + std::min(dir, 0);
+	readMax[normalAxis] = layer + std::max(dir, 0);
+	for(int axis = 0; axis < 3; ++axis) {
+		min[axis] = std::min(min[axis], readMin[axis]);
+		max[axis] = std::max(max[axis], readMax[axis]);
+	}
+}
+
+void PixCraft::meshChunk(ChunkSnapshot& snapshot, std::vector<FaceData>& faces, std::vector<FaceData>& translucentFaces) {
+	for(uint8_t side = 0; side < 6; ++side) {
+		int layers = chunkDims[normalAxes[side]];
+		for(int layer = 0; layer < layers; ++layer) {
+			meshSlice(snapshot, side, layer, faces, translucentFaces);
+		}
+	}
+}
+
+
+ChunkMesher::ChunkMesher() : runningCount(0) { }
+
+ChunkMesher::~ChunkMesher() {
+	Jobs::cancel(jobs);
+}
+
+std::unique_ptr<MeshJob> ChunkMesher::createJob() {
+	if(freeJobs.empty()) return std::make_unique<MeshJob>();
+	std::unique_ptr<MeshJob> job = std::move(freeJobs.back());
+	freeJobs.pop_back();
+	return job;
+}
+
+void ChunkMesher::submit(std::unique_ptr<MeshJob> job) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		queuedJobs.push_back(std::move(job));
+	}
+	Jobs::submit([this]() { meshNext(); }, JobPriority::normal, &jobs);
+}
+
+bool ChunkMesher::retrieve(std::unique_ptr<MeshJob>& job) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if(finishedJobs.empty()) return false;
+	job = std::move(finishedJobs.front());
+	finishedJobs.pop_front();
+	return true;
+}
+
+void ChunkMesher::recycle(std::unique_ptr<MeshJob> job) {
+	freeJobs.push_back(std::move(job));
+}
+
+size_t ChunkMesher::pendingCount() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return queuedJobs.size() + runningCount + finishedJobs.size();
+}
+
+void ChunkMesher::reportMemory(MemoryReport& report) {
+	std::lock_guard<std::mutex> lock(mutex);
+	size_t bytes = (queuedJobs.size() + runningCount + finishedJobs.size() + freeJobs.size()) * sizeof(MeshJob);
+	for(auto* jobs : { &queuedJobs, &finishedJobs }) {
+		for(auto& job : *jobs) bytes += heapBytes(job->faces) + heapBytes(job->translucentFaces);
+	}
+	for(auto& job : freeJobs) bytes += heapBytes(job->faces) + heapBytes(job->translucentFaces);
+	report.addCpu(MemoryTag::chunkMeshes, bytes);
+}
+
+void ChunkMesher::meshNext() {
+	std::unique_lock<std::mutex> lock(mutex);
+	std::unique_ptr<MeshJob> job = std::move(queuedJobs.front());
+	queuedJobs.pop_front();
+	runningCount++;
+	lock.unlock();
+	
+	{
+		TRACE_SCOPE("Mesh chunk");
+		job->faces.clear();
+		job->translucentFaces.clear();
+		meshChunk(job->snapshot, job->faces, job->translucentFaces);
+		for(uint8_t section = 0; section < CHUNK_SECTIONS; ++section) {
+			job->connectivity[section] = computeSectionConnectivity(job->snapshot, section);
+		}
+	}
+	
+	lock.lock();
+	runningCount--;
+	finishedJobs.push_back(std::move(job));
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include "pixcraft/server/world_module.hpp"
+#include "pixcraft/server/chunk.hpp"
+#include "pixcraft/util/memory_stats.hpp"
+#include "pixcraft/util/jobs.hpp"
+#include "textures.hpp"
+
+// This file doesn't depend on OpenGL, so that meshing can be run and checked without a GPU.
+
+namespace PixCraft {
+	struct FaceData {
+		uint8_t offsetX;
+		uint8_t offsetY;
+		uint8_t offsetZ;
+		uint8_t side;
+		uint8_t width; // size of the quad in blocks, along the face's own x and y axes
+		uint8_t height;
+		uint8_t skyLight; // light of the block in front of the face
+		uint8_t blockLight;
+		TexId texId;
+	} __attribute__((packed));
+	// ^^^ It works without the __attribute__, but adding it allows sending less data to the GPU
+	
+	// A copy of the blocks of a chunk, along with a one-block border from the neighbouring chunks,
+	// so that meshing doesn't need to access the world.
+	class ChunkSnapshot {
+	public:
+		static const int SIZE_X = CHUNK_SIZE + 2;
+		static const int SIZE_Y = CHUNK_HEIGHT + 2;
+		static const int SIZE_Z = CHUNK_SIZE + 2;
+		
+		ChunkSnapshot();
+		
+		void capture(World& world, int32_t chunkX, int32_t chunkZ);
+		// Only copies the blocks in a box of chunk-relative coordinates (inclusive, border included); the rest is kept
+		void capture(World& world, int32_t chunkX, int32_t chunkZ, const int min[3], const int max[3]);
+		
+		// Coordinates are relative to the chunk, and can go one block outside of it.
+		BlockId get(int x, int y, int z);
+		void set(int x, int y, int z, BlockId id);
+		// packed like in Chunk
+		uint8_t getLight(int x, int y, int z);
+		void setLight(int x, int y, int z, uint8_t level);
+	
+	private:
+		BlockId blocks[SIZE_X*SIZE_Y*SIZE_Z];
+		uint8_t light[SIZE_X*SIZE_Y*SIZE_Z];
+	};
+	
+	// Faces are meshed in slices: one per side and layer of blocks along that side's normal.
+	#define CHUNK_SLICES (4*CHUNK_SIZE + 2*CHUNK_HEIGHT)
+	
+	uint32_t getSliceIndex(uint8_t side, uint8_t layer);
+	// returns the layer of the slice the faces on the given side of a block belong to
+	uint8_t getSliceLayer(uint8_t side, uint8_t x, uint8_t y, uint8_t z);
+	uint32_t getFaceSlice(const FaceData& face);
+	
+	// Faces are split at section boundaries, so that each section can be drawn separately.
+	// Within a section, faces are grouped by the part of their slice that lies in it.
+	#define SECTION_SLICES (4*CHUNK_SIZE + 2*SECTION_HEIGHT)
+	
+	uint32_t getSectionSliceIndex(uint8_t side, uint8_t layer);
+	uint32_t getFaceSectionSlice(const FaceData& face);
+	uint8_t getFaceSection(const FaceData& face);
+	
+	// Which faces of a section are connected by non-opaque blocks, as a 6x6 matrix of bits indexed by side.
+	// Sections that can't be seen through a given face from another are skipped when rendering (cave culling).
+	typedef uint64_t SectionConnectivity;
+	#define ALL_SECTION_FACES_CONNECTED ((SectionConnectivity(1) << 36) - 1)
+	
+	SectionConnectivity computeSectionConnectivity(ChunkSnapshot& snapshot, uint8_t section);
+	bool areSectionFacesConnected(SectionConnectivity connectivity, uint8_t side1, uint8_t side2);
+	
+	// Merges the visible faces of a slice with the same texture into as few rectangles as possible (greedy meshing),
+	// without crossing sections, and appends them to faces, or translucentFaces for translucent blocks.
+	void meshSlice(ChunkSnapshot& snapshot, uint8_t side, uint8_t layer,
+		std::vector<FaceData>& faces, std::vector<FaceData>& translucentFaces);
+	// Meshes the part of a slice in the given section, which is the whole slice for horizontal ones
+	void meshSectionSlice(ChunkSnapshot& snapshot, uint8_t section, uint8_t side, uint8_t layer,
+		std::vector<FaceData>& faces, std::vector<FaceData>& translucentFaces);
+	// Grows the box [min, max] (chunk-relative, inclusive) to include the blocks meshSectionSlice reads
+	void addSectionSliceReads(uint8_t section, uint8_t side, uint8_t layer, int min[3], int max[3]);
+	void meshChunk(ChunkSnapshot& snapshot, std::vector<FaceData>& faces, std::vector<FaceData>& translucentFaces);
+	
+	struct MeshJob {
+		uint64_t id;
+		int32_t chunkX, chunkZ;
+		ChunkSnapshot snapshot;
+		std::vector<FaceData> faces;
+		std::vector<FaceData> translucentFaces;
+		SectionConnectivity connectivity[CHUNK_SECTIONS];
+	};
+	
+	// Meshes whole chunks with the job system. Snapshots are captured by the caller, so the workers never access the world.
+	class ChunkMesher {
+	public:
+		ChunkMesher();
+		~ChunkMesher();
+		
+		// Returns a job to be filled in and submitted, reusing recycled jobs if possible
+		std::unique_ptr<MeshJob> createJob();
+		void submit(std::unique_ptr<MeshJob> job);
+		// Returns false if no job is finished yet
+		bool retrieve(std::unique_ptr<MeshJob>& job);
+		void recycle(std::unique_ptr<MeshJob> job);
+		
+		size_t pendingCount();
+		// Adds the memory of the jobs; those being meshed are counted without their faces
+		void reportMemory(MemoryReport& report);
+	
+	private:
+		JobCounter jobs;
+		std::mutex mutex;
+		// Each job system job meshes the oldest queued job, so that meshes are done in submission order
+		std::deque<std::unique_ptr<MeshJob>> queuedJobs;
+		std::deque<std::unique_ptr<MeshJob>> finishedJobs;
+		size_t runningCount;
+		std::vector<std::unique_ptr<MeshJob>> freeJobs;
+		
+		void meshNext();
+	};
+}
@@ -4,8 +4,12 @@
 #include <string>
 #include <vector>
 #include <cmath>
+#include <climits>
 #include <tuple>
 #include <utility>
+#include <algorithm>
+#include <iterator>
+#include <memory>
 
 #include <iostream>
 
@@ -14,141 +18,287 @@
 #include "pixcraft/server/blocks.hpp"
 #include "pixcraft/server/chunk.hpp"
 #include "pixcraft/util/util.hpp"
+#include "pixcraft/util/trace.hpp"
+#include "pixcraft/util/frame_arena.hpp"
+#include "profiler.hpp"
 
 using namespace PixCraft;
 
-void RenderedChunk::init(World& world2, FaceRenderer& faceRenderer, int32_t chunkX2, int32_t chunkZ2) {
+void RenderedChunk::init(World& world2, FaceArena& arena, int32_t chunkX2, int32_t chunkZ2) {
 	world = &world2;
-	buffer.init(faceRenderer, MAX_CHUNK_FACES);
-	translucentBuffer.init(faceRenderer, MAX_CHUNK_FACES);
+	for(uint8_t section = 0; section < CHUNK_SECTIONS; ++section) {
+		buffers[section].init(arena, chunkX2*CHUNK_SIZE, chunkZ2*CHUNK_SIZE);
+		translucentBuffers[section].init(arena, chunkX2*CHUNK_SIZE, chunkZ2*CHUNK_SIZE);
+		buffers[section].setGroupCount(SECTION_SLICES);
+		translucentBuffers[section].setGroupCount(SECTION_SLICES);
+	}
+	// Until the chunk is meshed, it can be seen through in every direction
+	std::fill(std::begin(connectivity), std::end(connectivity), ALL_SECTION_FACES_CONNECTED);
 	chunkX = chunkX2; chunkZ = chunkZ2;
+	for(uint8_t section = 0; section < CHUNK_SECTIONS; ++section) {
+		updateMeshBounds(section);
+	}
+	pendingJob = 0;
+	meshed = false;
+	std::fill(&dirtySlices[0][0], &dirtySlices[0][0] + CHUNK_SECTIONS*SECTION_SLICES, false);
+	hasDirtySlices = false;
+	std::fill(std::begin(dirtySections), std::end(dirtySections), false);
 }
 
-bool RenderedChunk::isInitialized() { return buffer.isInitialized(); }
+bool RenderedChunk::isInitialized() { return buffers[0].isInitialized(); }
+bool RenderedChunk::hasMesh() { return meshed; }
 
-void RenderedChunk::prerender() {
-	Chunk& chunk = world->getChunk(chunkX, chunkZ);
+void RenderedChunk::startMeshing(MeshJob& job, uint64_t jobId) {
+	job.id = jobId;
+	job.chunkX = chunkX;
+	job.chunkZ = chunkZ;
+	job.snapshot.capture(*world, chunkX, chunkZ);
+	pendingJob = jobId;
 	
-	buffer.faces.clear();
-	translucentBuffer.faces.clear();
-	for(uint8_t x = 0; x < CHUNK_SIZE; ++x) {
-		for(uint8_t y = 0; y < CHUNK_HEIGHT; ++y) {
-			for(uint8_t z = 0; z < CHUNK_SIZE; ++z) {
-				prerenderBlock(chunk, x, y, z);
-			}
-		}
+	// The new mesh will include all changes made so far
+	std::fill(&dirtySlices[0][0], &dirtySlices[0][0] + CHUNK_SECTIONS*SECTION_SLICES, false);
+	hasDirtySlices = false;
+	std::fill(std::begin(dirtySections), std::end(dirtySections), false);
+}
+
+bool RenderedChunk::finishMeshing(MeshJob& job) {
+	if(job.id != pendingJob) return false; // superseded by a later job
+	for(uint8_t section = 0; section < CHUNK_SECTIONS; ++section) {
+		buffers[section].clear();
+		translucentBuffers[section].clear();
+		connectivity[section] = job.connectivity[section];
 	}
+	for(FaceData& face : job.faces)
+		buffers[getFaceSection(face)].addFace(getFaceSectionSlice(face), face);
+	for(FaceData& face : job.translucentFaces)
+		translucentBuffers[getFaceSection(face)].addFace(getFaceSectionSlice(face), face);
+	for(uint8_t section = 0; section < CHUNK_SECTIONS; ++section) {
+		updateMeshBounds(section);
+	}
+	pendingJob = 0;
+	meshed = true;
+	return true;
 }
 
-void RenderedChunk::updateBuffers() {
-	buffer.prerender();
-	translucentBuffer.prerender();
+uint32_t RenderedChunk::updateBuffers(ChunkSnapshot& snapshot, std::vector<FaceData>& faces, std::vector<FaceData>& translucentFaces) {
+	uint32_t remeshed = 0;
+	// Slices changed while a full remesh is pending are remeshed once it is finished
+	if(hasDirtySlices && pendingJob == 0) {
+		for(uint8_t section = 0; section < CHUNK_SECTIONS; ++section) {
+			// Only the blocks read by the section's dirty slices, and by its connectivity, are captured
+			int readMin[3] = { INT_MAX, INT_MAX, INT_MAX };
+			int readMax[3] = { INT_MIN, INT_MIN, INT_MIN };
+			if(dirtySections[section]) {
+				readMin[0] = 0; readMin[1] = section*SECTION_HEIGHT; readMin[2] = 0;
+				readMax[0] = CHUNK_SIZE - 1; readMax[1] = (section+1)*SECTION_HEIGHT - 1; readMax[2] = CHUNK_SIZE - 1;
+			}
+			for(uint8_t side = 0; side < 6; ++side) {
+				uint8_t layers = side < 4 ? CHUNK_SIZE : SECTION_HEIGHT;
+				for(uint8_t i = 0; i < layers; ++i) {
+					uint8_t layer = side < 4 ? i : section*SECTION_HEIGHT + i;
+					if(dirtySlices[section][getSectionSliceIndex(side, layer)])
+						addSectionSliceReads(section, side, layer, readMin, readMax);
+				}
+			}
+			if(readMin[0] > readMax[0]) continue;
+			snapshot.capture(*world, chunkX, chunkZ, readMin, readMax);
+			
+			bool changed = false;
+			for(uint8_t side = 0; side < 6; ++side) {
+				uint8_t layers = side < 4 ? CHUNK_SIZE : SECTION_HEIGHT;
+				for(uint8_t i = 0; i < layers; ++i) {
+					uint8_t layer = side < 4 ? i : section*SECTION_HEIGHT + i;
+					uint32_t sectionSlice = getSectionSliceIndex(side, layer);
+					if(!dirtySlices[section][sectionSlice]) continue;
+					buffers[section].eraseGroup(sectionSlice);
+					translucentBuffers[section].eraseGroup(sectionSlice);
+					
+					faces.clear();
+					translucentFaces.clear();
+					meshSectionSlice(snapshot, section, side, layer, faces, translucentFaces);
+					for(FaceData& face : faces) buffers[section].addFace(sectionSlice, face);
+					for(FaceData& face : translucentFaces) translucentBuffers[section].addFace(sectionSlice, face);
+					dirtySlices[section][sectionSlice] = false;
+					changed = true;
+					remeshed++;
+				}
+			}
+			if(changed) updateMeshBounds(section);
+			
+			if(dirtySections[section]) {
+				connectivity[section] = computeSectionConnectivity(snapshot, section);
+				dirtySections[section] = false;
+			}
+		}
+		hasDirtySlices = false;
+	}
+	
+	for(uint8_t section = 0; section < CHUNK_SECTIONS; ++section) {
+		buffers[section].uploadChanges();
+		translucentBuffers[section].uploadChanges();
+	}
+	return remeshed;
 }
 
 void RenderedChunk::updateBlock(int8_t relX, int8_t y, int8_t relZ) {
-	buffer.eraseFaces(relX, y, relZ);
-	translucentBuffer.eraseFaces(relX, y, relZ);
-	
-	Chunk& chunk = world->getChunk(chunkX, chunkZ);
-	prerenderBlock(chunk, relX, y, relZ);
+	if(INVALID_BLOCK_POS(relX, y, relZ)) return;
+	// A block change affects the faces of the block itself, and the faces of its neighbors that are
+	// facing it; the latter are marked when the neighbors are updated.
+	for(uint8_t side = 0; side < 6; ++side) {
+		markSliceDirty(y / SECTION_HEIGHT, side, getSliceLayer(side, relX, y, relZ));
+	}
+	dirtySections[y / SECTION_HEIGHT] = true;
 }
 
 void RenderedChunk::updatePlaneX(int8_t relX) {
-	buffer.erasePlaneX(relX);
-	translucentBuffer.erasePlaneX(relX);
-	
-	Chunk& chunk = world->getChunk(chunkX, chunkZ);
-	for(uint8_t y = 0; y < CHUNK_HEIGHT; ++y) {
-		for(uint8_t relZ = 0; relZ < CHUNK_SIZE; ++relZ) {
-			prerenderBlock(chunk, relX, y, relZ);
-		}
+	for(uint8_t section = 0; section < CHUNK_SECTIONS; ++section) {
+		markSliceDirty(section, 1, relX);
+		markSliceDirty(section, 3, relX);
 	}
 }
 
 void RenderedChunk::updatePlaneZ(int8_t relZ) {
-	buffer.erasePlaneZ(relZ);
-	translucentBuffer.erasePlaneZ(relZ);
-	
-	Chunk& chunk = world->getChunk(chunkX, chunkZ);
-	for(uint8_t y = 0; y < CHUNK_HEIGHT; ++y) {
-		for(uint8_t relX = 0; relX < CHUNK_SIZE; ++relX) {
-			prerenderBlock(chunk, relX, y, relZ);
-		}
+	for(uint8_t section = 0; section < CHUNK_SECTIONS; ++section) {
+		markSliceDirty(section, 0, relZ);
+		markSliceDirty(section, 2, relZ);
 	}
 }
 
-void RenderedChunk::render(FaceRenderer& faceRenderer) {
-	glm::mat4 model = glm::translate(glm::mat4(1.0f), ((float) CHUNK_SIZE) * glm::vec3(chunkX, 0.0f, chunkZ));
-	faceRenderer.render(buffer, model);
+void RenderedChunk::render(uint8_t section) {
+	buffers[section].render();
+}
+
+void RenderedChunk::renderTranslucent(uint8_t section) {
+	translucentBuffers[section].render();
 }
 
-void RenderedChunk::renderTranslucent(FaceRenderer& faceRenderer) {
-	glm::mat4 model = glm::translate(glm::mat4(1.0f), ((float) CHUNK_SIZE) * glm::vec3(chunkX, 0.0f, chunkZ));
-	faceRenderer.render(translucentBuffer, model);
+SectionConnectivity RenderedChunk::getConnectivity(uint8_t section) {
+	return connectivity[section];
 }
 
+bool RenderedChunk::hasFaces(uint8_t section) {
+	return meshMinY[section] <= meshMaxY[section];
+}
 
-void RenderedChunk::prerenderBlock(Chunk& chunk, uint8_t relX, uint8_t y, uint8_t relZ) {
-	Block* block = chunk.getBlock(relX, y, relZ);
-	if(block == nullptr) return;
-	
-	for(uint8_t side = 0; side < 6; ++side) {
-		int32_t x2 = (int32_t) relX + sideVectors[side][0];
-		int32_t y2 = (int32_t) y + sideVectors[side][1];
-		int32_t z2 = (int32_t) relZ + sideVectors[side][2];
-	
-		bool renderFace;
-		if(INVALID_BLOCK_POS(x2, y2, z2)) {
-			int32_t x3 = chunkX*CHUNK_SIZE + x2;
-			int32_t z3 = chunkZ*CHUNK_SIZE + z2;
-			renderFace = !world->hasBlock(x3, y2, z3)
-				|| (!world->isOpaqueCube(x3, y2, z3) && block != world->getBlock(x3, y2, z3));
-		} else {
-			renderFace = !chunk.hasBlock(x2, y2, z2)
-				|| (!chunk.isOpaqueCube(x2, y2, z2) && block != chunk.getBlock(x2, y2, z2));
-		}
-		if(renderFace) {
-			FaceData face = {
-				relX, y, relZ, side, block->getFaceTexture(side)
-			};
-			if(block->rendering() == BlockRendering::translucentCube) {
-				translucentBuffer.faces.push_back(face);
-			} else {
-				buffer.faces.push_back(face);
-			}
+void RenderedChunk::reportMemory(MemoryReport& report) {
+	for(uint8_t section = 0; section < CHUNK_SECTIONS; ++section) {
+		buffers[section].reportMemory(report);
+		translucentBuffers[section].reportMemory(report);
+	}
+}
+
+AABB RenderedChunk::getMeshBounds(uint8_t section) {
+	return {
+		glm::vec3(chunkX*CHUNK_SIZE - 0.5f, meshMinY[section] - 0.5f, chunkZ*CHUNK_SIZE - 0.5f),
+		glm::vec3((chunkX+1)*CHUNK_SIZE - 0.5f, meshMaxY[section] + 0.5f, (chunkZ+1)*CHUNK_SIZE - 0.5f)
+	};
+}
+
+
+void RenderedChunk::updateMeshBounds(uint8_t section) {
+	uint8_t minY = UINT8_MAX, maxY = 0;
+	for(FaceBuffer* buffer : { &buffers[section], &translucentBuffers[section] }) {
+		for(FaceData& face : buffer->faces) {
+			minY = std::min(minY, face.offsetY);
+			// Vertical faces extend upwards from their anchor
+			maxY = std::max(maxY, (uint8_t) (face.side < 4 ? face.offsetY + face.height - 1 : face.offsetY));
 		}
 	}
+	meshMinY[section] = minY;
+	meshMaxY[section] = maxY;
+}
+
+void RenderedChunk::markSliceDirty(uint8_t section, uint8_t side, uint8_t layer) {
+	dirtySlices[section][getSectionSliceIndex(side, layer)] = true;
+	hasDirtySlices = true;
 }
 
 
 ChunkRenderer::ChunkRenderer(World& world, FaceRenderer& renderer)
-	: world(world), faceRenderer(renderer) { }
+	: world(world), faceRenderer(renderer), lastJobId(0), meshStats(),
+	  _caveCulling(true), gridRadius(0), gridSize(0), gridOriginX(0), gridOriginZ(0) { }
+
+void ChunkRenderer::init() {
+	arena.init();
+}
 
 bool ChunkRenderer::isChunkRendered(int32_t chunkX, int32_t chunkZ) {
 	uint64_t key = packCoords(chunkX, chunkZ);
 	return renderedChunks.count(key) == 1;
 }
 
+bool ChunkRenderer::isChunkMeshed(int32_t chunkX, int32_t chunkZ) {
+	auto iter = renderedChunks.find(packCoords(chunkX, chunkZ));
+	return iter != renderedChunks.end() && iter->second.hasMesh();
+}
+
 size_t ChunkRenderer::renderedChunkCount() {
 	return renderedChunks.size();
 }
 
+size_t ChunkRenderer::pendingMeshCount() {
+	return mesher.pendingCount();
+}
+
+FaceArena& ChunkRenderer::getArena() {
+	return arena;
+}
+
+MeshStats& ChunkRenderer::getMeshStats() {
+	return meshStats;
+}
+
+void ChunkRenderer::reportMemory(MemoryReport& report) {
+	report.addCpu(MemoryTag::chunkMeshes, heapBytes(renderedChunks) + heapBytes(gridChunks) + heapBytes(gridSectionFlags)
+		+ visitedSections.capacity() / 8 + heapBytes(visitQueue) + heapBytes(visibleSections)
+		+ heapBytes(sliceFaces) + heapBytes(sliceTranslucentFaces));
+	for(auto& pair : renderedChunks) {
+		pair.second.reportMemory(report);
+	}
+	arena.reportMemory(report);
+	mesher.reportMemory(report);
+}
+
+size_t ChunkRenderer::renderedSectionCount() {
+	return visibleSections.size();
+}
+
+bool ChunkRenderer::caveCulling() { return _caveCulling; }
+void ChunkRenderer::caveCulling(bool enabled) { _caveCulling = enabled; }
+
 void ChunkRenderer::reset() {
+	visibleSections.clear();
 	renderedChunks.clear();
 }
 
 void ChunkRenderer::updateBlocks() {
-	std::unordered_set<uint64_t> updatedChunks;
+	// The meshes are built by the job system's workers; this times collecting them and queuing new ones
+	TRACE_SCOPE("Update chunk meshes");
+	Profiler::beginZone(ProfileZone::meshing);
+	ChunkIdxSet updatedChunks(&frameArena());
 	
-	std::unordered_set<uint64_t> toPrerender = world.retrieveDirtyChunks();
+	std::unique_ptr<MeshJob> job;
+	while(mesher.retrieve(job)) {
+		uint64_t key = packCoords(job->chunkX, job->chunkZ);
+		auto iter = renderedChunks.find(key);
+		if(iter != renderedChunks.end() && iter->second.finishMeshing(*job)) {
+			updatedChunks.insert(key);
+			meshStats.fullMeshes++;
+		} else {
+			meshStats.discardedMeshes++;
+		}
+		mesher.recycle(std::move(job));
+	}
+	
+	ChunkIdxSet toPrerender = world.retrieveDirtyChunks();
 	for(uint64_t chunkIdx : toPrerender) {
 		int32_t chunkX, chunkZ;
 		std::tie(chunkX, chunkZ) = unpackCoords(chunkIdx);
-		prerenderChunk(updatedChunks, chunkX, chunkZ);
+		queueMesh(updatedChunks, chunkX, chunkZ);
 	}
 	
 	BlockPosSet toUpdate = world.retrieveDirtyBlocks();
-	BlockPosSet neighbors;
+	BlockPosSet neighbors(&frameArena());
 	int32_t x, y, z;
 	for(BlockPos blockPos : toUpdate) {
 		std::tie(x, y, z) = blockPos;
@@ -161,13 +311,54 @@ void ChunkRenderer::updateBlocks() {
 		std::tie(x, y, z) = blockPos;
 		updateBlock(updatedChunks, x, y, z);
 	}
+	Profiler::endZone(ProfileZone::meshing);
+	TRACE_COUNTER("Pending meshes", mesher.pendingCount());
 	
+	ProfileScope uploadScope(ProfileZone::meshUpload);
 	for(uint64_t chunkIdx : updatedChunks) {
-		renderedChunks[chunkIdx].updateBuffers();
+		uint32_t slices = renderedChunks[chunkIdx].updateBuffers(snapshot, sliceFaces, sliceTranslucentFaces);
+		if(slices > 0) {
+			meshStats.partialRemeshes++;
+			meshStats.remeshedSlices += slices;
+		}
+	}
+}
+
+void ChunkRenderer::render(glm::vec3 camPos, int renderDist, ViewFrustum& vf) {
+	findVisibleSections(camPos, renderDist, vf);
+	for(VisibleSection& visible : visibleSections) {
+		visible.chunk->render(visible.section);
 	}
+	faceRenderer.render(arena);
 }
 
-void ChunkRenderer::render(int32_t camChunkX, int32_t camChunkZ, int renderDist, ViewFrustum& vf) {
+void ChunkRenderer::renderTranslucent() {
+	glDepthMask(GL_FALSE);
+	glDisable(GL_CULL_FACE);
+	// Farthest sections first, so that nearer translucent faces are blended over them
+	for(auto iter = visibleSections.rbegin(); iter != visibleSections.rend(); ++iter) {
+		iter->chunk->renderTranslucent(iter->section);
+	}
+	faceRenderer.render(arena);
+	glDepthMask(GL_TRUE);
+	glEnable(GL_CULL_FACE);
+}
+
+void ChunkRenderer::findVisibleSections(glm::vec3 camPos, int renderDist, ViewFrustum& vf) {
+	int32_t camX, camY, camZ;
+	std::tie(camX, camY, camZ) = getBlockCoordsAt(camPos);
+	int32_t camChunkX, camChunkZ;
+	std::tie(camChunkX, camChunkZ) = World::getChunkPosAt(camX, camZ);
+	int32_t maxDist = renderDist + 2;
+	
+	gridRadius = maxDist;
+	gridSize = 2*gridRadius + 1;
+	gridOriginX = camChunkX - gridRadius;
+	gridOriginZ = camChunkZ - gridRadius;
+	gridChunks.assign(gridSize*gridSize, nullptr);
+	gridSectionFlags.assign(gridSize*gridSize, 0);
+	visitedSections.assign(gridSize*gridSize*CHUNK_SECTIONS, false);
+	
 	for(auto iter = renderedChunks.begin(); iter != renderedChunks.end();) {
 		int32_t chunkX, chunkZ;
 		std::tie(chunkX, chunkZ) = unpackCoords(iter->first);
@@ -175,37 +366,120 @@ void ChunkRenderer::render(int32_t camChunkX, int32_t camChunkZ, int renderDist,
 		if(dist >= (renderDist+5)*(renderDist+5)) {
 			iter = renderedChunks.erase(iter);
 		} else {
-			if(dist <= (renderDist+2)*(renderDist+2) && isVisible(vf, chunkX, chunkZ)) {
-				RenderedChunk& chunk = iter->second;
-				chunk.render(faceRenderer);
-			}
+			if(dist <= maxDist*maxDist)
+				gridChunks[(chunkX-camChunkX+gridRadius) + gridSize*(chunkZ-camChunkZ+gridRadius)] = &iter->second;
 			++iter;
 		}
 	}
+	
+	cullGridNode(vf, 0, 0, gridSize, gridSize);
+	
+	// Breadth-first search through the sections from the camera, only going away from it,
+	// and only through pairs of faces connected inside each section. Missing chunks can be seen through.
+	// When the camera is inside a block (e.g. with noclip), nothing is culled.
+	bool culling = _caveCulling && !world.isOpaqueCube(camX, camY, camZ);
+	visibleSections.clear();
+	visitQueue.clear();
+	uint8_t camSection = std::min(std::max(camY / SECTION_HEIGHT, 0), CHUNK_SECTIONS - 1);
+	visitQueue.push_back({ gridRadius, gridRadius, camSection, -1, 0 });
+	visitedSections[camSection + CHUNK_SECTIONS*(gridRadius + gridSize*gridRadius)] = true;
+	for(size_t head = 0; head < visitQueue.size(); ++head) {
+		SectionVisit visit = visitQueue[head];
+		RenderedChunk* chunk = gridChunks[visit.gridX + gridSize*visit.gridZ];
+		SectionConnectivity connectivity = ALL_SECTION_FACES_CONNECTED;
+		if(chunk != nullptr) {
+			if(gridSectionFlags[visit.gridX + gridSize*visit.gridZ] & (SECTION_FACES_IN_FRUSTUM << visit.section))
+				visibleSections.push_back({ chunk, visit.section });
+			if(culling) connectivity = chunk->getConnectivity(visit.section);
+		}
+		
+		for(uint8_t side = 0; side < 6; ++side) {
+			uint8_t opposite = side < 4 ? (side + 2) % 4 : 9 - side;
+			if(visit.directions & (1 << opposite)) continue;
+			if(visit.fromSide != -1 && !areSectionFacesConnected(connectivity, visit.fromSide, side)) continue;
+			
+			int32_t gridX = visit.gridX + sideVectors[side][0];
+			int32_t gridZ = visit.gridZ + sideVectors[side][2];
+			int32_t section = visit.section + sideVectors[side][1];
+			if(section < 0 || section >= CHUNK_SECTIONS) continue;
+			int32_t relX = gridX - gridRadius, relZ = gridZ - gridRadius;
+			if(relX*relX + relZ*relZ > maxDist*maxDist) continue;
+			
+			int32_t gridIdx = gridX + gridSize*gridZ;
+			if(visitedSections[section + CHUNK_SECTIONS*gridIdx]) continue;
+			if(!(gridSectionFlags[gridIdx] & (SECTION_IN_FRUSTUM << section))) continue;
+			
+			visitedSections[section + CHUNK_SECTIONS*gridIdx] = true;
+			visitQueue.push_back({ gridX, gridZ, (uint8_t) section, (int8_t) opposite,
+				(uint8_t) (visit.directions | (1 << side)) });
+		}
+	}
 }
 
-void ChunkRenderer::renderTranslucent(int32_t camChunkX, int32_t camChunkZ, int renderDist, ViewFrustum& vf) {
-	glDepthMask(GL_FALSE);
-	glDisable(GL_CULL_FACE);
-	for(int32_t x = camChunkX - renderDist; x <= camChunkX + renderDist; ++x) {
-		for(int32_t z = camChunkZ - renderDist; z <= camChunkZ + renderDist; ++z) {
-			auto chunkIter = renderedChunks.find(packCoords(x, z));
-			if(chunkIter != renderedChunks.end() && isVisible(vf, x, z)) {
-				chunkIter->second.renderTranslucent(faceRenderer);
-			}
+void ChunkRenderer::cullGridNode(ViewFrustum& vf, int32_t x0, int32_t z0, int32_t x1, int32_t z1) {
+	// The grid is split as a quadtree, so that whole groups of chunks outside of the frustum are rejected at once
+	AABB box = {
+		glm::vec3(CHUNK_SIZE*(gridOriginX + x0) - 0.5f, -0.5f, CHUNK_SIZE*(gridOriginZ + z0) - 0.5f),
+		glm::vec3(CHUNK_SIZE*(gridOriginX + x1) - 0.5f, CHUNK_HEIGHT - 0.5f, CHUNK_SIZE*(gridOriginZ + z1) - 0.5f)
+	};
+	FrustumTest result = testBox(vf, box);
+	if(result == FrustumTest::outside) return;
+	if(result == FrustumTest::inside || (x1 - x0 == 1 && z1 - z0 == 1)) {
+		for(int32_t x = x0; x < x1; ++x) {
+			for(int32_t z = z0; z < z1; ++z) cullGridCell(vf, x, z, result == FrustumTest::inside);
 		}
+		return;
 	}
-	glDepthMask(GL_TRUE);
-	glEnable(GL_CULL_FACE);
+	
+	int32_t midX = (x0 + x1 + 1) / 2, midZ = (z0 + z1 + 1) / 2;
+	cullGridNode(vf, x0, z0, midX, midZ);
+	if(midX < x1) cullGridNode(vf, midX, z0, x1, midZ);
+	if(midZ < z1) cullGridNode(vf, x0, midZ, midX, z1);
+	if(midX < x1 && midZ < z1) cullGridNode(vf, midX, midZ, x1, z1);
+}
+
+void ChunkRenderer::cullGridCell(ViewFrustum& vf, int32_t gridX, int32_t gridZ, bool inside) {
+	RenderedChunk* chunk = gridChunks[gridX + gridSize*gridZ];
+	uint8_t& flags = gridSectionFlags[gridX + gridSize*gridZ];
+	if(inside) {
+		flags = 0xf * SECTION_IN_FRUSTUM;
+		for(uint8_t section = 0; section < CHUNK_SECTIONS; ++section) {
+			if(chunk != nullptr && chunk->hasFaces(section)) flags |= SECTION_FACES_IN_FRUSTUM << section;
+		}
+		return;
+	}
+	
+	static_assert(CHUNK_SECTIONS == 4, "the sections of a chunk are tested as one AABB4");
+	// The whole sections are tested to know whether they can be seen through,
+	// and the vertical extent of their faces to know whether to draw them.
+	float minX = CHUNK_SIZE*(gridOriginX + gridX) - 0.5f, maxX = minX + CHUNK_SIZE;
+	float minZ = CHUNK_SIZE*(gridOriginZ + gridZ) - 0.5f, maxZ = minZ + CHUNK_SIZE;
+	AABB4 boxes = {
+		glm::vec4(minX), glm::vec4(0, 1, 2, 3) * (float) SECTION_HEIGHT - 0.5f, glm::vec4(minZ),
+		glm::vec4(maxX), glm::vec4(1, 2, 3, 4) * (float) SECTION_HEIGHT - 0.5f, glm::vec4(maxZ)
+	};
+	flags = testBoxes(vf, boxes) * SECTION_IN_FRUSTUM;
+	if(chunk == nullptr) return;
+	
+	uint8_t nonEmpty = 0;
+	for(uint8_t section = 0; section < CHUNK_SECTIONS; ++section) {
+		if(!chunk->hasFaces(section)) continue;
+		nonEmpty |= 1 << section;
+		AABB bounds = chunk->getMeshBounds(section);
+		boxes.minY[section] = bounds.min.y;
+		boxes.maxY[section] = bounds.max.y;
+	}
+	flags |= (testBoxes(vf, boxes) & nonEmpty) * SECTION_FACES_IN_FRUSTUM;
 }
 
-void ChunkRenderer::prerenderChunk(std::unordered_set<uint64_t>& updated, int32_t chunkX, int32_t chunkZ) {
+void ChunkRenderer::queueMesh(ChunkIdxSet& updated, int32_t chunkX, int32_t chunkZ) {
 	uint64_t key = packCoords(chunkX, chunkZ);
 	RenderedChunk& renderedChunk = renderedChunks[key];
 	if(!renderedChunk.isInitialized())
-		renderedChunk.init(world, faceRenderer, chunkX, chunkZ);
-	renderedChunk.prerender();
-	updated.insert(key);
+		renderedChunk.init(world, arena, chunkX, chunkZ);
+	std::unique_ptr<MeshJob> job = mesher.createJob();
+	renderedChunk.startMeshing(*job, ++lastJobId);
+	mesher.submit(std::move(job));
 	
 	// Update nearby chunks
 	key = packCoords(chunkX - 1, chunkZ);
@@ -231,7 +505,7 @@ void ChunkRenderer::prerenderChunk(std::unordered_set<uint64_t>& updated, int32_
 	}
 }
 
-void ChunkRenderer::updateBlock(std::unordered_set<uint64_t>& updated, int32_t x, int32_t y, int32_t z) {
+void ChunkRenderer::updateBlock(ChunkIdxSet& updated, int32_t x, int32_t y, int32_t z) {
 	int32_t chunkX, chunkZ;
 	std::tie(chunkX, chunkZ) = World::getChunkPosAt(x, z);
 	uint64_t chunkIdx = packCoords(chunkX, chunkZ);
@@ -2,59 +2,138 @@
 
 #include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include <stb_image.h>
 
 #include "pixcraft/server/world.hpp"
 #include "face_renderer.hpp"
+#include "chunk_mesher.hpp"
 #include "view_frustum.hpp"
 
 namespace PixCraft {
+	#define SECTION_IN_FRUSTUM 0x01
+	#define SECTION_FACES_IN_FRUSTUM 0x10
+	
+	// Counts of the mesh work done since the renderer was created
+	struct MeshStats {
+		uint64_t fullMeshes; // meshes built by the worker threads and applied
+		uint64_t discardedMeshes; // meshes superseded by a later job, or whose chunk was dropped
+		uint64_t partialRemeshes; // chunks remeshed slice by slice after block changes
+		uint64_t remeshedSlices; // counted once per section the slice was remeshed in
+	};
+	
 	class RenderedChunk {
 	public:
-		void init(World& world, FaceRenderer& faceRenderer, int32_t chunkX, int32_t chunkZ);
+		void init(World& world, FaceArena& arena, int32_t chunkX, int32_t chunkZ);
 		bool isInitialized();
+		bool hasMesh(); // false until the first full mesh is applied
 		
-		void prerender();
-		void updateBuffers();
+		// Captures the blocks for a full remesh on a worker thread; the faces are replaced in finishMeshing
+		void startMeshing(MeshJob& job, uint64_t jobId);
+		bool finishMeshing(MeshJob& job);
+		// Returns the number of slices remeshed, per section; faces and translucentFaces are scratch space
+		uint32_t updateBuffers(ChunkSnapshot& snapshot, std::vector<FaceData>& faces, std::vector<FaceData>& translucentFaces);
 		
+		// These only mark the affected slices, which are remeshed in updateBuffers
 		void updateBlock(int8_t relX, int8_t y, int8_t relZ);
 		void updatePlaneX(int8_t relX);
 		void updatePlaneZ(int8_t relZ);
 		
-		void render(FaceRenderer& faceRenderer);
-		void renderTranslucent(FaceRenderer& faceRenderer);
+		// These queue the faces of a section to be drawn with the arena
+		void render(uint8_t section);
+		void renderTranslucent(uint8_t section);
 		
+		SectionConnectivity getConnectivity(uint8_t section);
+		bool hasFaces(uint8_t section);
+		// The chunk's horizontal extent, and the vertical extent of the section's faces
+		AABB getMeshBounds(uint8_t section);
+		
+		void reportMemory(MemoryReport& report);
+	
 	private:
 		World* world;
-		FaceBuffer buffer;
-		FaceBuffer translucentBuffer;
+		FaceBuffer buffers[CHUNK_SECTIONS];
+		FaceBuffer translucentBuffers[CHUNK_SECTIONS];
+		SectionConnectivity connectivity[CHUNK_SECTIONS];
+		uint8_t meshMinY[CHUNK_SECTIONS], meshMaxY[CHUNK_SECTIONS]; // min > max if the section has no faces
 		int32_t chunkX, chunkZ;
 		
-		void prerenderBlock(Chunk& chunk, uint8_t relX, uint8_t y, uint8_t relZ);
+		uint64_t pendingJob; // 0 if no full remesh is pending
+		bool meshed;
+		bool dirtySlices[CHUNK_SECTIONS][SECTION_SLICES]; // indexed like the buffers' groups
+		bool hasDirtySlices;
+		bool dirtySections[CHUNK_SECTIONS]; // sections whose connectivity changed
+		
+		void updateMeshBounds(uint8_t section);
+		void markSliceDirty(uint8_t section, uint8_t side, uint8_t layer);
 	};
 	
 	class ChunkRenderer {
 	public:
 		ChunkRenderer(World& world, FaceRenderer& renderer);
+		void init();
 		
 		bool isChunkRendered(int32_t chunkX, int32_t chunkZ);
+		bool isChunkMeshed(int32_t chunkX, int32_t chunkZ);
 		size_t renderedChunkCount();
+		size_t pendingMeshCount();
+		FaceArena& getArena();
+		MeshStats& getMeshStats();
+		// Adds the CPU memory of the meshes; their GPU memory is counted by the arena's buffers
+		void reportMemory(MemoryReport& report);
 		
 		void reset();
 		
 		void updateBlocks();
 		
-		void render(int32_t camChunkX, int32_t chamChunkZ, int renderDist, ViewFrustum& vf);
-		void renderTranslucent(int32_t camChunkX, int32_t chamChunkZ, int renderDist, ViewFrustum& vf);
+		// Finds the visible sections, then draws them; renderTranslucent draws the same sections
+		void render(glm::vec3 camPos, int renderDist, ViewFrustum& vf);
+		void renderTranslucent();
+		size_t renderedSectionCount();
+		
+		// Whether sections hidden behind opaque blocks are skipped
+		bool caveCulling();
+		void caveCulling(bool enabled);
 		
 	private:
+		struct SectionVisit {
+			int32_t gridX, gridZ;
+			uint8_t section;
+			int8_t fromSide; // side through which the section was entered, or -1 for the camera's section
+			uint8_t directions; // bitmask of the sides the search went through to get there
+		};
+		struct VisibleSection {
+			RenderedChunk* chunk;
+			uint8_t section;
+		};
+		
 		World& world;
 		FaceRenderer& faceRenderer;
+		FaceArena arena; // must outlive the rendered chunks
 		
 		std::unordered_map<uint64_t, RenderedChunk> renderedChunks;
+		ChunkSnapshot snapshot;
+		std::vector<FaceData> sliceFaces, sliceTranslucentFaces; // reused when remeshing slices
+		ChunkMesher mesher;
+		uint64_t lastJobId;
+		MeshStats meshStats;
+		
+		bool _caveCulling;
+		// Chunks around the camera for the visibility search, indexed by grid position
+		int32_t gridRadius, gridSize;
+		int32_t gridOriginX, gridOriginZ; // chunk coordinates of the first cell
+		std::vector<RenderedChunk*> gridChunks;
+		// SECTION_IN_FRUSTUM and SECTION_FACES_IN_FRUSTUM bits, shifted by the section index
+		std::vector<uint8_t> gridSectionFlags;
+		std::vector<bool> visitedSections;
+		std::vector<SectionVisit> visitQueue;
+		std::vector<VisibleSection> visibleSections;
 		
-		void prerenderChunk(std::unordered_set<uint64_t>& updated, int32_t chunkX, int32_t chunkZ);
-		void updateBlock(std::unordered_set<uint64_t>& updated, int32_t x, int32_t y, int32_t z);
+		void findVisibleSections(glm::vec3 camPos, int renderDist, ViewFrustum& vf);
+		void cullGridNode(ViewFrustum& vf, int32_t x0, int32_t z0, int32_t x1, int32_t z1);
+		void cullGridCell(ViewFrustum& vf, int32_t gridX, int32_t gridZ, bool inside);
+		void queueMesh(ChunkIdxSet& updated, int32_t chunkX, int32_t chunkZ);
+		void updateBlock(ChunkIdxSet& updated, int32_t x, int32_t y, int32_t z);
 	};
 }
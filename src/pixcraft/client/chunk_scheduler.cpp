@@ -0,0 +1,150 @@
+#include "chunk_scheduler.hpp"
+
+#include <cmath>
+#include <tuple>
+#include <chrono>
+#include <algorithm>
+
+#include "pixcraft/server/chunk.hpp"
+#include "pixcraft/util/util.hpp"
+#include "pixcraft/util/trace.hpp"
+
+using namespace PixCraft;
+
+namespace {
+	bool inRange(int32_t relX, int32_t relZ, int renderDist) {
+		return abs(relX) <= renderDist + 1 && abs(relZ) <= renderDist + 1
+			&& relX*relX + relZ*relZ <= (renderDist + 2)*(renderDist + 2);
+	}
+}
+
+ChunkScheduler::ChunkScheduler(World& world, ChunkRenderer& renderer)
+	: world(world), chunkRenderer(renderer), _deterministic(false), scanned(false), centerX(0), centerZ(0), scannedDist(0),
+	  updateCount(0), prioritized(false) { }
+
+void ChunkScheduler::reset() {
+	scanned = false;
+	prioritized = false;
+	tasks.clear();
+	queued.clear();
+}
+
+bool ChunkScheduler::deterministic() { return _deterministic; }
+void ChunkScheduler::deterministic(bool enabled) { _deterministic = enabled; }
+
+size_t ChunkScheduler::pendingTaskCount() {
+	return tasks.size();
+}
+
+bool ChunkScheduler::needsWork(int32_t chunkX, int32_t chunkZ) {
+	return !world.isChunkLoaded(chunkX, chunkZ) || !chunkRenderer.isChunkRendered(chunkX, chunkZ);
+}
+
+void ChunkScheduler::scan(int32_t camChunkX, int32_t camChunkZ, int renderDist) {
+	// Drop the chunks that went out of range, and add the ones that came into it
+	tasks.erase(std::remove_if(tasks.begin(), tasks.end(), [&](ChunkTask& task) {
+		if(inRange(task.chunkX - camChunkX, task.chunkZ - camChunkZ, renderDist)) return false;
+		queued.erase(packCoords(task.chunkX, task.chunkZ));
+		return true;
+	}), tasks.end());
+	
+	for(int32_t relX = -renderDist - 1; relX <= renderDist + 1; ++relX) {
+		for(int32_t relZ = -renderDist - 1; relZ <= renderDist + 1; ++relZ) {
+			if(!inRange(relX, relZ, renderDist)) continue;
+			int32_t chunkX = camChunkX + relX, chunkZ = camChunkZ + relZ;
+			if(scanned && inRange(chunkX - centerX, chunkZ - centerZ, scannedDist)) continue;
+			if(!needsWork(chunkX, chunkZ) || !queued.insert(packCoords(chunkX, chunkZ)).second) continue;
+			tasks.push_back({ chunkX, chunkZ, 0.0f, 0 });
+		}
+	}
+	
+	scanned = true;
+	centerX = camChunkX; centerZ = camChunkZ;
+	scannedDist = renderDist;
+	prioritized = false;
+}
+
+float ChunkScheduler::getPriority(const ChunkTask& task, glm::vec2 camPos, glm::vec2 velocity, float bias, ViewFrustum& vf) {
+	// Chunks ahead of the player get closer, and those outside the view get farther
+	AABB box = {
+		glm::vec3(CHUNK_SIZE*task.chunkX - 0.5f, -0.5f, CHUNK_SIZE*task.chunkZ - 0.5f),
+		glm::vec3(CHUNK_SIZE*(task.chunkX+1) - 0.5f, CHUNK_HEIGHT - 0.5f, CHUNK_SIZE*(task.chunkZ+1) - 0.5f)
+	};
+	glm::vec2 offset = glm::vec2(box.min.x + box.max.x, box.min.z + box.max.z) / 2.0f - camPos;
+	float priority = glm::length(offset) - bias * glm::dot(offset, velocity);
+	if(!_deterministic && testBox(vf, box) == FrustumTest::outside) priority *= OUT_OF_VIEW_FACTOR;
+	return priority;
+}
+
+void ChunkScheduler::update(glm::vec3 camPos, glm::vec3 velocity, ViewFrustum& vf, int renderDist) {
+	TRACE_SCOPE("Schedule chunks");
+	auto start = std::chrono::steady_clock::now();
+	
+	int32_t camX, camY, camZ;
+	std::tie(camX, camY, camZ) = getBlockCoordsAt(camPos);
+	int32_t camChunkX, camChunkZ;
+	std::tie(camChunkX, camChunkZ) = World::getChunkPosAt(camX, camZ);
+	if(!scanned || camChunkX != centerX || camChunkZ != centerZ || renderDist != scannedDist)
+		scan(camChunkX, camChunkZ, renderDist);
+	TRACE_COUNTER("Chunk tasks", tasks.size());
+	if(tasks.empty()) return;
+	
+	glm::vec2 camPos2(camPos.x, camPos.z);
+	glm::vec2 velocity2(velocity.x, velocity.z);
+	float speed = glm::length(velocity2);
+	float bias = speed > 0 ? VELOCITY_BIAS * std::min(speed / SPEED_BIAS_SATURATION, 1.0f) / speed : 0;
+	updateCount++;
+	auto later = [](const ChunkTask& a, const ChunkTask& b) { return a.priority > b.priority; };
+	
+	// Rebuilding the heap is only worth it when most priorities changed; the far plane's normal is the view direction
+	glm::vec3 viewDir(vf.far.plane);
+	if(!prioritized || glm::distance(velocity2, prioritizedVelocity) > REPRIORITIZE_VELOCITY_CHANGE
+			|| (!_deterministic && glm::dot(viewDir, prioritizedViewDir) < REPRIORITIZE_VIEW_COS)) {
+		for(ChunkTask& task : tasks) {
+			task.priority = getPriority(task, camPos2, velocity2, bias, vf);
+			task.update = updateCount;
+		}
+		std::make_heap(tasks.begin(), tasks.end(), later);
+		prioritized = true;
+		prioritizedVelocity = velocity2;
+		prioritizedViewDir = viewDir;
+	}
+	
+	// Generating a chunk marks it to be meshed, so both kinds of work add a mesh
+	size_t meshes = chunkRenderer.pendingMeshCount() + world.requestedChunkCount();
+	int handled = 0;
+	while(!tasks.empty() && (_deterministic ? handled < DETERMINISTIC_TASKS_PER_UPDATE : meshes < MAX_PENDING_MESHES)) {
+		std::pop_heap(tasks.begin(), tasks.end(), later);
+		ChunkTask task = tasks.back();
+		tasks.pop_back();
+		if(task.update != updateCount) {
+			// The priority is from an earlier update: refresh it, and put the task back if another one now comes first
+			task.priority = getPriority(task, camPos2, velocity2, bias, vf);
+			task.update = updateCount;
+			if(!tasks.empty() && later(task, tasks.front())) {
+				tasks.push_back(task);
+				std::push_heap(tasks.begin(), tasks.end(), later);
+				continue;
+			}
+		}
+		queued.erase(packCoords(task.chunkX, task.chunkZ));
+		
+		if(!world.isChunkLoaded(task.chunkX, task.chunkZ)) {
+			// Chunks generated by workers are added whenever they are done, which would change the replays
+			if(_deterministic) {
+				world.genChunk(task.chunkX, task.chunkZ);
+				meshes++;
+			} else if(!world.isChunkRequested(task.chunkX, task.chunkZ)) {
+				world.requestChunk(task.chunkX, task.chunkZ);
+				meshes++;
+			}
+		} else if(!chunkRenderer.isChunkRendered(task.chunkX, task.chunkZ)) {
+			world.markChunkDirty(task.chunkX, task.chunkZ);
+			meshes++;
+		}
+		handled++;
+		
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		if(!_deterministic && elapsed.count() >= CHUNK_WORK_BUDGET_MS) break;
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <unordered_set>
+
+#include "pixcraft/util/glm.hpp"
+#include "pixcraft/server/world.hpp"
+#include "chunk_renderer.hpp"
+#include "view_frustum.hpp"
+
+namespace PixCraft {
+	#define CHUNK_WORK_BUDGET_MS 4.0
+	// Meshes are done in submission order, so only a few are queued at once to keep following the priorities
+	#define MAX_PENDING_MESHES 8
+	// How much chunks ahead of the player are favored when moving at SPEED_BIAS_SATURATION blocks/s or more
+	#define VELOCITY_BIAS 0.5f
+	#define SPEED_BIAS_SATURATION 10.0f
+	#define OUT_OF_VIEW_FACTOR 2.0f
+	// Besides when the player changes chunks, all priorities are recomputed when the velocity changes by this
+	// many blocks/s, or the view turns by more than the angle with this cosine; otherwise they are refreshed lazily
+	#define REPRIORITIZE_VELOCITY_CHANGE 1.0f
+	#define REPRIORITIZE_VIEW_COS 0.97f
+	#define DETERMINISTIC_TASKS_PER_UPDATE 2
+	
+	// Decides which chunks around the player to generate or mesh, nearest and most visible first.
+	// The chunks needing work are kept between frames, and only updated when the player changes chunks.
+	class ChunkScheduler {
+	public:
+		ChunkScheduler(World& world, ChunkRenderer& renderer);
+		
+		// Does as much work as fits in the time budget
+		void update(glm::vec3 camPos, glm::vec3 velocity, ViewFrustum& vf, int renderDist);
+		// Forgets which chunks were handled, e.g. after the chunk renderer is reset
+		void reset();
+		
+		// Whether the chunks generated in each update only depend on the player's movement, for recorded sessions to
+		// replay the same way: a fixed number of tasks is done instead of following the time budget and the meshers,
+		// chunks are generated on the main thread, and the view, which depends on the window's size, is ignored.
+		bool deterministic();
+		void deterministic(bool enabled);
+		
+		size_t pendingTaskCount();
+	
+	private:
+		struct ChunkTask {
+			int32_t chunkX, chunkZ;
+			float priority; // lower is sooner
+			uint32_t update; // in which the priority was computed
+		};
+		
+		World& world;
+		ChunkRenderer& chunkRenderer;
+		
+		bool _deterministic;
+		bool scanned;
+		int32_t centerX, centerZ;
+		int scannedDist;
+		uint32_t updateCount;
+		bool prioritized;
+		glm::vec2 prioritizedVelocity;
+		glm::vec3 prioritizedViewDir;
+		std::vector<ChunkTask> tasks; // heap with the lowest priority first
+		std::unordered_set<uint64_t> queued;
+		
+		bool needsWork(int32_t chunkX, int32_t chunkZ);
+		void scan(int32_t camChunkX, int32_t camChunkZ, int renderDist);
+		float getPriority(const ChunkTask& task, glm::vec2 camPos, glm::vec2 velocity, float bias, ViewFrustum& vf);
+	};
+}
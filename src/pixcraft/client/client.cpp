@@ -3,11 +3,22 @@
 #include <iostream>
 #include <stdexcept>
 #include <algorithm>
+#include <string>
+#include <cstdlib>
+#include <memory>
+#include <utility>
 
 #include "play_state.hpp"
 #include "menu_state.hpp"
+#include "render_benchmark.hpp"
+#include "profiler.hpp"
+#include "block_textures.hpp"
 
 #include "pixcraft/util/version.hpp"
+#include "pixcraft/util/trace.hpp"
+#include "pixcraft/util/jobs.hpp"
+#include "pixcraft/util/frame_arena.hpp"
+#include "pixcraft/util/alloc_tracking.hpp"
 
 using namespace PixCraft;
 
@@ -38,11 +49,13 @@ GameClient::GameClient() : width(START_WIDTH), height(START_HEIGHT), nextGameSta
 	glfwMakeContextCurrent(window);
 	if(!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress))
 		throw std::runtime_error("Failed to initialize GLAD");
+	loadOptionalGlFunctions((GLADloadproc) glfwGetProcAddress);
 	
 	std::cout << "Using OpenGL version " << GLVersion.major << "." << GLVersion.minor << std::endl;
 	
 	input.init(window);
 	textRenderer.init();
+	Profiler::init();
 	
 	glfwSetFramebufferSizeCallback(window, windowResizeCallback);
 	windowResizeCallback(window, width, height);
@@ -50,6 +63,7 @@ GameClient::GameClient() : width(START_WIDTH), height(START_HEIGHT), nextGameSta
 	
 	TextureManager::loadTextures();
 	BlockRegistry::defineBlocks();
+	BlockTextures::defineTextures();
 	Button::initRendering();
 	
 	gameState.reset(new MenuState(*this));
@@ -59,6 +73,7 @@ GameClient::GameClient() : width(START_WIDTH), height(START_HEIGHT), nextGameSta
 
 GameClient::~GameClient() {
 	textRenderer.free();
+	Profiler::free();
 	glfwDestroyWindow(window);
 }
 
@@ -101,13 +116,21 @@ void GameClient::run() {
 	double now = glfwGetTime();
 	double lastFrame = now;
 	double lastSecond = now;
+	TRACE_THREAD_NAME("Main");
 	while(!glfwWindowShouldClose(window)) {
+		TRACE_SCOPE("Frame");
 		if(nextGameState) {
 			gameState.reset(nextGameState);
 			nextGameState = nullptr;
 		}
 		
 		glfwPollEvents();
+		if(input.replayFinished()) {
+			std::cout << "Replayed " << input.replayedTicks() << " updates" << std::endl;
+			break;
+		}
+		dt = input.tick(dt);
+		Jobs::runCompletions();
 		gameState->update(dt);
 		if(input.justPressed(GLFW_KEY_F11)) {
 			fullscreen = !fullscreen;
@@ -127,6 +150,9 @@ void GameClient::run() {
 		input.clearAll();
 		
 		gameState->render(width, height);
+		Profiler::nextFrame();
+		AllocTracking::nextFrame();
+		frameArena().endFrame();
 		
 		now = glfwGetTime();
 		if(frameNo != 0) {
@@ -150,6 +176,7 @@ void GameClient::run() {
 			}
 		}
 		
+		TRACE_SCOPE("Swap buffers");
 		glfwSwapBuffers(window);
 	}
 }
@@ -178,12 +205,50 @@ void GameClient::setGameState(GameState* newGameState) {
 int GameClient::getFrameNo() { return frameNo; }
 int GameClient::getFPS() { return FPS; }
 
-int main() {
+int main(int argc, char** argv) {
 	glfwSetErrorCallback(glfwErrorCallback);
 	glfwInit();
 	
+	// pixcraft --render-benchmark <report.csv> [--frames <count>] [--checksums]
+	// pixcraft --flythrough <report.csv> [--seconds <duration>]
+	// pixcraft [--record <input.bin>] [--replay <input.bin>]
+	std::string benchmarkReport;
+	int benchmarkFrames = 600;
+	bool benchmarkChecksums = false;
+	std::string flythroughReport;
+	float flythroughSeconds = 60.0f;
+	std::string recordPath, replayPath;
+	for(int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if(arg == "--render-benchmark" && i + 1 < argc) benchmarkReport = argv[++i];
+		else if(arg == "--frames" && i + 1 < argc) benchmarkFrames = std::max(1, atoi(argv[++i]));
+		else if(arg == "--checksums") benchmarkChecksums = true;
+		else if(arg == "--flythrough" && i + 1 < argc) flythroughReport = argv[++i];
+		else if(arg == "--seconds" && i + 1 < argc) flythroughSeconds = std::max(1.0, atof(argv[++i]));
+		else if(arg == "--record" && i + 1 < argc) recordPath = argv[++i];
+		else if(arg == "--replay" && i + 1 < argc) replayPath = argv[++i];
+		else std::cout << "Unknown argument " << arg << std::endl;
+	}
+	
 	try {
+		if(!benchmarkReport.empty()) {
+			int res = runRenderBenchmark(benchmarkReport, benchmarkFrames, benchmarkChecksums);
+			glfwTerminate();
+			return res;
+		}
 		GameClient client;
+		if(!flythroughReport.empty()) {
+			// Frames aren't held back by the display, so that their times show the actual work
+			glfwSwapInterval(0);
+			std::unique_ptr<Flythrough> flythrough(new Flythrough(flythroughSeconds, flythroughReport));
+			client.setGameState(new PlayState(client, std::move(flythrough)));
+		}
+		if(!recordPath.empty()) client.getInputManager().recordTo(recordPath);
+		if(!replayPath.empty()) {
+			// The replay starts in the recorded world, without going through the menu
+			client.getInputManager().replayFrom(replayPath);
+			client.setGameState(new PlayState(client));
+		}
 		client.run();
 	} catch(std::runtime_error& err) {
 		std::cout << "A runtime error occured: " << err.what() << std::endl;
@@ -43,6 +43,7 @@ void EntityModel::init(TexId texture2, const std::array<float, vertexCount>& ver
 	_preModel = preModel;
 	
 	buffer.init(0, 3*sizeof(float), 5*sizeof(float));
+	buffer.memoryTag(MemoryTag::entities);
 	buffer.loadData(vertices.data(), vertexCount / 5, GL_STATIC_DRAW);
 	buffer.loadIndices(indices.data(), indexCount);
 	checkGlErrors("entity model initialization");
@@ -63,6 +64,7 @@ void EntityModel::render() {
 
 void EntityRenderer::init() {
 	program.init(ShaderSources::entityVS, ShaderSources::entityFS);
+	modelLocation = program.uniformLocation("model");
 	
 	glm::mat4 preModel = glm::translate(glm::scale(glm::mat4(1.0), glm::vec3(0.3f, 0.3f, 0.3f)), glm::vec3(0.0f, 1.0f, 0.0f));
 	slimeModel.init(TEX(SLIME), slimeVertices, slimeIndices, preModel);
@@ -107,7 +109,7 @@ void EntityRenderer::startRendering(glm::mat4 proj, glm::mat4 view, RenderParams
 void EntityRenderer::render(EntityModel& model, glm::mat4 modelMat) {
 	glm::mat4 preModel = model.preModel();
 	modelMat = modelMat * preModel;
-	program.setUniform("model", modelMat);
+	program.setUniform(modelLocation, modelMat);
 	
 	model.render();
 }
@@ -36,6 +36,7 @@ namespace PixCraft {
 		
 	private:
 		ShaderProgram program;
+		GLint modelLocation; // set for each entity
 		
 		EntityModel slimeModel;
 		
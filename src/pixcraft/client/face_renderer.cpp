@@ -3,6 +3,7 @@
 #include <stdexcept>
 #include <string>
 #include <cstddef>
+#include <algorithm>
 
 #include "pixcraft/util/util.hpp"
 
@@ -18,107 +19,405 @@ const std::array<glm::mat3, 6> sideTransforms = {
 };
 
 
+FaceArena::FaceArena()
+	: allocator(ARENA_BLOCK_FACES, ARENA_INITIAL_ORDERS), originBuffer(0), originTexture(0), faceTexture(0), pullVao(0),
+	  quadIndexBuffer(0), quadIndexCapacity(0), maxCapacity(0), maxPulledFaces(0), queuedEnd(0) { }
+
+FaceArena::~FaceArena() {
+	if(originBuffer != 0)
+		MemoryStats::addGpu(MemoryTag::chunkMeshes, -(int64_t) ((origins.size() + 6*quadIndexCapacity) * sizeof(int32_t)));
+	if(pullVao != 0) glDeleteVertexArrays(1, &pullVao);
+	if(quadIndexBuffer != 0) glDeleteBuffers(1, &quadIndexBuffer);
+	if(faceTexture != 0) glDeleteTextures(1, &faceTexture);
+	if(originTexture != 0) glDeleteTextures(1, &originTexture);
+	if(originBuffer != 0) glDeleteBuffers(1, &originBuffer);
+}
+
+void FaceArena::init() {
+	GLint maxTexels;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+	// One origin texel per block; the allocator's capacity must also stay within 32 bits
+	maxCapacity = (uint32_t) std::min((uint64_t) maxTexels * ARENA_BLOCK_FACES, (uint64_t) 1 << 31);
+	maxPulledFaces = maxTexels / (sizeof(FaceData) / sizeof(uint16_t));
+	
+	buffer.init(offsetof(FaceData, offsetX), offsetof(FaceData, side), offsetof(FaceData, width),
+		offsetof(FaceData, skyLight), offsetof(FaceData, texId), sizeof(FaceData));
+	buffer.memoryTag(MemoryTag::chunkMeshes);
+	buffer.loadData(nullptr, allocator.capacity(), GL_DYNAMIC_DRAW);
+	
+	origins.resize(2 * allocator.capacity() / ARENA_BLOCK_FACES);
+	glGenBuffers(1, &originBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, originBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, origins.size() * sizeof(int32_t), origins.data(), GL_DYNAMIC_DRAW);
+	MemoryStats::addGpu(MemoryTag::chunkMeshes, origins.size() * sizeof(int32_t));
+	glGenTextures(1, &originTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, originTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32I, originBuffer);
+	
+	// FaceData is 12 bytes long, which is only a valid texel size from OpenGL 4.0 on, so the faces are read as 16-bit words
+	glGenTextures(1, &faceTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, faceTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_R16UI, buffer.bufferId());
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+	
+	glGenVertexArrays(1, &pullVao);
+	glGenBuffers(1, &quadIndexBuffer);
+	checkGlErrors("face arena initialization");
+}
+
+uint32_t FaceArena::allocate(uint32_t faceCount, int32_t originX, int32_t originZ) {
+	uint32_t offset;
+	bool grown = false;
+	size_t oldOriginCount = origins.size();
+	while((offset = allocator.allocate(faceCount)) == BuddyAllocator::INVALID) {
+		if(allocator.capacity() > maxCapacity / 2) throw std::runtime_error("Face arena is full");
+		allocator.grow();
+		buffer.resize(allocator.capacity(), GL_DYNAMIC_DRAW);
+		origins.resize(2 * allocator.capacity() / ARENA_BLOCK_FACES);
+		grown = true;
+	}
+	
+	uint32_t firstBlock = offset / ARENA_BLOCK_FACES;
+	uint32_t blockCount = allocator.blockSize(offset) / ARENA_BLOCK_FACES;
+	for(uint32_t block = firstBlock; block < firstBlock + blockCount; ++block) {
+		origins[2*block] = originX;
+		origins[2*block + 1] = originZ;
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, originBuffer);
+	if(grown) {
+		glBufferData(GL_TEXTURE_BUFFER, origins.size() * sizeof(int32_t), origins.data(), GL_DYNAMIC_DRAW);
+		MemoryStats::addGpu(MemoryTag::chunkMeshes, (origins.size() - oldOriginCount) * sizeof(int32_t));
+		glBindTexture(GL_TEXTURE_BUFFER, faceTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_R16UI, buffer.bufferId());
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+	} else {
+		glBufferSubData(GL_TEXTURE_BUFFER, 2*firstBlock * sizeof(int32_t), 2*blockCount * sizeof(int32_t), &origins[2*firstBlock]);
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	return offset;
+}
+
+void FaceArena::free(uint32_t offset) {
+	allocator.free(offset);
+}
+
+uint32_t FaceArena::rangeSize(uint32_t offset) {
+	return allocator.blockSize(offset);
+}
+
+void FaceArena::upload(const FaceData* faces, uint32_t offset, uint32_t count) {
+	buffer.updateData(faces, offset, count);
+}
+
+void FaceArena::queueDraw(uint32_t offset, uint32_t count) {
+	drawFirsts.push_back(offset);
+	drawCounts.push_back(count);
+	queuedEnd = std::max(queuedEnd, offset + count);
+}
+
+bool FaceArena::canPull() {
+	return queuedEnd <= maxPulledFaces;
+}
+
+void FaceArena::draw(bool vertexPulling) {
+	if(drawFirsts.empty()) return;
+	if(vertexPulling) {
+		// Each face is drawn as two indexed triangles, so that the 4 corners are only shaded once;
+		// the base vertex gives the first face of the range.
+		uint32_t maxCount = *std::max_element(drawCounts.begin(), drawCounts.end());
+		glBindVertexArray(pullVao);
+		reserveQuadIndices(maxCount);
+		drawIndexOffsets.assign(drawFirsts.size(), nullptr);
+		for(size_t i = 0; i < drawFirsts.size(); ++i) {
+			drawFirsts[i] *= 4;
+			drawCounts[i] *= 6;
+		}
+		glMultiDrawElementsBaseVertex(GL_TRIANGLES, drawCounts.data(), GL_UNSIGNED_INT,
+			drawIndexOffsets.data(), drawFirsts.size(), drawFirsts.data());
+		glBindVertexArray(0);
+	} else {
+		buffer.bind();
+		glMultiDrawArrays(GL_POINTS, drawFirsts.data(), drawCounts.data(), drawFirsts.size());
+		buffer.unbind();
+	}
+	drawFirsts.clear();
+	drawCounts.clear();
+	queuedEnd = 0;
+}
+
+void FaceArena::bindTextures() {
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_BUFFER, originTexture);
+	glActiveTexture(GL_TEXTURE2);
+	glBindTexture(GL_TEXTURE_BUFFER, faceTexture);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void FaceArena::reserveQuadIndices(uint32_t faceCount) {
+	if(faceCount <= quadIndexCapacity) return;
+	uint32_t oldCapacity = quadIndexCapacity;
+	while(quadIndexCapacity < faceCount) quadIndexCapacity = std::max(2*quadIndexCapacity, (uint32_t) ARENA_BLOCK_FACES);
+	
+	// Corners are numbered like in block.gs: (0,0), (1,0), (0,1), (1,1)
+	std::vector<uint32_t> indices;
+	indices.reserve(6*quadIndexCapacity);
+	for(uint32_t face = 0; face < quadIndexCapacity; ++face) {
+		for(uint32_t corner : { 0, 1, 2, 2, 1, 3 }) indices.push_back(4*face + corner);
+	}
+	// The element array binding is part of the bound VAO
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadIndexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+	MemoryStats::addGpu(MemoryTag::chunkMeshes, 6*(quadIndexCapacity - oldCapacity) * sizeof(uint32_t));
+}
+
+size_t FaceArena::capacity() { return allocator.capacity(); }
+size_t FaceArena::usedSize() { return allocator.usedSize(); }
+size_t FaceArena::pullableSize() { return std::min(allocator.capacity(), maxPulledFaces); }
+
+void FaceArena::reportMemory(MemoryReport& report) {
+	report.addCpu(MemoryTag::chunkMeshes, heapBytes(origins) + heapBytes(drawFirsts) + heapBytes(drawCounts) + heapBytes(drawIndexOffsets));
+}
+
+
+FaceBuffer::FaceBuffer() : arena(nullptr), originX(0), originZ(0), arenaOffset(0), arenaCapacity(0), fullUpload(false) { }
+
+FaceBuffer::~FaceBuffer() {
+	if(arena != nullptr && arenaCapacity != 0) arena->free(arenaOffset);
+}
+
 void FaceBuffer::init(FaceRenderer& faceRenderer, int capacity) {
-	buffer.init(offsetof(FaceData, offsetX), offsetof(FaceData, side),
-		offsetof(FaceData, texId), sizeof(FaceData));
+	buffer.init(offsetof(FaceData, offsetX), offsetof(FaceData, side), offsetof(FaceData, width),
+		offsetof(FaceData, skyLight), offsetof(FaceData, texId), sizeof(FaceData));
 	buffer.loadData(nullptr, capacity, GL_STATIC_DRAW);
 	faces.reserve(capacity);
 	checkGlErrors("face buffer initialization");
 }
 
+void FaceBuffer::init(FaceArena& arena2, int32_t originX2, int32_t originZ2) {
+	arena = &arena2;
+	originX = originX2; originZ = originZ2;
+}
+
 bool FaceBuffer::isInitialized() {
-	return buffer.isInitialized();
+	return arena != nullptr || buffer.isInitialized();
 }
 
 void FaceBuffer::prerender() {
-	size_t faceCount = faces.size();
-	if(faceCount > buffer.vertexCount()) throw std::logic_error("Too many faces loaded into FaceBuffer");
-	buffer.updateData(faces.data(), faceCount);
+	upload(0, faces.size());
 }
 
-void FaceBuffer::eraseFaces(int8_t x, int8_t y, int8_t z) {
-	size_t i = 0;
-	while(i < faces.size()) {
-		FaceData& face = faces[i];
-		if(face.offsetX == (float) x && face.offsetY == (float) y && face.offsetZ == (float) z) {
-			faces.erase(faces.begin() + i);
-		} else {
-			i++;
-		}
+void FaceBuffer::setGroupCount(uint32_t groupCount) {
+	groups.resize(groupCount);
+	clear();
+}
+
+void FaceBuffer::clear() {
+	faces.clear();
+	faceGroups.clear();
+	groupPositions.clear();
+	for(std::vector<uint32_t>& group : groups) group.clear();
+	dirtyFaces.clear();
+	fullUpload = true;
+}
+
+void FaceBuffer::addFace(uint32_t group, FaceData face) {
+	uint32_t idx = faces.size();
+	faces.push_back(face);
+	faceGroups.push_back(group);
+	groupPositions.push_back(groups[group].size());
+	groups[group].push_back(idx);
+	if(!fullUpload) dirtyFaces.push_back(idx);
+}
+
+void FaceBuffer::eraseGroup(uint32_t group) {
+	std::vector<uint32_t>& groupFaces = groups[group];
+	while(!groupFaces.empty()) eraseFace(groupFaces.back());
+}
+
+void FaceBuffer::eraseFace(uint32_t idx) {
+	// Remove the face from its group
+	std::vector<uint32_t>& group = groups[faceGroups[idx]];
+	uint32_t pos = groupPositions[idx];
+	group[pos] = group.back();
+	groupPositions[group[pos]] = pos;
+	group.pop_back();
+	
+	// Move the last face into the hole
+	uint32_t last = faces.size() - 1;
+	if(idx != last) {
+		faces[idx] = faces[last];
+		faceGroups[idx] = faceGroups[last];
+		groupPositions[idx] = groupPositions[last];
+		groups[faceGroups[idx]][groupPositions[idx]] = idx;
+		if(!fullUpload) dirtyFaces.push_back(idx);
 	}
+	faces.pop_back();
+	faceGroups.pop_back();
+	groupPositions.pop_back();
 }
 
-void FaceBuffer::erasePlaneX(int8_t x) {
+void FaceBuffer::uploadChanges() {
+	// Move to a range of the arena that fits, if the faces outgrew their range or use much less than it
+	if(arena != nullptr && (faces.size() > arenaCapacity || (fullUpload && 4*faces.size() < arenaCapacity))) {
+		if(arenaCapacity != 0) arena->free(arenaOffset);
+		arenaCapacity = 0;
+		if(!faces.empty()) {
+			arenaOffset = arena->allocate(faces.size(), originX, originZ);
+			arenaCapacity = arena->rangeSize(arenaOffset);
+		}
+		fullUpload = true;
+	}
+	
+	if(fullUpload) {
+		prerender();
+		dirtyFaces.clear();
+		fullUpload = false;
+		return;
+	}
+	if(dirtyFaces.empty()) return;
+	
+	// Upload contiguous runs of changed faces; faces past the end were removed and need no upload
+	std::sort(dirtyFaces.begin(), dirtyFaces.end());
 	size_t i = 0;
-	while(i < faces.size()) {
-		FaceData& face = faces[i];
-		if(face.offsetX == (float) x) {
-			faces.erase(faces.begin() + i);
-		} else {
-			i++;
+	while(i < dirtyFaces.size() && dirtyFaces[i] < faces.size()) {
+		uint32_t start = dirtyFaces[i];
+		uint32_t end = start + 1;
+		while(++i < dirtyFaces.size() && dirtyFaces[i] <= end && dirtyFaces[i] < faces.size()) {
+			end = dirtyFaces[i] + 1;
 		}
+		upload(start, end - start);
 	}
+	dirtyFaces.clear();
 }
 
-void FaceBuffer::erasePlaneZ(int8_t z) {
-	size_t i = 0;
-	while(i < faces.size()) {
-		FaceData& face = faces[i];
-		if(face.offsetZ == (float) z) {
-			faces.erase(faces.begin() + i);
-		} else {
-			i++;
-		}
+void FaceBuffer::upload(uint32_t first, uint32_t count) {
+	if(count == 0) return;
+	if(arena != nullptr) {
+		arena->upload(&faces[first], arenaOffset + first, count);
+	} else {
+		if(first + count > buffer.vertexCount()) throw std::logic_error("Too many faces loaded into FaceBuffer");
+		buffer.updateData(&faces[first], first, count);
 	}
 }
 
 void FaceBuffer::render() {
+	if(arena != nullptr) {
+		if(!faces.empty()) arena->queueDraw(arenaOffset, faces.size());
+		return;
+	}
 	buffer.bind();
 	glDrawArrays(GL_POINTS, 0, faces.size());
 	buffer.unbind();
 }
 
+void FaceBuffer::reportMemory(MemoryReport& report) {
+	size_t bytes = heapBytes(faces) + heapBytes(faceGroups) + heapBytes(groupPositions) + heapBytes(groups) + heapBytes(dirtyFaces);
+	for(auto& group : groups) bytes += heapBytes(group);
+	report.addCpu(MemoryTag::chunkMeshes, bytes);
+}
 
-FaceRenderer::FaceRenderer() { }
+
+FaceRenderer::FaceRenderer() : _vertexPulling(false) { }
 
 void FaceRenderer::init() {
 	program.init(ShaderSources::blockVS, ShaderSources::blockGS, ShaderSources::blockFS);
+	pullProgram.init(ShaderSources::blockPullVS, ShaderSources::blockFS);
+	uniforms = findUniforms(program);
+	pullUniforms = findUniforms(pullProgram);
+	setProgramConstants(program);
+	setProgramConstants(pullProgram);
 	checkGlErrors("face renderer initialization");
 }
 
 void FaceRenderer::setParams(RenderParams params) {
-	program.setUniform("applyView", params.applyView);
-	program.setUniform("applyFog", params.applyFog);
-	program.setUniform("fogColor", params.skyColor[0], params.skyColor[1], params.skyColor[2], 1.0f);
-	program.setUniform("fogStart", params.fogStart);
-	program.setUniform("fogEnd", params.fogEnd);
+	setProgramParams(program, uniforms, params);
 }
 
 void FaceRenderer::startRendering(glm::mat4 proj, glm::mat4 view, RenderParams params) {
+	// The pulling program only draws the arena, so its uniforms are only needed when it is enabled
+	if(_vertexPulling) {
+		pullProgram.use();
+		setProgramUniforms(pullProgram, pullUniforms, proj, view, params);
+	}
 	program.use();
-	
-	setParams(params);
-	
-	program.setUniform("view", view);
-	program.setUniform("proj", proj);
-	program.setUniformArray("sideTransforms", sideTransforms);
-	
-	program.setUniform("texArray", (uint32_t) 0);
-	
-	program.setUniform("ambientLight", 0.7f);
-	program.setUniform("diffuseLight", 0.3f);
-	glm::vec3 lightSrcDir = glm::normalize(glm::vec3(0.5f, 1.0f, 0.1f));
-	program.setUniform("lightSrcDir", lightSrcDir);
+	setProgramUniforms(program, uniforms, proj, view, params);
 	
 	TextureManager::bindBlockTextureArray();
 }
 
 void FaceRenderer::render(FaceBuffer& buffer, glm::mat4 model) {
-	program.setUniform("model", model);
+	program.setUniform(uniforms.model, model);
 	
 	buffer.render();
 }
 
+void FaceRenderer::render(FaceArena& arena) {
+	glm::mat4 model(1.0f);
+	arena.bindTextures();
+	// The allocator takes the first free block that fits, so ranges reach past the face texture only when
+	// the arena holds that many faces; views that draw them fall back to the geometry shader
+	if(_vertexPulling && arena.canPull()) {
+		pullProgram.use();
+		pullProgram.setUniform(pullUniforms.model, model);
+		arena.draw(true);
+		program.use();
+	} else {
+		program.setUniform(uniforms.model, model);
+		program.setUniform(uniforms.useChunkOrigins, true);
+		arena.draw(false);
+		program.setUniform(uniforms.useChunkOrigins, false);
+	}
+}
+
 void FaceRenderer::stopRendering() {
 	program.unuse();
 }
+
+bool FaceRenderer::vertexPulling() { return _vertexPulling; }
+void FaceRenderer::vertexPulling(bool enabled) { _vertexPulling = enabled; }
+
+FaceRenderer::Uniforms FaceRenderer::findUniforms(ShaderProgram& shader) {
+	Uniforms locations;
+	locations.model = shader.uniformLocation("model");
+	locations.view = shader.uniformLocation("view");
+	locations.proj = shader.uniformLocation("proj");
+	locations.useChunkOrigins = shader.uniformLocation("useChunkOrigins");
+	locations.applyView = shader.uniformLocation("applyView");
+	locations.applyFog = shader.uniformLocation("applyFog");
+	locations.fogColor = shader.uniformLocation("fogColor");
+	locations.fogStart = shader.uniformLocation("fogStart");
+	locations.fogEnd = shader.uniformLocation("fogEnd");
+	return locations;
+}
+
+void FaceRenderer::setProgramParams(ShaderProgram& shader, Uniforms& locations, RenderParams params) {
+	shader.setUniform(locations.applyView, params.applyView);
+	shader.setUniform(locations.applyFog, params.applyFog);
+	shader.setUniform(locations.fogColor, params.skyColor[0], params.skyColor[1], params.skyColor[2], 1.0f);
+	shader.setUniform(locations.fogStart, params.fogStart);
+	shader.setUniform(locations.fogEnd, params.fogEnd);
+}
+
+void FaceRenderer::setProgramUniforms(ShaderProgram& shader, Uniforms& locations, glm::mat4 proj, glm::mat4 view, RenderParams params) {
+	setProgramParams(shader, locations, params);
+	
+	shader.setUniform(locations.view, view);
+	shader.setUniform(locations.proj, proj);
+}
+
+void FaceRenderer::setProgramConstants(ShaderProgram& shader) {
+	shader.use();
+	shader.setUniformArray("sideTransforms", sideTransforms);
+	
+	shader.setUniform("texArray", (uint32_t) 0);
+	shader.setUniform("chunkOrigins", (uint32_t) 1);
+	shader.setUniform("faceData", (uint32_t) 2);
+	shader.setUniform("originBlockSize", (uint32_t) ARENA_BLOCK_FACES);
+	shader.setUniform("useChunkOrigins", false);
+	
+	shader.setUniform("ambientLight", 0.7f);
+	shader.setUniform("diffuseLight", 0.3f);
+	glm::vec3 lightSrcDir = glm::normalize(glm::vec3(0.5f, 1.0f, 0.1f));
+	shader.setUniform("lightSrcDir", lightSrcDir);
+	shader.unuse();
+}
@@ -8,35 +8,108 @@
 
 #include "shaders.hpp"
 #include "textures.hpp"
+#include "chunk_mesher.hpp"
+#include "pixcraft/util/buddy_allocator.hpp"
 
 namespace PixCraft {
-	struct FaceData {
-		uint8_t offsetX;
-		uint8_t offsetY;
-		uint8_t offsetZ;
-		uint8_t side;
-		TexId texId;
-	} __attribute__((packed));
-	// ^^^ It works without the __attribute__, but adding it allows sending less data to the GPU
-	
 	class FaceRenderer;
 	
+	#define ARENA_BLOCK_FACES 256
+	#define ARENA_INITIAL_ORDERS 13
+	
+	// A single vertex buffer holding the faces of all chunks, so that they can be drawn with one call per pass.
+	// The origin of the chunk owning each block of the arena is stored in a texture buffer for the vertex shader.
+	// With vertex pulling, the faces themselves are also read through a texture buffer.
+	// Texture buffers are clamped to GL_MAX_TEXTURE_BUFFER_SIZE texels, which bounds the growth of the arena through
+	// the origins, and limits vertex pulling to the faces at the start of the arena.
+	class FaceArena {
+	public:
+		FaceArena();
+		~FaceArena();
+		void init();
+		
+		// Returns the offset of a range of at least faceCount faces, positioned relative to the given origin
+		uint32_t allocate(uint32_t faceCount, int32_t originX, int32_t originZ);
+		void free(uint32_t offset);
+		uint32_t rangeSize(uint32_t offset);
+		void upload(const FaceData* faces, uint32_t offset, uint32_t count);
+		
+		void queueDraw(uint32_t offset, uint32_t count);
+		// Whether the queued ranges can be drawn with vertex pulling
+		bool canPull();
+		// Draws all the queued ranges
+		void draw(bool vertexPulling);
+		void bindTextures();
+		
+		size_t capacity();
+		size_t usedSize();
+		size_t pullableSize(); // faces at the start of the arena that the face texture covers
+		void reportMemory(MemoryReport& report);
+		
+	private:
+		VertexBuffer<glm::uvec3, uint8_t, glm::uvec2, glm::uvec2, uint32_t> buffer;
+		BuddyAllocator allocator;
+		
+		std::vector<int32_t> origins;
+		GlId originBuffer, originTexture;
+		GlId faceTexture;
+		GlId pullVao; // no attributes, only the quad indices
+		GlId quadIndexBuffer;
+		uint32_t quadIndexCapacity; // in faces
+		uint32_t maxCapacity; // in faces
+		uint32_t maxPulledFaces;
+		uint32_t queuedEnd; // end of the last queued range
+		
+		std::vector<GLint> drawFirsts;
+		std::vector<GLsizei> drawCounts;
+		std::vector<GLvoid*> drawIndexOffsets;
+		
+		void reserveQuadIndices(uint32_t faceCount);
+	};
+	
 	class FaceBuffer {
 	public:
+		FaceBuffer();
+		~FaceBuffer();
+		
+		// The faces are either stored in a buffer of their own, or in a range of an arena
 		void init(FaceRenderer& faceRenderer, int capacity);
+		void init(FaceArena& arena, int32_t originX, int32_t originZ);
 		bool isInitialized();
 		
 		std::vector<FaceData> faces;
 		
+		// Uploads all the faces
 		void prerender();
-		void eraseFaces(int8_t x, int8_t y, int8_t z);
-		void erasePlaneX(int8_t x);
-		void erasePlaneZ(int8_t z);
 		
+		// Faces can also be managed in groups (e.g. the slices of a chunk), in which case
+		// only the changed parts of the buffer are uploaded by uploadChanges.
+		void setGroupCount(uint32_t groupCount);
+		void clear();
+		void addFace(uint32_t group, FaceData face);
+		void eraseGroup(uint32_t group);
+		void uploadChanges();
+		
+		// With an arena, this only queues the faces to be drawn with the arena
 		void render();
 		
+		void reportMemory(MemoryReport& report);
+	
 	private:
-		VertexBuffer<glm::uvec3, uint8_t, uint32_t> buffer;
+		VertexBuffer<glm::uvec3, uint8_t, glm::uvec2, glm::uvec2, uint32_t> buffer;
+		
+		FaceArena* arena;
+		int32_t originX, originZ;
+		uint32_t arenaOffset, arenaCapacity;
+		
+		std::vector<uint32_t> faceGroups; // group of each face
+		std::vector<uint32_t> groupPositions; // index of each face in the list of its group
+		std::vector<std::vector<uint32_t>> groups; // indices of the faces in each group
+		std::vector<uint32_t> dirtyFaces;
+		bool fullUpload;
+		
+		void eraseFace(uint32_t idx);
+		void upload(uint32_t first, uint32_t count);
 	};
 	
 	class FaceRenderer {
@@ -47,9 +120,30 @@ namespace PixCraft {
 		void setParams(RenderParams params);
 		void startRendering(glm::mat4 proj, glm::mat4 view, RenderParams params);
 		void render(FaceBuffer& buffer, glm::mat4 model);
+		void render(FaceArena& arena);
 		void stopRendering();
 		
+		// Whether the arena is drawn by pulling the faces in the vertex shader instead of using the geometry shader
+		bool vertexPulling();
+		void vertexPulling(bool enabled);
+		
 	private:
+		// Locations of the uniforms set while rendering, looked up once after linking
+		struct Uniforms {
+			GLint model, view, proj;
+			GLint useChunkOrigins;
+			GLint applyView, applyFog, fogColor, fogStart, fogEnd;
+		};
+		
 		ShaderProgram program;
+		ShaderProgram pullProgram;
+		Uniforms uniforms, pullUniforms;
+		bool _vertexPulling;
+		
+		static Uniforms findUniforms(ShaderProgram& shader);
+		void setProgramParams(ShaderProgram& shader, Uniforms& locations, RenderParams params);
+		void setProgramUniforms(ShaderProgram& shader, Uniforms& locations, glm::mat4 proj, glm::mat4 view, RenderParams params);
+		// Uniforms that never change, set once after linking
+		void setProgramConstants(ShaderProgram& shader);
 	};
 }
@@ -0,0 +1,176 @@
+#include "flythrough.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+#include "glfw.hpp"
+#include "pixcraft/server/blocks.hpp"
+#include "pixcraft/util/util.hpp"
+
+using namespace PixCraft;
+
+namespace {
+	struct FlythroughLeg {
+		float share; // of the flythrough's duration
+		float speed; // blocks/s
+		float turnRate; // rad/s
+		float pitch;
+		bool edits;
+	};
+	
+	const FlythroughLeg LEGS[] = {
+		{ 0.10f,  0.0f,  0.0f, -0.3f, false }, // spawn area loading
+		{ 0.20f, 10.0f,  0.2f, -0.3f, false }, // flying speed
+		{ 0.20f,  2.0f,  0.6f, -0.8f, true },  // breaking and placing blocks over loaded terrain
+		{ 0.25f, 60.0f,  0.1f, -0.2f, false }, // faster than the chunks can load
+		{ 0.25f, 60.0f, -0.4f, -0.2f, false }, // turning back through new and old terrain
+	};
+	const size_t LEG_COUNT = sizeof(LEGS) / sizeof(LEGS[0]);
+	
+	const float EDIT_REACH = 32.0f;
+	
+	double percentile(std::vector<double> values, double p) {
+		if(values.empty()) return 0.0;
+		std::sort(values.begin(), values.end());
+		return values[std::min((size_t) (p * values.size()), values.size() - 1)];
+	}
+	
+	void printSummary(const char* name, const std::vector<double>& values) {
+		std::cout << std::fixed << std::setprecision(2) << name << ": median " << percentile(values, 0.5)
+			<< " ms, 95th percentile " << percentile(values, 0.95) << " ms, 99th percentile " << percentile(values, 0.99)
+			<< " ms, max " << percentile(values, 1.0) << " ms" << std::endl;
+	}
+}
+
+Flythrough::Flythrough(float duration, std::string reportPath)
+	: duration(duration), reportPath(reportPath), time(0.0f), pathTime(0.0f), pathPos(8.0f, FLYTHROUGH_HEIGHT, 8.0f),
+	  heading(0.0f), nextEdit(0.0f), edits(0), lastFrameTime(-1.0), startMeshStats() { }
+
+bool Flythrough::finished() {
+	return time >= duration;
+}
+
+void Flythrough::update(float dt, Player& player, World& world) {
+	time = std::min(time + dt, duration);
+	player.movementMode(MovementMode::noClip);
+	while(pathTime + FLYTHROUGH_STEP <= time) {
+		step(player, world);
+	}
+}
+
+void Flythrough::step(Player& player, World& world) {
+	// Find the leg the step is in
+	float legStart = 0.0f;
+	size_t legIdx = 0;
+	while(legIdx + 1 < LEG_COUNT && pathTime >= legStart + LEGS[legIdx].share * duration) {
+		legStart += LEGS[legIdx].share * duration;
+		legIdx++;
+	}
+	const FlythroughLeg& leg = LEGS[legIdx];
+	
+	heading += leg.turnRate * FLYTHROUGH_STEP;
+	glm::vec3 velocity = leg.speed * glm::vec3(-sin(heading), 0.0f, -cos(heading));
+	pathPos += FLYTHROUGH_STEP * velocity;
+	pathPos.y = FLYTHROUGH_HEIGHT + 4.0f * sin(0.5f * pathTime);
+	pathTime += FLYTHROUGH_STEP;
+	
+	player.pos(pathPos);
+	player.speed(velocity);
+	player.orient(glm::vec3(leg.pitch, heading, 0.0f));
+	
+	if(leg.edits && pathTime >= nextEdit) {
+		editBlock(player, world);
+		nextEdit = pathTime + FLYTHROUGH_EDIT_INTERVAL;
+	}
+}
+
+void Flythrough::editBlock(Player& player, World& world) {
+	RaycastHit target = player.castRay(EDIT_REACH, false);
+	if(!target.hit) return;
+	// Break a block, then place planks, then a lamp that lights its surroundings
+	size_t kind = edits % 3;
+	if(kind == 0) {
+		world.removeBlock(target.x, target.y, target.z);
+	} else {
+		int32_t x = target.x + sideVectors[target.face][0];
+		int32_t y = target.y + sideVectors[target.face][1];
+		int32_t z = target.z + sideVectors[target.face][2];
+		if(!World::isValidHeight(y) || world.hasSolidBlock(x, y, z)) return;
+		world.setBlock(x, y, z, Block::fromId(kind == 1 ? BlockRegistry::PLANKS_ID : BlockRegistry::LAMP_ID));
+	}
+	edits++;
+}
+
+void Flythrough::recordFrame(Player& player, ChunkRenderer& chunkRenderer, int renderDist) {
+	double now = glfwGetTime();
+	if(lastFrameTime < 0) {
+		startMeshStats = chunkRenderer.getMeshStats();
+	} else {
+		frames.push_back({ time, (now - lastFrameTime) * 1000.0, chunkRenderer.renderedChunkCount(), chunkRenderer.pendingMeshCount() });
+	}
+	lastFrameTime = now;
+	
+	// A chunk's latency goes from when it comes within the render distance to when its mesh is applied,
+	// and is 0 if it was already meshed by then.
+	int32_t x, y, z;
+	std::tie(x, y, z) = getBlockCoordsAt(player.pos());
+	int32_t camChunkX, camChunkZ;
+	std::tie(camChunkX, camChunkZ) = World::getChunkPosAt(x, z);
+	auto inRange = [&](int32_t chunkX, int32_t chunkZ) {
+		int32_t relX = chunkX - camChunkX, relZ = chunkZ - camChunkZ;
+		return relX*relX + relZ*relZ <= renderDist*renderDist;
+	};
+	for(auto iter = rangeChunks.begin(); iter != rangeChunks.end();) {
+		int32_t chunkX, chunkZ;
+		std::tie(chunkX, chunkZ) = unpackCoords(iter->first);
+		if(!inRange(chunkX, chunkZ)) {
+			iter = rangeChunks.erase(iter);
+			continue;
+		}
+		if(iter->second >= 0 && chunkRenderer.isChunkMeshed(chunkX, chunkZ)) {
+			loadLatencies.push_back((now - iter->second) * 1000.0);
+			iter->second = -1.0;
+		}
+		++iter;
+	}
+	for(int32_t chunkX = camChunkX - renderDist; chunkX <= camChunkX + renderDist; ++chunkX) {
+		for(int32_t chunkZ = camChunkZ - renderDist; chunkZ <= camChunkZ + renderDist; ++chunkZ) {
+			if(!inRange(chunkX, chunkZ) || !rangeChunks.emplace(packCoords(chunkX, chunkZ), now).second) continue;
+			if(chunkRenderer.isChunkMeshed(chunkX, chunkZ)) {
+				loadLatencies.push_back(0.0);
+				rangeChunks[packCoords(chunkX, chunkZ)] = -1.0;
+			}
+		}
+	}
+}
+
+void Flythrough::writeReport(ChunkRenderer& chunkRenderer) {
+	std::ofstream file(reportPath);
+	if(!file) throw std::runtime_error("Failed to open flythrough report " + reportPath);
+	file << "frame,time_s,frame_ms,rendered_chunks,pending_meshes\n";
+	std::vector<double> frameTimes;
+	for(size_t frame = 0; frame < frames.size(); ++frame) {
+		FlythroughFrame& stats = frames[frame];
+		file << frame << "," << std::fixed << std::setprecision(4) << stats.time << "," << stats.frameMs
+			<< "," << stats.renderedChunks << "," << stats.pendingMeshes << "\n";
+		frameTimes.push_back(stats.frameMs);
+	}
+	
+	MeshStats& meshStats = chunkRenderer.getMeshStats();
+	std::cout << "Flew for " << duration << " s in " << frames.size() << " frames, with " << edits << " block edits" << std::endl;
+	printSummary("Frame time", frameTimes);
+	size_t stillLoading = std::count_if(rangeChunks.begin(), rangeChunks.end(), [](const std::pair<const uint64_t, double>& entry) {
+		return entry.second >= 0;
+	});
+	std::cout << "Chunks that came into range: " << loadLatencies.size() + stillLoading << ", still loading: " << stillLoading << std::endl;
+	printSummary("Chunk load latency", loadLatencies);
+	std::cout << "Full meshes: " << meshStats.fullMeshes - startMeshStats.fullMeshes
+		<< ", discarded meshes: " << meshStats.discardedMeshes - startMeshStats.discardedMeshes
+		<< ", partial remeshes: " << meshStats.partialRemeshes - startMeshStats.partialRemeshes
+		<< " (" << meshStats.remeshedSlices - startMeshStats.remeshedSlices << " slices)" << std::endl;
+	std::cout << "Report written to " << reportPath << std::endl;
+}
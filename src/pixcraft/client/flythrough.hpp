@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <unordered_map>
+
+#include "pixcraft/util/glm.hpp"
+
+#include "chunk_renderer.hpp"
+#include "pixcraft/server/world.hpp"
+#include "pixcraft/server/player.hpp"
+
+namespace PixCraft {
+	#define FLYTHROUGH_SEED 1234
+	#define FLYTHROUGH_RENDER_DIST 8
+	#define FLYTHROUGH_STEP (1 / 120.0f) // the path advances in fixed steps, whatever the frame rate
+	#define FLYTHROUGH_EDIT_INTERVAL 0.1f // seconds between block edits while editing
+	#define FLYTHROUGH_HEIGHT 56.0f
+	
+	struct FlythroughFrame {
+		float time; // script time at the start of the frame
+		double frameMs;
+		size_t renderedChunks;
+		size_t pendingMeshes;
+	};
+	
+	// Drives the player of a PlayState along a scripted path, then reports how the client kept up.
+	// The path and the edits only depend on the script time, so with the world's fixed seed,
+	// every run goes through the same terrain. The player flies in noclip mode, sometimes faster
+	// than the chunks can load, and slows down over loaded terrain to break and place blocks.
+	class Flythrough {
+	public:
+		Flythrough(float duration, std::string reportPath);
+		
+		bool finished();
+		
+		// Moves the player to where it should be after dt more seconds of script time, doing the edits due on the way
+		void update(float dt, Player& player, World& world);
+		// Records the frame time, and how long the chunks around the player took to get a mesh
+		void recordFrame(Player& player, ChunkRenderer& chunkRenderer, int renderDist);
+		
+		// Writes the stats of each frame as CSV, and prints a summary
+		void writeReport(ChunkRenderer& chunkRenderer);
+	
+	private:
+		float duration;
+		std::string reportPath;
+		
+		float time; // of the script
+		float pathTime; // of the last path step, at most FLYTHROUGH_STEP behind time
+		glm::vec3 pathPos;
+		float heading; // yaw of the flight direction
+		float nextEdit;
+		size_t edits;
+		
+		double lastFrameTime; // wall clock, negative before the first frame
+		MeshStats startMeshStats;
+		std::vector<FlythroughFrame> frames;
+		// The chunks in range, and since when they are waiting for a mesh, or -1 once they have one
+		std::unordered_map<uint64_t, double> rangeChunks;
+		std::vector<double> loadLatencies; // ms
+		
+		void step(Player& player, World& world);
+		void editBlock(Player& player, World& world);
+	};
+}
@@ -1,10 +1,23 @@
 #include "glfw.hpp"
 
 #include <iostream>
+#include <cstring>
 
 void PixCraft::checkGlErrors(const char* opDesc) {
 	GLenum error;
 	while((error = glGetError()) != GL_NO_ERROR) {
 		std::cerr << "OpenGL error " << std::hex << error << std::dec << " during " << opDesc << "!" << std::endl;
 	}
-}
\ No newline at end of file
+}
+
+PFNGLBUFFERSTORAGEPROC PixCraft::glBufferStorageOpt = nullptr;
+
+void PixCraft::loadOptionalGlFunctions(GLADloadproc load) {
+	bool bufferStorage = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 4);
+	GLint extensionCount;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	for(GLint i = 0; i < extensionCount && !bufferStorage; ++i) {
+		bufferStorage = strcmp((const char*) glGetStringi(GL_EXTENSIONS, i), "GL_ARB_buffer_storage") == 0;
+	}
+	if(bufferStorage) glBufferStorageOpt = (PFNGLBUFFERSTORAGEPROC) load("glBufferStorage");
+}
@@ -8,11 +8,22 @@
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 
+// Buffer storage is from OpenGL 4.4, which GLAD was not generated for
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
 namespace PixCraft {
 	typedef uint32_t GlId;
 	
 	void checkGlErrors(const char* opDesc);
 	
+	// Functions beyond OpenGL 3.3 that are used when available; they are nullptr otherwise
+	extern PFNGLBUFFERSTORAGEPROC glBufferStorageOpt;
+	void loadOptionalGlFunctions(GLADloadproc load);
+	
 	struct RenderParams {
 		float skyColor[3];
 		
@@ -4,6 +4,7 @@
 #include <cstdint>
 
 #include "pixcraft/util/glm.hpp"
+#include "block_textures.hpp"
 
 using namespace PixCraft;
 
@@ -36,12 +37,10 @@ void Hotbar::render() {
 }
 
 void Hotbar::prerender() {
-	Block& block = Block::fromId(_held);
-	
 	buffer.faces.clear();
 	for(uint8_t side = 0; side < 6; ++side) {
 		buffer.faces.push_back(FaceData {
-			0, 0, 0, side, block.getFaceTexture(side)
+			0, 0, 0, side, 1, 1, MAX_LIGHT, 0, BlockTextures::faceTexture(_held, side)
 		});
 	}
 	buffer.prerender();
@@ -7,8 +7,8 @@
 using namespace PixCraft;
 
 InputManager::InputManager()
-	: window(nullptr), _capturingMouse(false), oldMousePos(0, 0), _justPressed(), _justClicked {false, false},
-	  _justScrolled(0) { }
+	: window(nullptr), _capturingMouse(false), oldMousePos(0, 0), mousePos(0, 0), movementKeys(0, 0, false, false),
+	  _justPressed(), _justClicked {false, false}, _justScrolled(0), currentTick() { }
 
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
 	GameClient& client = *((GameClient*) glfwGetWindowUserPointer(window));
@@ -58,9 +58,67 @@ void InputManager::capturingMouse(bool capturingMouse) {
 		glfwGetWindowSize(window, &width, &height);
 		glfwSetCursorPos(window, width/2, height/2);
 		oldMousePos = glm::ivec2(0, 0);
+		mousePos = glm::ivec2(0, 0);
 	}
 }
 
+float InputManager::tick(float dt) {
+	InputTick& tick = currentTick;
+	if(replay) {
+		replay->next(tick);
+		movementKeys = tick.movementKeys;
+		mousePos = tick.mousePos;
+		_justClicked[0] = tick.clicked[0];
+		_justClicked[1] = tick.clicked[1];
+		_justScrolled = tick.scrolled;
+		_justPressed.clear();
+		_justPressed.insert(tick.pressedKeys.begin(), tick.pressedKeys.end());
+		_inputBuffer = tick.text;
+		return tick.dt;
+	}
+	
+	movementKeys = pollMovementKeys();
+	mousePos = pollMousePosition();
+	if(recorder) {
+		tick.dt = dt;
+		tick.movementKeys = movementKeys;
+		tick.mousePos = mousePos;
+		tick.clicked[0] = _justClicked[0];
+		tick.clicked[1] = _justClicked[1];
+		tick.scrolled = _justScrolled;
+		tick.pressedKeys.assign(_justPressed.begin(), _justPressed.end());
+		tick.text = _inputBuffer;
+		recorder->record(tick);
+		tick.index++;
+	}
+	return dt;
+}
+
+void InputManager::recordTo(std::string path) {
+	recordPath = path;
+}
+
+void InputManager::startRecording(uint64_t seed) {
+	if(recordPath.empty() || replay) return;
+	recorder.reset(new InputRecorder(recordPath, seed));
+	currentTick.index = 0;
+}
+
+void InputManager::stopRecording() {
+	recorder.reset();
+}
+
+bool InputManager::recording() { return recorder != nullptr; }
+
+void InputManager::replayFrom(std::string path) {
+	replay.reset(new InputReplay(path));
+}
+
+bool InputManager::replaying() { return replay != nullptr; }
+bool InputManager::replayFinished() { return replay && replay->finished(); }
+uint64_t InputManager::replaySeed() { return replay ? replay->seed() : 0; }
+size_t InputManager::replayedTicks() { return replay ? replay->tickCount() : 0; }
+
 void InputManager::mouseClicked(int button) {
 	_justClicked[button - 1] = true;
 }
@@ -70,13 +128,16 @@ bool InputManager::justClicked(int button) {
 }
 
 glm::vec2 InputManager::getMouseMovement() {
-	glm::ivec2 newMousePos = getMousePosition();
-	glm::vec2 mvt = newMousePos - oldMousePos;
-	oldMousePos = newMousePos;
+	glm::vec2 mvt = mousePos - oldMousePos;
+	oldMousePos = mousePos;
 	return mouseSensitivity * mvt;
 }
 
 glm::ivec2 InputManager::getMousePosition() {
+	return mousePos;
+}
+
+glm::ivec2 InputManager::pollMousePosition() {
 	double mouseX, mouseY;
 	glfwGetCursorPos(window, &mouseX, &mouseY);
 	int width, height;
@@ -94,6 +155,10 @@ bool InputManager::justPressed(int key) {
 }
 
 std::tuple<int,int,bool,bool> InputManager::getMovementKeys() {
+	return movementKeys;
+}
+
+std::tuple<int,int,bool,bool> InputManager::pollMovementKeys() {
 	int dx = (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) - (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS);
 	int dz = (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) - (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS);
 	bool up = glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS;
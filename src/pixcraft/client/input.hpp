@@ -4,9 +4,11 @@
 #include <tuple>
 #include <string>
 #include <iterator>
+#include <memory>
 
 #include "glfw.hpp"
 #include "pixcraft/util/glm.hpp"
+#include "input_recording.hpp"
 
 namespace PixCraft {
 	class InputManager {
@@ -16,6 +18,22 @@ namespace PixCraft {
 		
 		void capturingMouse(bool capture);
 		
+		// Takes the input for the next update: the polled state is sampled once, so that it can be recorded.
+		// When replaying, the input and dt come from the recording instead; returns the dt to update with.
+		float tick(float dt);
+		
+		// Each play session started after recordTo() records its seed and input to the file, replacing the last one
+		void recordTo(std::string path);
+		void startRecording(uint64_t seed);
+		void stopRecording();
+		bool recording();
+		// Replaces the window's input with a recording's, until it runs out
+		void replayFrom(std::string path);
+		bool replaying();
+		bool replayFinished();
+		uint64_t replaySeed();
+		size_t replayedTicks();
+		
 		void mouseClicked(int button);
 		bool justClicked(int button);
 		glm::vec2 getMouseMovement();
@@ -40,6 +58,8 @@ namespace PixCraft {
 		
 		bool _capturingMouse;
 		glm::ivec2 oldMousePos;
+		glm::ivec2 mousePos; // sampled in tick()
+		std::tuple<int,int,bool,bool> movementKeys;
 		
 		std::unordered_set<int> _justPressed;
 		bool _justClicked[2];
@@ -47,5 +67,13 @@ namespace PixCraft {
 		int _justScrolled;
 		
 		std::string _inputBuffer;
+		
+		std::string recordPath;
+		std::unique_ptr<InputRecorder> recorder;
+		std::unique_ptr<InputReplay> replay;
+		InputTick currentTick;
+		
+		glm::ivec2 pollMousePosition();
+		std::tuple<int,int,bool,bool> pollMovementKeys();
 	};
 }
@@ -0,0 +1,137 @@
+#include "input_recording.hpp"
+
+#include <cstring>
+#include <iterator>
+#include <stdexcept>
+
+using namespace PixCraft;
+
+namespace {
+	const char MAGIC[4] = { 'P', 'X', 'I', 'N' };
+	
+	// Which parts of a tick are stored after its index and dt
+	enum : uint8_t {
+		TICK_MOVEMENT = 0x01,
+		TICK_MOUSE = 0x02,
+		TICK_CLICK1 = 0x04,
+		TICK_CLICK2 = 0x08,
+		TICK_SCROLL = 0x10,
+		TICK_KEYS = 0x20,
+		TICK_TEXT = 0x40,
+	};
+	
+	InputTick emptyTick() {
+		return { 0, 0.0f, std::tuple<int,int,bool,bool>(0, 0, false, false), glm::ivec2(0, 0), { false, false }, 0, {}, "" };
+	}
+}
+
+InputRecorder::InputRecorder(std::string path, uint64_t seed) : file(path, std::ios::binary), last(emptyTick()) {
+	if(!file) throw std::runtime_error("Failed to open input recording " + path);
+	file.write(MAGIC, sizeof(MAGIC));
+	write<uint32_t>(INPUT_RECORDING_VERSION);
+	write<uint64_t>(seed);
+}
+
+template<typename T>
+void InputRecorder::write(T value) {
+	file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void InputRecorder::record(const InputTick& tick) {
+	uint8_t parts = 0;
+	if(tick.movementKeys != last.movementKeys) parts |= TICK_MOVEMENT;
+	if(tick.mousePos != last.mousePos) parts |= TICK_MOUSE;
+	if(tick.clicked[0]) parts |= TICK_CLICK1;
+	if(tick.clicked[1]) parts |= TICK_CLICK2;
+	if(tick.scrolled != 0) parts |= TICK_SCROLL;
+	if(!tick.pressedKeys.empty()) parts |= TICK_KEYS;
+	if(!tick.text.empty()) parts |= TICK_TEXT;
+	
+	write<uint32_t>(tick.index);
+	write<float>(tick.dt);
+	write<uint8_t>(parts);
+	if(parts & TICK_MOVEMENT) {
+		write<int8_t>(std::get<0>(tick.movementKeys));
+		write<int8_t>(std::get<1>(tick.movementKeys));
+		write<uint8_t>(std::get<2>(tick.movementKeys) | std::get<3>(tick.movementKeys) << 1);
+	}
+	if(parts & TICK_MOUSE) {
+		write<int32_t>(tick.mousePos.x);
+		write<int32_t>(tick.mousePos.y);
+	}
+	if(parts & TICK_SCROLL) write<int32_t>(tick.scrolled);
+	if(parts & TICK_KEYS) {
+		write<uint16_t>(tick.pressedKeys.size());
+		for(int key : tick.pressedKeys) write<int32_t>(key);
+	}
+	if(parts & TICK_TEXT) {
+		write<uint16_t>(tick.text.size());
+		file.write(tick.text.data(), tick.text.size());
+	}
+	
+	last.movementKeys = tick.movementKeys;
+	last.mousePos = tick.mousePos;
+}
+
+InputReplay::InputReplay(std::string path) : offset(0), _seed(0), last(emptyTick()), replayed(0) {
+	std::ifstream file(path, std::ios::binary);
+	if(!file) throw std::runtime_error("Failed to open input recording " + path);
+	data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	
+	if(data.size() < sizeof(MAGIC) || memcmp(data.data(), MAGIC, sizeof(MAGIC)) != 0)
+		throw std::runtime_error(path + " is not an input recording");
+	offset = sizeof(MAGIC);
+	if(read<uint32_t>() != INPUT_RECORDING_VERSION)
+		throw std::runtime_error(path + " was recorded by another version of the game");
+	_seed = read<uint64_t>();
+}
+
+template<typename T>
+T InputReplay::read() {
+	if(offset + sizeof(T) > data.size()) throw std::runtime_error("Input recording is truncated");
+	T value;
+	memcpy(&value, data.data() + offset, sizeof(T));
+	offset += sizeof(T);
+	return value;
+}
+
+uint64_t InputReplay::seed() { return _seed; }
+bool InputReplay::finished() { return offset >= data.size(); }
+size_t InputReplay::tickCount() { return replayed; }
+
+void InputReplay::next(InputTick& tick) {
+	tick = last;
+	tick.index = read<uint32_t>();
+	if(tick.index != replayed) throw std::runtime_error("Input recording is corrupted");
+	tick.dt = read<float>();
+	uint8_t parts = read<uint8_t>();
+	if(parts & TICK_MOVEMENT) {
+		int dx = read<int8_t>();
+		int dz = read<int8_t>();
+		uint8_t upDown = read<uint8_t>();
+		tick.movementKeys = std::tuple<int,int,bool,bool>(dx, dz, upDown & 1, upDown & 2);
+	}
+	if(parts & TICK_MOUSE) {
+		tick.mousePos.x = read<int32_t>();
+		tick.mousePos.y = read<int32_t>();
+	}
+	tick.clicked[0] = parts & TICK_CLICK1;
+	tick.clicked[1] = parts & TICK_CLICK2;
+	tick.scrolled = parts & TICK_SCROLL ? read<int32_t>() : 0;
+	tick.pressedKeys.clear();
+	if(parts & TICK_KEYS) {
+		uint16_t count = read<uint16_t>();
+		for(uint16_t i = 0; i < count; ++i) tick.pressedKeys.push_back(read<int32_t>());
+	}
+	tick.text.clear();
+	if(parts & TICK_TEXT) {
+		uint16_t length = read<uint16_t>();
+		if(offset + length > data.size()) throw std::runtime_error("Input recording is truncated");
+		tick.text.assign(data.data() + offset, length);
+		offset += length;
+	}
+	
+	last.movementKeys = tick.movementKeys;
+	last.mousePos = tick.mousePos;
+	replayed++;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <tuple>
+#include <vector>
+#include <string>
+#include <fstream>
+
+#include "pixcraft/util/glm.hpp"
+
+namespace PixCraft {
+	#define INPUT_RECORDING_VERSION 1
+	
+	// The input seen by one update of the game
+	struct InputTick {
+		uint32_t index; // of the update since the recording started
+		float dt;
+		std::tuple<int,int,bool,bool> movementKeys;
+		glm::ivec2 mousePos;
+		bool clicked[2];
+		int scrolled;
+		std::vector<int> pressedKeys;
+		std::string text;
+	};
+	
+	// Writes the seed of a world, then the input of every update, each only with the parts that changed.
+	// Writes go through the file's buffer, so recording costs a few bytes of copying per update.
+	class InputRecorder {
+	public:
+		InputRecorder(std::string path, uint64_t seed);
+		
+		void record(const InputTick& tick);
+	
+	private:
+		std::ofstream file;
+		InputTick last;
+		
+		template<typename T>
+		void write(T value);
+	};
+	
+	// Reads a recording back, update by update
+	class InputReplay {
+	public:
+		InputReplay(std::string path);
+		
+		uint64_t seed();
+		bool finished();
+		size_t tickCount(); // ticks replayed so far
+		// Fills tick with the next update's input; throws if the recording is corrupted
+		void next(InputTick& tick);
+	
+	private:
+		std::vector<char> data;
+		size_t offset;
+		uint64_t _seed;
+		InputTick last;
+		size_t replayed;
+		
+		template<typename T>
+		T read();
+	};
+}
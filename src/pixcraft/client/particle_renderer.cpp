@@ -20,7 +20,8 @@ void ParticleRenderer::init() {
 	program.init(ShaderSources::particleVS, ShaderSources::particleFS);
 	buffer.init(offsetof(Particle, x), offsetof(Particle, size),
 		offsetof(Particle, blockTex), offsetof(Particle, tx), sizeof(Particle));
-	buffer.loadData(nullptr, MAX_PARTICLES, GL_STREAM_DRAW);
+	buffer.memoryTag(MemoryTag::particles);
+	buffer.reserve(MAX_PARTICLES);
 	checkGlErrors("particle renderer initialization");
 	
 	std::random_device randDev;
@@ -81,16 +82,14 @@ void ParticleRenderer::update(float dt) {
 }
 
 void ParticleRenderer::render(glm::mat4 proj, glm::mat4 view, float fovy, int height) {
-	std::vector<Particle> particlesVector;
-	for(auto it = particles.iter(); !it.done(); ++it) {
-		particlesVector.push_back(*it);
-	}
-	auto particleCount = particlesVector.size();
-	if(particleCount > MAX_PARTICLES) {
-		particleCount = MAX_PARTICLES;
-		std::cout << "Too many particles!" << std::endl;
+	if(particles.size() > MAX_PARTICLES) std::cout << "Too many particles!" << std::endl;
+	size_t first;
+	Particle* vertices = (Particle*) buffer.map(MAX_PARTICLES, first);
+	size_t particleCount = 0;
+	for(auto it = particles.iter(); !it.done() && particleCount < MAX_PARTICLES; ++it) {
+		vertices[particleCount++] = *it;
 	}
-	buffer.updateData(particlesVector.data(), particleCount);
+	buffer.unmap(particleCount);
 	
 	glEnable(GL_PROGRAM_POINT_SIZE);
 	
@@ -103,9 +102,14 @@ void ParticleRenderer::render(glm::mat4 proj, glm::mat4 view, float fovy, int he
 	program.setUniform("texArray", (uint32_t) 0);
 	TextureManager::bindBlockTextureArray();
 	buffer.bind();
-	glDrawArrays(GL_POINTS, 0, particleCount);
+	glDrawArrays(GL_POINTS, first, particleCount);
 	buffer.unbind();
 	program.unuse();
 	
 	glDisable(GL_PROGRAM_POINT_SIZE);
 }
+
+void ParticleRenderer::reportMemory(MemoryReport& report) {
+	// Each heap node lives in a list node of its parent
+	report.addCpu(MemoryTag::particles, particles.size() * (sizeof(PairingHeapNode<Particle>) + sizeof(void*)));
+}
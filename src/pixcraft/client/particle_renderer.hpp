@@ -31,11 +31,13 @@ namespace PixCraft {
 		
 		void render(glm::mat4 proj, glm::mat4 view, float fovy, int height);
 		
+		void reportMemory(MemoryReport& report);
+	
 	private:
 		const unsigned int MAX_PARTICLES = 512;
 		
 		ShaderProgram program;
-		VertexBuffer<glm::vec3, float, TexId, glm::vec2> buffer;
+		StreamBuffer<glm::vec3, float, TexId, glm::vec2> buffer;
 		
 		std::mt19937 random;
 		
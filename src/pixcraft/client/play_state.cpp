@@ -4,12 +4,23 @@
 #include <cmath>
 #include <array>
 #include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
 
 #include "pixcraft/util/util.hpp"
+#include "pixcraft/util/random.hpp"
+#include "pixcraft/util/trace.hpp"
+#include "pixcraft/util/frame_arena.hpp"
+#include "pixcraft/util/alloc_tracking.hpp"
+#include "pixcraft/util/memory_stats.hpp"
 #include "shaders.hpp"
 #include "textures.hpp"
+#include "block_textures.hpp"
 #include "view_frustum.hpp"
 #include "menu_state.hpp"
+#include "profiler.hpp"
 
 #include "pixcraft/server/blocks.hpp"
 #include "pixcraft/server/player.hpp"
@@ -17,6 +28,9 @@
 
 using namespace PixCraft;
 
+// Call sites listed in the report of the "allocs" command
+const size_t allocReportSites = 20;
+
 const std::array<float, 24> cursorVertices = {
 	-1,  -1,   1,  -1,    1,  1,   -1,  1,
 	-1, -10,   1, -10,   10, -1,   10,  1,
@@ -52,12 +66,26 @@ const std::array<unsigned int, 24> blockOverlayIndices = {
 	3, 5,  3, 6
 };
 
-PlayState::PlayState(GameClient& client)
-	: GameState(client), showDebug(false), paused(false), chunkRenderer(world, faceRenderer),
-	  hotbar(faceRenderer) {
+namespace {
+	// Benchmarks and replays need the same world every time
+	uint64_t worldSeed(GameClient& client, bool flythrough) {
+		if(flythrough) return FLYTHROUGH_SEED;
+		InputManager& input = client.getInputManager();
+		return input.replaying() ? input.replaySeed() : generateSeed();
+	}
+}
+
+PlayState::PlayState(GameClient& client) : PlayState(client, nullptr) { }
+
+PlayState::PlayState(GameClient& client, std::unique_ptr<Flythrough> script)
+	: GameState(client), showDebug(false), paused(false), debugMemoryTime(0.0), world(worldSeed(client, script != nullptr)), target(),
+	  chunkRenderer(world, faceRenderer), chunkScheduler(world, chunkRenderer), viewFrustum(), hotbar(faceRenderer),
+	  flythrough(std::move(script)) {
 	setAntialiasing(false);
-	setRenderDistance(8);
+	setRenderDistance(flythrough ? FLYTHROUGH_RENDER_DIST : 8);
 	client.getInputManager().capturingMouse(!paused);
+	client.getInputManager().startRecording(world.seed());
+	chunkScheduler.deterministic(client.getInputManager().recording() || client.getInputManager().replaying());
 	
 	cursorProgram.init(ShaderSources::cursorVS, ShaderSources::colorFS);
 	cursorBuffer.init(0, 2*sizeof(float));
@@ -77,9 +105,11 @@ PlayState::PlayState(GameClient& client)
 	checkGlErrors("block overlay initialization");
 	
 	faceRenderer.init();
+	chunkRenderer.init();
 	entityRenderer.init();
 	particleRenderer.init();
 	hotbar.init();
+	frameGraph.init();
 	
 	console.addCommand("clear", [&]() {
 		console.clearHistory();
@@ -120,18 +150,69 @@ PlayState::PlayState(GameClient& client)
 		ss << "Set render distance to " << renderDist << ".";
 		console.write(ss.str());
 	});
+	console.addCommand("pulling", [&]() {
+		faceRenderer.vertexPulling(!faceRenderer.vertexPulling());
+		if(faceRenderer.vertexPulling()) {
+			console.write("Chunks are now rendered with vertex pulling.");
+		} else {
+			console.write("Chunks are now rendered with the geometry shader.");
+		}
+	});
+	console.addCommand("culling", [&]() {
+		chunkRenderer.caveCulling(!chunkRenderer.caveCulling());
+		if(chunkRenderer.caveCulling()) {
+			console.write("Hidden chunk sections are now culled.");
+		} else {
+			console.write("Hidden chunk sections are now rendered.");
+		}
+	});
 	console.addCommand("rerender", [&]() {
 		chunkRenderer.reset();
+		chunkScheduler.reset();
 	});
 	console.addCommand("save", [&]() {
-		world.saveToFile("data/world.bin");
-		console.write("Saved world to file.");
+		world.saveToFileInBackground("data/world.bin");
+		console.write("Saving world to file.");
 	});
 	console.addCommand("load", [&]() {
 		player = world.loadFromFile("data/world.bin");
 		chunkRenderer.reset();
+		chunkScheduler.reset();
 		console.write("Loaded world from file.");
 	});
+	console.addCommand("memory", [&]() {
+		for(std::string& line : memoryLines()) {
+			console.write(line);
+		}
+	});
+	console.addCommand("trace", [&]() {
+		if(!Trace::ENABLED) {
+			console.write("Tracing is disabled in this build, use \"make tracing\".");
+			return;
+		}
+		try {
+			size_t count = Trace::writeChromeTrace("data/trace.json");
+			std::stringstream ss;
+			ss << "Wrote " << count << " trace events to data/trace.json.";
+			console.write(ss.str());
+		} catch(std::runtime_error& e) {
+			console.write(e.what());
+		}
+	});
+	console.addCommand("allocs", [&]() {
+		if(!AllocTracking::ENABLED) {
+			console.write("Allocation tracking is disabled in this build, use \"make alloc_tracking\".");
+			return;
+		}
+		try {
+			for(std::string& line : AllocTracking::writeReport("data/allocations.txt", allocReportSites)) {
+				console.write(line);
+			}
+			console.write("Wrote the top call sites to data/allocations.txt.");
+		} catch(std::runtime_error& e) {
+			console.write(e.what());
+		}
+	});
 	
 	menuButtons.emplace_back(0, 0, 200, 30, "Back to menu");
 	menuButtons.back().setCallback([&client]() {
@@ -147,6 +228,10 @@ PlayState::PlayState(GameClient& client)
 	world.mobs.emplace_back(new Slime(world, glm::vec3(0.0f, 50.0f, 0.0f)));
 }
 
+PlayState::~PlayState() {
+	client.getInputManager().stopRecording();
+}
+
 void PlayState::setAntialiasing(bool enabled) {
 	if(enabled) {
 		glEnable(GL_MULTISAMPLE);
@@ -162,7 +247,35 @@ void PlayState::setRenderDistance(int renderDist2) {
 	fogStart = fogEnd * 0.9;
 }
 
+MemoryReport PlayState::collectMemoryReport() {
+	MemoryReport report = MemoryStats::gpuReport();
+	world.reportMemory(report);
+	chunkRenderer.reportMemory(report);
+	particleRenderer.reportMemory(report);
+	client.getTextRenderer().reportMemory(report);
+	report.addCpu(MemoryTag::frameArena, frameArena().capacity());
+	return report;
+}
+
+std::vector<std::string> PlayState::memoryLines() {
+	MemoryReport report = collectMemoryReport();
+	std::vector<std::string> lines = report.lines();
+	size_t chunkCount = world.loadedChunkCount();
+	if(chunkCount > 0) {
+		size_t chunkBytes = 0;
+		for(MemoryTag tag : { MemoryTag::chunks, MemoryTag::blockUpdates, MemoryTag::chunkMeshes }) {
+			chunkBytes += report.cpu[(size_t) tag] + report.gpu[(size_t) tag];
+		}
+		std::stringstream ss;
+		ss << "Per loaded chunk: " << chunkBytes / chunkCount / 1024 << " KB (" << chunkCount << " chunks)";
+		lines.push_back(ss.str());
+	}
+	return lines;
+}
+
 void PlayState::update(float dt) {
+	TRACE_SCOPE("Update");
+	ProfileScope updateScope(ProfileZone::update);
 	InputManager& input = client.getInputManager();
 	
 	if(!console.isOpen() && input.justPressed(GLFW_KEY_ESCAPE)) {
@@ -187,7 +300,7 @@ void PlayState::update(float dt) {
 	} else {
 		console.update(input);
 		
-		if(!console.isOpen()) {
+		if(!console.isOpen() && !flythrough) {
 			player->handleKeys(input.getMovementKeys(), dt);
 			
 			glm::vec2 mouseMvt = input.getMouseMovement();
@@ -206,16 +319,22 @@ void PlayState::update(float dt) {
 			
 			bool click1 = input.justClicked(1);
 			bool click2 = input.justClicked(2);
-			if(click1 || click2) {
-				bool hit;
-				int x, y, z;
-				std::tie(hit, x, y, z) = player->castRay(PLAYER_REACH, !click1, false);
-				if(hit && World::isValidHeight(y)) {
+			// Clicking both buttons at once does nothing. The target is cast again, after this frame's rotation;
+			// the one cast at the end of the update is only used for the overlay.
+			if(click1 != click2) target = player->castRay(PLAYER_REACH, false);
+			if(click1 != click2 && target.hit) {
+				int x = target.x, y = target.y, z = target.z;
+				if(click2) {
+					x += sideVectors[target.face][0];
+					y += sideVectors[target.face][1];
+					z += sideVectors[target.face][2];
+				}
+				if(World::isValidHeight(y)) {
 					if(click2) {
 						if(!world.hasSolidBlock(x, y, z) && !world.containsMobs(x, y, z))
 							world.setBlock(x, y, z, Block::fromId(hotbar.held()));
 					} else {
-						auto blockTex = world.getBlock(x, y, z)->mainTexture();
+						auto blockTex = BlockTextures::mainTexture(target.block->id());
 						world.removeBlock(x, y, z);
 						particleRenderer.spawnBlockBits(glm::vec3((float) x, (float) y, (float) z), blockTex);
 					}
@@ -228,42 +347,36 @@ void PlayState::update(float dt) {
 		input.getMouseMovement();
 		player->handleKeys(std::tuple<int,int,bool,bool>(0,0,false,false), dt);
 	}
+	if(flythrough) flythrough->update(dt, *player, world);
 	
-	int32_t camX, camY, camZ;
-	std::tie(camX, camY, camZ) = getBlockCoordsAt(player->pos());
-	int32_t camChunkX, camChunkZ;
-	std::tie(camChunkX, camChunkZ) = World::getChunkPosAt(camX, camZ);
-	int loads = 0;
-	SpiralIterator iter(camChunkX, camChunkZ);
-	while(iter.withinSquareDistance(renderDist + 1)) {
-		if(iter.withinDistance(renderDist + 2)) {
-			int x = iter.getX();
-			int z = iter.getZ();
-			if(!world.isChunkLoaded(x, z)) {
-				world.genChunk(x, z);
-				loads++;
-			} else if(!chunkRenderer.isChunkRendered(x, z)) {
-				world.markChunkDirty(x, z);
-				loads++;
-			}
-			if(loads >= LOADS_PER_FRAME) break;
-		}
-		iter.next();
-	}
+	Profiler::beginZone(ProfileZone::chunkLoading);
+	chunkScheduler.update(player->pos(), player->speed(), viewFrustum, renderDist);
+	Profiler::endZone(ProfileZone::chunkLoading);
 	
+	Profiler::beginZone(ProfileZone::blockUpdates);
 	world.updateBlocks();
+	Profiler::endZone(ProfileZone::blockUpdates);
 	chunkRenderer.updateBlocks();
+	if(flythrough) {
+		flythrough->recordFrame(*player, chunkRenderer, renderDist);
+		if(flythrough->finished()) {
+			flythrough->writeReport(chunkRenderer);
+			client.stop();
+		}
+	}
 	
+	Profiler::beginZone(ProfileZone::entities);
 	world.updateEntities(dt);
+	Profiler::endZone(ProfileZone::entities);
+	target = player->castRay(PLAYER_REACH, false);
 	
 	particleRenderer.update(dt);
 }
 
-void printElapsedTime(const char* operation, double before) {
-	std::cout << operation << ": " << round((glfwGetTime() - before)*10000) / 10.0 << " ms" << std::endl;
-}
-
 void PlayState::render(int winWidth, int winHeight) {
+	TRACE_SCOPE("Render");
+	ProfileScope renderScope(ProfileZone::render);
+	
 	// Compute some rendering data based on player position
 	float fovy = glm::radians(90.0f);
 	float aspect = ((float) winWidth) / winHeight;
@@ -274,11 +387,7 @@ void PlayState::render(int winWidth, int winHeight) {
 	glm::mat4 view = globalToLocal(playerPos, player->orient());
 	
 	ViewFrustum vf = computeViewFrustum(fovy, aspect, near, far, playerPos, player->orient());
-	
-	int32_t camX, camY, camZ;
-	std::tie(camX, camY, camZ) = getBlockCoordsAt(player->pos());
-	int32_t camChunkX, camChunkZ;
-	std::tie(camChunkX, camChunkZ) = World::getChunkPosAt(camX, camZ);
+	viewFrustum = vf;
 	
 	// Clear screen
 	glClearColor(SKY_COLOR[0], SKY_COLOR[1], SKY_COLOR[2], 1.0f);
@@ -295,22 +404,22 @@ void PlayState::render(int winWidth, int winHeight) {
 		true, true,
 		fogStart, fogEnd,
 	};
+	Profiler::beginGpuZone(ProfileZone::opaquePass);
 	faceRenderer.startRendering(proj, view, params);
-	chunkRenderer.render(camChunkX, camChunkZ, renderDist, vf);
+	chunkRenderer.render(playerPos, renderDist, vf);
 	faceRenderer.stopRendering();
+	Profiler::endGpuZone(ProfileZone::opaquePass);
 	checkGlErrors("block rendering");
 	
+	Profiler::beginGpuZone(ProfileZone::entityPass);
 	entityRenderer.renderEntities(world, proj, view, params);
 	checkGlErrors("entity rendering");
 	
-	bool hit;
-	int x, y, z;
-	std::tie(hit, x, y, z) = player->castRay(PLAYER_REACH, false, false);
-	if(hit) {
+	if(target.hit) {
 		blockOverlayProgram.use();
 		blockOverlayProgram.setUniform("view", view);
 		blockOverlayProgram.setUniform("proj", proj);
-		glm::mat4 model = glm::translate(glm::mat4(1.0), glm::vec3((float) x, (float) y, (float) z));
+		glm::mat4 model = glm::translate(glm::mat4(1.0), glm::vec3((float) target.x, (float) target.y, (float) target.z));
 		blockOverlayProgram.setUniform("model", model);
 		blockOverlayProgram.setUniform("color", 0.0f, 0.0f, 0.0f, 1.0f);
 		blockOverlayBuffer.bind();
@@ -319,12 +428,16 @@ void PlayState::render(int winWidth, int winHeight) {
 		blockOverlayProgram.unuse();
 		checkGlErrors("block overlay rendering");
 	}
+	Profiler::endGpuZone(ProfileZone::entityPass);
 	
+	Profiler::beginGpuZone(ProfileZone::particlePass);
 	particleRenderer.render(proj, view, fovy, winHeight);
+	Profiler::endGpuZone(ProfileZone::particlePass);
 	checkGlErrors("particle rendering");
 	
+	Profiler::beginGpuZone(ProfileZone::translucentPass);
 	faceRenderer.startRendering(proj, view, params);
-	chunkRenderer.renderTranslucent(camChunkX, camChunkZ, renderDist, vf);
+	chunkRenderer.renderTranslucent();
 	checkGlErrors("translucent block rendering");
 	
 	glClear(GL_DEPTH_BUFFER_BIT);
@@ -333,10 +446,12 @@ void PlayState::render(int winWidth, int winHeight) {
 	faceRenderer.setParams(params);
 	hotbar.render();
 	faceRenderer.stopRendering();
+	Profiler::endGpuZone(ProfileZone::translucentPass);
 	checkGlErrors("held block rendering");
 	
 	// After this point, no depth testing needed
 	glDisable(GL_DEPTH_TEST);
+	Profiler::beginGpuZone(ProfileZone::guiPass);
 	
 	// Draw underwater overlay
 	if(player->isEyeUnderwater()) {
@@ -386,11 +501,52 @@ void PlayState::render(int winWidth, int winHeight) {
 		debugStream << "Mode: " << movementModeNames[static_cast<int>(player->movementMode())] << std::endl;
 		debugStream << "Vertical speed: " << player->speed().y << std::endl;
 		debugStream << "Rendered chunks: " << chunkRenderer.renderedChunkCount() << std::endl;
+		debugStream << "Pending meshes: " << chunkRenderer.pendingMeshCount() << std::endl;
+		debugStream << "Chunk tasks: " << chunkScheduler.pendingTaskCount() << std::endl;
+		debugStream << "Rendered sections: " << chunkRenderer.renderedSectionCount() << std::endl;
+		FaceArena& arena = chunkRenderer.getArena();
+		debugStream << "Chunk rendering: " << (faceRenderer.vertexPulling() ? "vertex pulling" : "geometry shader") << std::endl;
+		debugStream << "Face arena: " << arena.usedSize() << "/" << arena.capacity() << " faces";
+		if(arena.pullableSize() < arena.capacity()) debugStream << " (" << arena.pullableSize() << " can be pulled)";
+		debugStream << std::endl;
 		debugStream << "Antialiasing: " << (antialiasing ? "enabled" : "disabled") << std::endl;
 		//debugStream << "Unicode test: AéǄ‰₪ℝψЯאصखଇணఔฌ갃ば亶〠㊆😎😂" << std::endl;
+		debugStream << std::endl << "Memory:" << std::endl;
+		double now = glfwGetTime();
+		if(debugMemoryLines.empty() || now - debugMemoryTime >= MEMORY_REFRESH_SECONDS) {
+			debugMemoryLines = memoryLines();
+			debugMemoryTime = now;
+		}
+		for(std::string& line : debugMemoryLines) {
+			debugStream << line << std::endl;
+		}
+		if(AllocTracking::ENABLED) {
+			AllocStats last = AllocTracking::lastFrame();
+			debugStream << std::endl << "Allocations: " << last.count << " last frame (" << MemoryStats::formatBytes(last.bytes) << "), "
+				<< AllocTracking::maxFrame().count << " at most in the last " << ALLOC_HISTORY << " frames" << std::endl;
+			for(std::string& line : AllocTracking::lastFrameScopes()) {
+				debugStream << line << std::endl;
+			}
+		}
+		debugStream << std::endl << "Zone (median / 95% / 99% ms):" << std::endl;
+		debugStream << std::fixed << std::setprecision(2);
+		for(size_t i = 0; i < (size_t) ProfileZone::count; ++i) {
+			ProfileZone zone = (ProfileZone) i;
+			ZoneStats cpu = Profiler::cpuStats(zone);
+			debugStream << Profiler::zoneName(zone) << ": " << cpu.median << " / " << cpu.p95 << " / " << cpu.p99;
+			if(Profiler::isGpuZone(zone)) {
+				ZoneStats gpu = Profiler::gpuStats(zone);
+				debugStream << ", GPU " << gpu.median << " / " << gpu.p95 << " / " << gpu.p99;
+			}
+			debugStream << std::endl;
+		}
 		textRenderer.renderText(debugStream.str(), -winWidth/2 + 5, winHeight/2 - 20, glm::vec4(1.0, 1.0, 1.0, 1.0));
 		checkGlErrors("debug text rendering");
+		
+		frameGraph.render(winWidth, winHeight);
+		checkGlErrors("frame graph rendering");
 	}
 	
 	console.render(textRenderer, winWidth, winHeight);
+	Profiler::endGpuZone(ProfileZone::guiPass);
 }
\ No newline at end of file
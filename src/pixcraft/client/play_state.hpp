@@ -1,17 +1,22 @@
 #pragma once
 
 #include <vector>
+#include <memory>
 
 #include "client.hpp"
 #include "pixcraft/util/glm.hpp"
 
 #include "face_renderer.hpp"
 #include "chunk_renderer.hpp"
+#include "chunk_scheduler.hpp"
+#include "view_frustum.hpp"
 #include "entity_renderer.hpp"
 #include "particle_renderer.hpp"
 #include "hotbar.hpp"
 #include "gui.hpp"
 #include "console.hpp"
+#include "profiler.hpp"
+#include "flythrough.hpp"
 
 #include "pixcraft/server/world_module.hpp"
 #include "pixcraft/server/world.hpp"
@@ -22,14 +27,17 @@ namespace PixCraft {
 	class PlayState : public GameState {
 	public:
 		PlayState(GameClient& client);
+		// Plays the flythrough in a world with a fixed seed instead of taking input, and exits once it is over
+		PlayState(GameClient& client, std::unique_ptr<Flythrough> flythrough);
+		~PlayState() override;
 		
 		void update(float dt) override;
 		void render(int winWidth, int winHeight) override;
 		
 	private:
 		static constexpr float SKY_COLOR[3] = {0.75f, 0.9f, 1.0f};
-		static const int LOADS_PER_FRAME = 1;
 		static constexpr float PLAYER_REACH = 5.0f;
+		static constexpr double MEMORY_REFRESH_SECONDS = 1.0; // of the debug printout; collecting the report walks every chunk
 		
 		bool antialiasing;
 		bool showDebug;
@@ -39,14 +47,21 @@ namespace PixCraft {
 		
 		Console console;
 		
+		std::vector<std::string> debugMemoryLines; // cached memoryLines
+		double debugMemoryTime; // when they were collected
+		
 		World world;
 		Player* player;
+		RaycastHit target; // block the player is looking at, cast once per update
 		
 		FaceRenderer faceRenderer;
 		ChunkRenderer chunkRenderer;
+		ChunkScheduler chunkScheduler;
+		ViewFrustum viewFrustum; // of the last rendered frame, used to prioritize chunk loading
 		EntityRenderer entityRenderer;
 		ParticleRenderer particleRenderer;
 		Hotbar hotbar;
+		FrameGraph frameGraph;
 		
 		ShaderProgram cursorProgram;
 		IndexBuffer<glm::vec2> cursorBuffer;
@@ -57,7 +72,12 @@ namespace PixCraft {
 		
 		std::vector<Button> menuButtons;
 		
+		std::unique_ptr<Flythrough> flythrough; // null when playing
+		
 		void setAntialiasing(bool enabled);
 		void setRenderDistance(int renderDist);
+		MemoryReport collectMemoryReport();
+		// The report's lines, and the memory used per loaded chunk, to budget the render distance
+		std::vector<std::string> memoryLines();
 	};
 }
@@ -0,0 +1,189 @@
+#include "profiler.hpp"
+
+#include <array>
+#include <chrono>
+#include <algorithm>
+
+#include "pixcraft/util/alloc_tracking.hpp"
+
+using namespace PixCraft;
+
+namespace PixCraft::Profiler {
+	namespace {
+		typedef std::chrono::steady_clock Clock;
+		const size_t ZONE_COUNT = (size_t) ProfileZone::count;
+		
+		const char* zoneNames[ZONE_COUNT] = {
+			"Frame",
+			"Update", "Chunk loading", "Block updates", "Meshing", "Mesh upload", "Entities",
+			"Render", "Opaque pass", "Entity pass", "Particle pass", "Translucent pass", "GUI pass"
+		};
+		
+		// Times of the current frame
+		std::array<Clock::time_point, ZONE_COUNT> zoneStarts;
+		std::array<float, ZONE_COUNT> currentTimes;
+		Clock::time_point frameStart = Clock::now();
+		
+		// Times of the last frames, as rings indexed by frame
+		std::array<std::array<float, PROFILER_HISTORY>, ZONE_COUNT> cpuHistory;
+		std::array<std::array<float, PROFILER_HISTORY>, ZONE_COUNT> gpuHistory;
+		size_t cpuFrames = 0, gpuFrames = 0;
+		
+		bool hasGpuQueries = false;
+		std::array<std::array<GlId, ZONE_COUNT>, GPU_QUERY_DELAY> queries;
+		std::array<std::array<bool, ZONE_COUNT>, GPU_QUERY_DELAY> queried;
+		size_t querySlot = 0;
+		
+		ZoneStats computeStats(const std::array<float, PROFILER_HISTORY>& history, size_t frameCount) {
+			size_t count = std::min(frameCount, (size_t) PROFILER_HISTORY);
+			if(count == 0) return ZoneStats { 0.0f, 0.0f, 0.0f };
+			std::vector<float> sorted(history.begin(), history.begin() + count);
+			std::sort(sorted.begin(), sorted.end());
+			auto at = [&](float p) { return sorted[std::min((size_t) (p * count), count - 1)]; };
+			return ZoneStats { at(0.5f), at(0.95f), at(0.99f) };
+		}
+	}
+	
+	void init() {
+		for(size_t slot = 0; slot < GPU_QUERY_DELAY; ++slot) {
+			glGenQueries(ZONE_COUNT, queries[slot].data());
+			queried[slot].fill(false);
+		}
+		hasGpuQueries = true;
+	}
+	
+	void free() {
+		if(!hasGpuQueries) return;
+		for(size_t slot = 0; slot < GPU_QUERY_DELAY; ++slot) {
+			glDeleteQueries(ZONE_COUNT, queries[slot].data());
+		}
+		hasGpuQueries = false;
+	}
+	
+	void nextFrame() {
+		Clock::time_point now = Clock::now();
+		currentTimes[(size_t) ProfileZone::frame] = std::chrono::duration<float, std::milli>(now - frameStart).count();
+		frameStart = now;
+		for(size_t zone = 0; zone < ZONE_COUNT; ++zone) {
+			cpuHistory[zone][cpuFrames % PROFILER_HISTORY] = currentTimes[zone];
+		}
+		currentTimes.fill(0.0f);
+		cpuFrames++;
+		
+		// The queries of the oldest frame are finished by now, and their slot is reused for the next frame
+		if(!hasGpuQueries) return;
+		querySlot = (querySlot + 1) % GPU_QUERY_DELAY;
+		bool anyQueried = false;
+		for(size_t zone = 0; zone < ZONE_COUNT; ++zone) {
+			GLuint64 elapsed = 0;
+			if(queried[querySlot][zone]) {
+				glGetQueryObjectui64v(queries[querySlot][zone], GL_QUERY_RESULT, &elapsed);
+				anyQueried = true;
+			}
+			gpuHistory[zone][gpuFrames % PROFILER_HISTORY] = elapsed / 1e6f;
+		}
+		queried[querySlot].fill(false);
+		if(anyQueried) gpuFrames++;
+	}
+	
+	void beginZone(ProfileZone zone) {
+		zoneStarts[(size_t) zone] = Clock::now();
+		AllocTracking::beginScope(zoneName(zone));
+	}
+	
+	void endZone(ProfileZone zone) {
+		std::chrono::duration<float, std::milli> elapsed = Clock::now() - zoneStarts[(size_t) zone];
+		currentTimes[(size_t) zone] += elapsed.count();
+		AllocTracking::endScope();
+	}
+	
+	void beginGpuZone(ProfileZone zone) {
+		beginZone(zone);
+		if(!hasGpuQueries) return;
+		glBeginQuery(GL_TIME_ELAPSED, queries[querySlot][(size_t) zone]);
+		queried[querySlot][(size_t) zone] = true;
+	}
+	
+	void endGpuZone(ProfileZone zone) {
+		if(hasGpuQueries) glEndQuery(GL_TIME_ELAPSED);
+		endZone(zone);
+	}
+	
+	const char* zoneName(ProfileZone zone) {
+		return zoneNames[(size_t) zone];
+	}
+	
+	bool isGpuZone(ProfileZone zone) {
+		return zone >= ProfileZone::opaquePass && zone <= ProfileZone::guiPass;
+	}
+	
+	ZoneStats cpuStats(ProfileZone zone) {
+		return computeStats(cpuHistory[(size_t) zone], cpuFrames);
+	}
+	
+	ZoneStats gpuStats(ProfileZone zone) {
+		return computeStats(gpuHistory[(size_t) zone], gpuFrames);
+	}
+	
+	std::vector<float> frameTimes() {
+		std::vector<float> times;
+		size_t count = std::min(cpuFrames, (size_t) PROFILER_HISTORY);
+		for(size_t i = cpuFrames - count; i < cpuFrames; ++i) {
+			times.push_back(cpuHistory[(size_t) ProfileZone::frame][i % PROFILER_HISTORY]);
+		}
+		return times;
+	}
+}
+
+
+ProfileScope::ProfileScope(ProfileZone zone) : zone(zone) {
+	Profiler::beginZone(zone);
+}
+
+ProfileScope::~ProfileScope() {
+	Profiler::endZone(zone);
+}
+
+
+void FrameGraph::init() {
+	program.init(ShaderSources::cursorVS, ShaderSources::colorFS);
+	buffer.init(0, 2*sizeof(float));
+	buffer.reserve(6*(PROFILER_HISTORY + 2));
+	checkGlErrors("frame graph initialization");
+}
+
+void FrameGraph::render(int winWidth, int winHeight) {
+	// Coordinates are in pixels from the center of the window
+	float left = -winWidth/2.0f + 5.0f;
+	float bottom = -winHeight/2.0f + 5.0f;
+	std::vector<float> times = Profiler::frameTimes();
+	
+	size_t first;
+	glm::vec2* vertices = (glm::vec2*) buffer.map(6*(times.size() + 2), first);
+	auto addRect = [&](float x1, float y1, float x2, float y2) {
+		for(glm::vec2 corner : { glm::vec2(x1, y1), glm::vec2(x2, y1), glm::vec2(x2, y2),
+			glm::vec2(x2, y2), glm::vec2(x1, y2), glm::vec2(x1, y1) }) {
+			*vertices++ = corner;
+		}
+	};
+	for(size_t i = 0; i < times.size(); ++i) {
+		float x = left + i*BAR_WIDTH;
+		addRect(x, bottom, x + BAR_WIDTH, bottom + std::min(times[i], 100.0f) * PIXELS_PER_MS);
+	}
+	float graphWidth = PROFILER_HISTORY * BAR_WIDTH;
+	for(float budget : { 1000.0f/60, 1000.0f/30 }) {
+		float y = bottom + budget * PIXELS_PER_MS;
+		addRect(left, y, left + graphWidth, y + 1.0f);
+	}
+	buffer.unmap(6*(times.size() + 2));
+	
+	program.use();
+	program.setUniform("winSize", (float) winWidth, (float) winHeight);
+	buffer.bind();
+	program.setUniform("color", 1.0f, 1.0f, 1.0f, 0.6f);
+	glDrawArrays(GL_TRIANGLES, first, 6*times.size());
+	program.setUniform("color", 1.0f, 0.2f, 0.2f, 0.8f);
+	glDrawArrays(GL_TRIANGLES, first + 6*times.size(), 12);
+	buffer.unbind();
+	program.unuse();
+}
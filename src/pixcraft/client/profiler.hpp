@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "glfw.hpp"
+#include "shaders.hpp"
+
+namespace PixCraft {
+	#define PROFILER_HISTORY 240 // frames kept for the percentiles and the frame time graph
+	#define GPU_QUERY_DELAY 4 // frames before GPU timings are read back, so that reading them never waits
+	
+	enum class ProfileZone {
+		frame,
+		update, chunkLoading, blockUpdates, meshing, meshUpload, entities,
+		render, opaquePass, entityPass, particlePass, translucentPass, guiPass,
+		count
+	};
+	
+	struct ZoneStats {
+		float median, p95, p99; // in ms
+	};
+	
+	// Times zones of each frame on the CPU and, for the render passes, on the GPU.
+	// A zone can be entered several times per frame, and its times add up.
+	namespace Profiler {
+		void init(); // creates the GPU queries
+		void free();
+		// Ends the current frame and starts the next one; the frame zone is the time between calls
+		void nextFrame();
+		
+		void beginZone(ProfileZone zone);
+		void endZone(ProfileZone zone);
+		// Also times the zone on the GPU; GPU zones can't be nested, and are entered at most once per frame
+		void beginGpuZone(ProfileZone zone);
+		void endGpuZone(ProfileZone zone);
+		
+		const char* zoneName(ProfileZone zone);
+		bool isGpuZone(ProfileZone zone);
+		ZoneStats cpuStats(ProfileZone zone);
+		ZoneStats gpuStats(ProfileZone zone);
+		// Times of the last frames in ms, oldest first
+		std::vector<float> frameTimes();
+	}
+	
+	class ProfileScope {
+	public:
+		ProfileScope(ProfileZone zone);
+		~ProfileScope();
+	
+	private:
+		ProfileZone zone;
+	};
+	
+	// Bar graph of the last frame times, with lines at 60 and 30 FPS
+	class FrameGraph {
+	public:
+		void init();
+		void render(int winWidth, int winHeight);
+	
+	private:
+		static constexpr float BAR_WIDTH = 2.0f;
+		static constexpr float PIXELS_PER_MS = 4.0f;
+		
+		ShaderProgram program;
+		StreamBuffer<glm::vec2> buffer;
+	};
+}
@@ -0,0 +1,214 @@
+#include "render_benchmark.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+#include "textures.hpp"
+#include "block_textures.hpp"
+#include "view_frustum.hpp"
+#include "pixcraft/server/blocks.hpp"
+#include "pixcraft/util/util.hpp"
+
+using namespace PixCraft;
+
+namespace {
+	const float SKY_COLOR[3] = {0.75f, 0.9f, 1.0f};
+	
+	// A loop around the origin, bobbing up and down while looking around
+	void cameraAt(float t, glm::vec3& pos, glm::vec3& orient) {
+		float angle = TAU * t;
+		pos = glm::vec3(BENCHMARK_PATH_RADIUS * cos(angle), 48.0f + 8.0f * sin(2*angle), BENCHMARK_PATH_RADIUS * sin(angle));
+		orient = glm::vec3(-0.3f + 0.25f * sin(3*angle), -angle, 0.0f);
+	}
+	
+	double percentile(std::vector<double> values, double p) {
+		if(values.empty()) return 0.0;
+		std::sort(values.begin(), values.end());
+		return values[std::min((size_t) (p * values.size()), values.size() - 1)];
+	}
+	
+	void printSummary(const char* name, const std::vector<double>& values) {
+		double sum = 0.0;
+		for(double value : values) sum += value;
+		std::cout << std::fixed << std::setprecision(2) << name << ": mean " << sum / std::max((size_t) 1, values.size())
+			<< " ms, median " << percentile(values, 0.5) << " ms, 95th percentile " << percentile(values, 0.95)
+			<< " ms, 99th percentile " << percentile(values, 0.99) << " ms" << std::endl;
+	}
+}
+
+RenderBenchmark::RenderBenchmark(bool checksums)
+	: checksums(checksums), world(BENCHMARK_SEED), chunkRenderer(world, faceRenderer) {
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glGenRenderbuffers(1, &colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		throw std::runtime_error("Benchmark framebuffer is incomplete");
+	glViewport(0, 0, BENCHMARK_WIDTH, BENCHMARK_HEIGHT);
+	
+	faceRenderer.init();
+	chunkRenderer.init();
+	checkGlErrors("benchmark initialization");
+}
+
+RenderBenchmark::~RenderBenchmark() {
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteRenderbuffers(1, &depthBuffer);
+	glDeleteRenderbuffers(1, &colorBuffer);
+	glDeleteFramebuffers(1, &framebuffer);
+}
+
+void RenderBenchmark::loadWorld() {
+	// Every chunk the camera can see from the path
+	int32_t radius = (int32_t) std::ceil(BENCHMARK_PATH_RADIUS / CHUNK_SIZE) + BENCHMARK_RENDER_DIST + 1;
+	for(int32_t chunkX = -radius; chunkX <= radius; ++chunkX) {
+		for(int32_t chunkZ = -radius; chunkZ <= radius; ++chunkZ) {
+			world.genChunk(chunkX, chunkZ);
+		}
+	}
+	chunkRenderer.updateBlocks();
+	while(chunkRenderer.pendingMeshCount() > 0) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		chunkRenderer.updateBlocks();
+	}
+}
+
+void RenderBenchmark::run(int frameCount) {
+	auto loadStart = std::chrono::steady_clock::now();
+	loadWorld();
+	std::chrono::duration<double> loadTime = std::chrono::steady_clock::now() - loadStart;
+	std::cout << "Loaded " << chunkRenderer.renderedChunkCount() << " chunks in " << loadTime.count() << " s" << std::endl;
+	
+	// The GPU times are read at the end, so that waiting for them doesn't stall the frames
+	std::vector<GlId> queries(frameCount);
+	glGenQueries(frameCount, queries.data());
+	frames.assign(frameCount, FrameTiming { 0.0, 0.0, 0.0, 0 });
+	for(int frame = 0; frame < frameCount; ++frame) {
+		glm::vec3 pos, orient;
+		cameraAt((float) frame / frameCount, pos, orient);
+		
+		auto start = std::chrono::steady_clock::now();
+		glBeginQuery(GL_TIME_ELAPSED, queries[frame]);
+		renderFrame(pos, orient);
+		glEndQuery(GL_TIME_ELAPSED);
+		std::chrono::duration<double, std::milli> cpuTime = std::chrono::steady_clock::now() - start;
+		frames[frame].cpuMs = cpuTime.count();
+		// Software renderers draw on the CPU, and only finishing the frame shows their actual cost
+		glFinish();
+		std::chrono::duration<double, std::milli> frameTime = std::chrono::steady_clock::now() - start;
+		frames[frame].frameMs = frameTime.count();
+		if(checksums) frames[frame].checksum = computeChecksum();
+	}
+	
+	for(int frame = 0; frame < frameCount; ++frame) {
+		GLuint64 elapsed;
+		glGetQueryObjectui64v(queries[frame], GL_QUERY_RESULT, &elapsed);
+		frames[frame].gpuMs = elapsed / 1e6;
+	}
+	glDeleteQueries(frameCount, queries.data());
+	checkGlErrors("benchmark rendering");
+}
+
+void RenderBenchmark::renderFrame(glm::vec3 pos, glm::vec3 orient) {
+	float fovy = glm::radians(90.0f);
+	float aspect = (float) BENCHMARK_WIDTH / BENCHMARK_HEIGHT;
+	float near = 0.001f;
+	float far = 1000.0f;
+	glm::mat4 proj = glm::perspective(fovy, aspect, near, far);
+	glm::mat4 view = globalToLocal(pos, orient);
+	ViewFrustum vf = computeViewFrustum(fovy, aspect, near, far, pos, orient);
+	
+	glClearColor(SKY_COLOR[0], SKY_COLOR[1], SKY_COLOR[2], 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glEnable(GL_CULL_FACE);
+	glEnable(GL_BLEND);
+	glEnable(GL_DEPTH_TEST);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	
+	float fogEnd = BENCHMARK_RENDER_DIST * CHUNK_SIZE;
+	RenderParams params = {
+		{ SKY_COLOR[0], SKY_COLOR[1], SKY_COLOR[2] },
+		true, true,
+		fogEnd * 0.9f, fogEnd,
+	};
+	faceRenderer.startRendering(proj, view, params);
+	chunkRenderer.render(pos, BENCHMARK_RENDER_DIST, vf);
+	faceRenderer.stopRendering();
+	faceRenderer.startRendering(proj, view, params);
+	chunkRenderer.renderTranslucent();
+	faceRenderer.stopRendering();
+}
+
+uint64_t RenderBenchmark::computeChecksum() {
+	// FNV-1a of the pixels
+	std::vector<uint8_t> pixels(BENCHMARK_WIDTH * BENCHMARK_HEIGHT * 4);
+	glReadPixels(0, 0, BENCHMARK_WIDTH, BENCHMARK_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	uint64_t hash = 14695981039346656037ULL;
+	for(uint8_t byte : pixels) {
+		hash ^= byte;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+void RenderBenchmark::writeReport(std::string path) {
+	std::ofstream file(path);
+	if(!file) throw std::runtime_error("Failed to open benchmark report " + path);
+	file << "frame,cpu_ms,gpu_ms,frame_ms" << (checksums ? ",checksum" : "") << "\n";
+	std::vector<double> cpuTimes, gpuTimes, frameTimes;
+	for(size_t frame = 0; frame < frames.size(); ++frame) {
+		FrameTiming& timing = frames[frame];
+		file << frame << "," << std::fixed << std::setprecision(4) << timing.cpuMs << "," << timing.gpuMs << "," << timing.frameMs;
+		if(checksums) file << "," << std::hex << std::setw(16) << std::setfill('0') << timing.checksum << std::dec << std::setfill(' ');
+		file << "\n";
+		cpuTimes.push_back(timing.cpuMs);
+		gpuTimes.push_back(timing.gpuMs);
+		frameTimes.push_back(timing.frameMs);
+	}
+	
+	std::cout << "Rendered " << frames.size() << " frames at " << BENCHMARK_WIDTH << "x" << BENCHMARK_HEIGHT << std::endl;
+	printSummary("CPU", cpuTimes);
+	printSummary("GPU", gpuTimes);
+	printSummary("Frame", frameTimes);
+	std::cout << "Report written to " << path << std::endl;
+}
+
+int PixCraft::runRenderBenchmark(std::string reportPath, int frameCount, bool checksums) {
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	GLFWwindow* window = glfwCreateWindow(BENCHMARK_WIDTH, BENCHMARK_HEIGHT, "PixCraft benchmark", nullptr, nullptr);
+	if(window == nullptr)
+		throw std::runtime_error("Failed to create GLFW window");
+	glfwMakeContextCurrent(window);
+	if(!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress))
+		throw std::runtime_error("Failed to initialize GLAD");
+	loadOptionalGlFunctions((GLADloadproc) glfwGetProcAddress);
+	std::cout << "Using OpenGL version " << GLVersion.major << "." << GLVersion.minor
+		<< " (" << glGetString(GL_RENDERER) << ")" << std::endl;
+	
+	TextureManager::loadTextures();
+	BlockRegistry::defineBlocks();
+	BlockTextures::defineTextures();
+	{
+		RenderBenchmark benchmark(checksums);
+		benchmark.run(frameCount);
+		benchmark.writeReport(reportPath);
+	}
+	glfwDestroyWindow(window);
+	return 0;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "glfw.hpp"
+#include "pixcraft/util/glm.hpp"
+
+#include "face_renderer.hpp"
+#include "chunk_renderer.hpp"
+#include "pixcraft/server/world.hpp"
+#include "pixcraft/server/mob.hpp"
+
+namespace PixCraft {
+	#define BENCHMARK_SEED 1234
+	#define BENCHMARK_WIDTH 1280
+	#define BENCHMARK_HEIGHT 720
+	#define BENCHMARK_RENDER_DIST 8
+	#define BENCHMARK_PATH_RADIUS 64.0f
+	
+	struct FrameTiming {
+		double cpuMs; // time to submit the frame
+		double gpuMs; // time the GPU spent on it
+		double frameMs; // time until the frame was finished
+		uint64_t checksum; // hash of the rendered image, if requested
+	};
+	
+	// Renders a fixed world along a scripted camera path into an offscreen framebuffer, timing every frame.
+	// Everything is loaded and meshed beforehand, so that runs are comparable and the images reproducible.
+	// It only needs a current OpenGL context, so the window can stay hidden.
+	class RenderBenchmark {
+	public:
+		RenderBenchmark(bool checksums);
+		~RenderBenchmark();
+		
+		void run(int frameCount);
+		// Writes the timings of each frame as CSV, and prints a summary
+		void writeReport(std::string path);
+		
+	private:
+		bool checksums;
+		GlId framebuffer, colorBuffer, depthBuffer;
+		
+		World world;
+		FaceRenderer faceRenderer;
+		ChunkRenderer chunkRenderer;
+		
+		std::vector<FrameTiming> frames;
+		
+		void loadWorld();
+		void renderFrame(glm::vec3 pos, glm::vec3 orient);
+		uint64_t computeChecksum();
+	};
+	
+	// Runs the benchmark in a hidden window; without a display, it can run in a virtual one on a software renderer.
+	// Returns the process exit code.
+	int runRenderBenchmark(std::string reportPath, int frameCount, bool checksums);
+}
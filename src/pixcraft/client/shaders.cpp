@@ -1,6 +1,7 @@
 #include "shaders.hpp"
 
 #include <iostream>
+#include <vector>
 
 using namespace PixCraft;
 
@@ -53,35 +54,88 @@ void ShaderProgram::init(const char* vertexSrc, const char* geometrySrc, const c
 	glDeleteShader(fragmentShader);
 	if(geometrySrc != nullptr)
 		glDeleteShader(geometryShader);
+	
+	findUniformLocations();
 }
 
 void ShaderProgram::init(const char* vertexSrc, const char* fragmentSrc) {
 	init(vertexSrc, nullptr, fragmentSrc);
 }
 
+void ShaderProgram::findUniformLocations() {
+	uniformLocations.clear();
+	GLint count, maxLength;
+	glGetProgramiv(programId, GL_ACTIVE_UNIFORMS, &count);
+	glGetProgramiv(programId, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+	std::vector<char> nameBuffer(maxLength);
+	for(GLint i = 0; i < count; ++i) {
+		GLsizei length;
+		GLint size;
+		GLenum type;
+		glGetActiveUniform(programId, i, maxLength, &length, &size, &type, nameBuffer.data());
+		std::string name(nameBuffer.data(), length);
+		// Arrays are named after their first element
+		if(name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) name.resize(name.size() - 3);
+		uniformLocations.emplace_back(name, glGetUniformLocation(programId, nameBuffer.data()));
+	}
+}
+
+GLint ShaderProgram::uniformLocation(const char* name) {
+	for(auto& uniform : uniformLocations) {
+		if(uniform.first == name) return uniform.second;
+	}
+	// Uniforms that were optimized out are ignored by OpenGL, like with glGetUniformLocation
+	return -1;
+}
+
+void ShaderProgram::setUniform(GLint location, bool val) {
+	glUniform1i(location, val);
+}
+void ShaderProgram::setUniform(GLint location, uint32_t val) {
+	glUniform1i(location, val);
+}
+void ShaderProgram::setUniform(GLint location, float val) {
+	glUniform1f(location, val);
+}
+void ShaderProgram::setUniform(GLint location, float x, float y) {
+	glUniform2f(location, x, y);
+}
+void ShaderProgram::setUniform(GLint location, glm::vec3 val) {
+	glUniform3fv(location, 1, glm::value_ptr(val));
+}
+void ShaderProgram::setUniform(GLint location, float r, float g, float b) {
+	glUniform3f(location, r, g, b);
+}
+void ShaderProgram::setUniform(GLint location, float r, float g, float b, float a) {
+	glUniform4f(location, r, g, b, a);
+}
+void ShaderProgram::setUniform(GLint location, glm::mat4& val) {
+	glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(val));
+}
+
 void ShaderProgram::setUniform(const char* name, bool val) {
-	glUniform1i(glGetUniformLocation(programId, name), val);
+	setUniform(uniformLocation(name), val);
 }
 void ShaderProgram::setUniform(const char* name, uint32_t val) {
-	glUniform1i(glGetUniformLocation(programId, name), val);
+	setUniform(uniformLocation(name), val);
 }
 void ShaderProgram::setUniform(const char* name, float val) {
-	glUniform1f(glGetUniformLocation(programId, name), val);
+	setUniform(uniformLocation(name), val);
 }
 void ShaderProgram::setUniform(const char* name, float x, float y) {
-	glUniform2f(glGetUniformLocation(programId, name), x, y);
+	setUniform(uniformLocation(name), x, y);
 }
 void ShaderProgram::setUniform(const char* name, glm::vec3 val) {
-	glUniform3fv(glGetUniformLocation(programId, name), 1, glm::value_ptr(val));
+	setUniform(uniformLocation(name), val);
 }
 void ShaderProgram::setUniform(const char* name, float r, float g, float b) {
-	glUniform3f(glGetUniformLocation(programId, name), r, g, b);
+	setUniform(uniformLocation(name), r, g, b);
 }
 void ShaderProgram::setUniform(const char* name, float r, float g, float b, float a) {
-	glUniform4f(glGetUniformLocation(programId, name), r, g, b, a);
+	setUniform(uniformLocation(name), r, g, b, a);
 }
 void ShaderProgram::setUniform(const char* name, glm::mat4& val) {
-	glUniformMatrix4fv(glGetUniformLocation(programId, name), 1, GL_FALSE, glm::value_ptr(val));
+	setUniform(uniformLocation(name), val);
 }
 
 void ShaderProgram::use() {
@@ -142,6 +196,11 @@ void PixCraft::setAttributePointer<glm::vec4>(int location, size_t offset, size_
 	glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, totalSize, (void*) offset);
 }
 
+template<>
+void PixCraft::setAttributePointer<glm::uvec2>(int location, size_t offset, size_t totalSize) {
+	glVertexAttribIPointer(location, 2, GL_UNSIGNED_BYTE, totalSize, (void*) offset);
+}
+
 template<>
 void PixCraft::setAttributePointer<glm::uvec3>(int location, size_t offset, size_t totalSize) {
 	glVertexAttribIPointer(location, 3, GL_UNSIGNED_BYTE, totalSize, (void*) offset);
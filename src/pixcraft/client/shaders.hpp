@@ -1,13 +1,18 @@
 #pragma once
 
 #include <array>
+#include <string>
+#include <vector>
+#include <utility>
 
 #include "glfw.hpp"
 #include "pixcraft/util/glm.hpp"
+#include "pixcraft/util/memory_stats.hpp"
 
 namespace PixCraft {
 	namespace ShaderSources {
 		extern const char *blockVS, *blockGS, *blockFS;
+		extern const char *blockPullVS;
 		extern const char *entityVS, *entityFS;
 		extern const char *particleVS, *particleFS;
 		extern const char *menuBgVS, *menuBgFS;
@@ -28,6 +33,18 @@ namespace PixCraft {
 		void init(const char* vertexSrc, const char* geometrySrc, const char* fragmentSrc);
 		void init(const char* vertexSrc, const char* fragmentSrc);
 		
+		// Location of a uniform, or -1 if it's not active; renderers look up the uniforms they set often once after init
+		GLint uniformLocation(const char* name);
+		
+		void setUniform(GLint location, bool val);
+		void setUniform(GLint location, uint32_t val);
+		void setUniform(GLint location, float val);
+		void setUniform(GLint location, float x, float y);
+		void setUniform(GLint location, glm::vec3 val);
+		void setUniform(GLint location, float r, float g, float b);
+		void setUniform(GLint location, float r, float g, float b, float a);
+		void setUniform(GLint location, glm::mat4& val);
+		
 		void setUniform(const char* name, bool val);
 		void setUniform(const char* name, uint32_t val);
 		void setUniform(const char* name, float val);
@@ -37,6 +54,8 @@ namespace PixCraft {
 		void setUniform(const char* name, float r, float g, float b, float a);
 		void setUniform(const char* name, glm::mat4& val);
 		
+		template<std::size_t N>
+		void setUniformArray(GLint location, std::array<glm::mat3, N> array);
 		template<std::size_t N>
 		void setUniformArray(const char* name, std::array<glm::mat3, N> array);
 		
@@ -45,6 +64,11 @@ namespace PixCraft {
 		
 	private:
 		GlId programId;
+		// Locations of the active uniforms, queried once after linking; programs have few of them,
+		// so they're searched linearly, which also avoids building a string for each lookup
+		std::vector<std::pair<std::string, GLint>> uniformLocations;
+		
+		void findUniformLocations();
 	};
 	
 	
@@ -75,13 +99,22 @@ namespace PixCraft {
 		
 		void loadData(const void* data, size_t vertexCount, GLenum usage);
 		size_t vertexCount();
+		GlId bufferId();
 		
 		void updateData(const void* data, size_t vertexCount);
+		void updateData(const void* data, size_t firstVertex, size_t vertexCount);
+		// Reallocates the buffer, keeping the data that still fits
+		void resize(size_t vertexCount, GLenum usage);
 		
+		// Subsystem the buffer's GPU memory is counted for; set it before loading data
+		MemoryTag memoryTag();
+		void memoryTag(MemoryTag tag);
+	
 	protected:
 		size_t vertexSize;
 		
 		void initLocation(int location, size_t vertexSize);
+		void trackGpuBytes(size_t bytes);
 		
 		void genBuffers() override;
 		void setVAO() override;
@@ -91,6 +124,8 @@ namespace PixCraft {
 	private:
 		GlId vboId;
 		size_t _vertexCount;
+		MemoryTag _memoryTag;
+		size_t gpuBytes;
 	};
 	
 	template<typename T>
@@ -115,6 +150,32 @@ namespace PixCraft {
 		size_t offset;
 	};
 	
+	#define STREAM_SEGMENTS 4
+	
+	// A vertex buffer for geometry that changes every frame, written as a ring so that writes never wait on draws.
+	// With buffer storage, the buffer stays mapped, and a segment of the ring is only reused once a fence placed after
+	// its last draw has passed. Otherwise, ranges are mapped unsynchronized, and the buffer is orphaned when the ring wraps.
+	template<typename... Ts>
+	class StreamBuffer : public VertexBuffer<Ts...> {
+	public:
+		StreamBuffer();
+		virtual ~StreamBuffer();
+		
+		// Allocates the ring; segmentSize is the most vertices that can be written at once
+		void reserve(size_t segmentSize);
+		// Returns where to write up to maxCount vertices, and in first the index to draw them from
+		void* map(size_t maxCount, size_t& first);
+		// Ends the write of the first count vertices; they must be drawn before the next call to map
+		void unmap(size_t count);
+		
+	private:
+		size_t segmentSize;
+		size_t segment, head;
+		bool persistent;
+		char* mapping; // the whole buffer with buffer storage, the written range otherwise
+		std::array<GLsync, STREAM_SEGMENTS> fences;
+	};
+	
 	template<typename... Ts>
 	class IndexBuffer : public VertexBuffer<Ts...> {
 	public:
@@ -133,6 +194,7 @@ namespace PixCraft {
 	private:
 		GlId eboId;
 		size_t _indexCount;
+		size_t indexBytes;
 	};
 }
 
@@ -1,21 +1,29 @@
 #pragma once
 
 #include <iostream>
+#include <algorithm>
+#include <stdexcept>
 
 namespace PixCraft {
+	template<std::size_t N>
+	void ShaderProgram::setUniformArray(GLint location, std::array<glm::mat3, N> array) {
+		glUniformMatrix3fv(location, N, GL_FALSE, glm::value_ptr(array[0]));
+	}
+
 	template<std::size_t N>
 	void ShaderProgram::setUniformArray(const char* name, std::array<glm::mat3, N> array) {
-		glUniformMatrix3fv(glGetUniformLocation(programId, name), N, GL_FALSE, glm::value_ptr(array[0]));
+		setUniformArray(uniformLocation(name), array);
 	}
 
 
 	template<typename... Ts>
-	VertexBuffer<Ts...>::VertexBuffer() : vboId(0), _vertexCount(0) {}
+	VertexBuffer<Ts...>::VertexBuffer() : vboId(0), _vertexCount(0), _memoryTag(MemoryTag::other), gpuBytes(0) {}
 
 	template<typename... Ts>
 	VertexBuffer<Ts...>::~VertexBuffer() {
 		if(vboId == 0) return;
 		glDeleteBuffers(1, &vboId);
+		trackGpuBytes(0);
 	}
 
 	template<typename... Ts>
@@ -23,17 +31,58 @@ namespace PixCraft {
 		_vertexCount = vertexCount;
 		glBindBuffer(GL_ARRAY_BUFFER, vboId);
 		glBufferData(GL_ARRAY_BUFFER, vertexSize*vertexCount, data, usage);
+		trackGpuBytes(vertexSize*vertexCount);
 	}
 
 	template<typename... Ts>
 	size_t VertexBuffer<Ts...>::vertexCount() { return _vertexCount; }
 
+	template<typename... Ts>
+	GlId VertexBuffer<Ts...>::bufferId() { return vboId; }
+
 	template<typename... Ts>
 	void VertexBuffer<Ts...>::updateData(const void* data, size_t vertexCount) {
 		glBindBuffer(GL_ARRAY_BUFFER, vboId);
 		glBufferSubData(GL_ARRAY_BUFFER, 0, vertexSize*vertexCount, data);
 	}
 
+	template<typename... Ts>
+	void VertexBuffer<Ts...>::updateData(const void* data, size_t firstVertex, size_t vertexCount) {
+		glBindBuffer(GL_ARRAY_BUFFER, vboId);
+		glBufferSubData(GL_ARRAY_BUFFER, vertexSize*firstVertex, vertexSize*vertexCount, data);
+	}
+
+	template<typename... Ts>
+	void VertexBuffer<Ts...>::resize(size_t vertexCount, GLenum usage) {
+		GlId newVboId;
+		glGenBuffers(1, &newVboId);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, newVboId);
+		glBufferData(GL_COPY_WRITE_BUFFER, vertexSize*vertexCount, nullptr, usage);
+		glBindBuffer(GL_COPY_READ_BUFFER, vboId);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, vertexSize*std::min(vertexCount, _vertexCount));
+		glDeleteBuffers(1, &vboId);
+		vboId = newVboId;
+		_vertexCount = vertexCount;
+		trackGpuBytes(vertexSize*vertexCount);
+		
+		// The attribute pointers still refer to the old buffer
+		VertexArray::bind();
+		setVAO();
+		VertexArray::unbind();
+	}
+	
+	template<typename... Ts>
+	MemoryTag VertexBuffer<Ts...>::memoryTag() { return _memoryTag; }
+	
+	template<typename... Ts>
+	void VertexBuffer<Ts...>::memoryTag(MemoryTag tag) { _memoryTag = tag; }
+	
+	template<typename... Ts>
+	void VertexBuffer<Ts...>::trackGpuBytes(size_t bytes) {
+		MemoryStats::addGpu(_memoryTag, (int64_t) bytes - (int64_t) gpuBytes);
+		gpuBytes = bytes;
+	}
+
 	template<typename... Ts>
 	void VertexBuffer<Ts...>::initLocation(int location, size_t vertexSize2) {
 		vertexSize = vertexSize2;
@@ -81,12 +130,82 @@ namespace PixCraft {
 
 
 	template<typename... Ts>
-	IndexBuffer<Ts...>::IndexBuffer() : eboId(0), _indexCount(0) {}
+	StreamBuffer<Ts...>::StreamBuffer() : segmentSize(0), segment(0), head(0), persistent(false), mapping(nullptr) {
+		fences.fill(nullptr);
+	}
+
+	template<typename... Ts>
+	StreamBuffer<Ts...>::~StreamBuffer() {
+		for(GLsync fence : fences) {
+			if(fence != nullptr) glDeleteSync(fence);
+		}
+	}
+
+	template<typename... Ts>
+	void StreamBuffer<Ts...>::reserve(size_t segmentSize2) {
+		segmentSize = segmentSize2;
+		size_t size = this->vertexSize * segmentSize * STREAM_SEGMENTS;
+		persistent = glBufferStorageOpt != nullptr;
+		glBindBuffer(GL_ARRAY_BUFFER, this->bufferId());
+		if(persistent) {
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorageOpt(GL_ARRAY_BUFFER, size, nullptr, flags);
+			mapping = (char*) glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+		} else {
+			glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+		}
+		this->trackGpuBytes(size);
+	}
+
+	template<typename... Ts>
+	void* StreamBuffer<Ts...>::map(size_t maxCount, size_t& first) {
+		if(maxCount > segmentSize) throw std::logic_error("Too many vertices streamed at once");
+		glBindBuffer(GL_ARRAY_BUFFER, this->bufferId());
+		
+		// Writes don't straddle segments, so all the draws from a segment have been issued when moving past it
+		if(head + maxCount > (segment + 1) * segmentSize) {
+			size_t next = (segment + 1) % STREAM_SEGMENTS;
+			if(persistent) {
+				fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+				if(fences[next] != nullptr) {
+					while(glClientWaitSync(fences[next], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED);
+					glDeleteSync(fences[next]);
+					fences[next] = nullptr;
+				}
+			} else if(next == 0) {
+				glBufferData(GL_ARRAY_BUFFER, this->vertexSize * segmentSize * STREAM_SEGMENTS, nullptr, GL_STREAM_DRAW);
+			}
+			segment = next;
+			head = segment * segmentSize;
+		}
+		
+		first = head;
+		if(persistent) return mapping + this->vertexSize * head;
+		if(maxCount == 0) return nullptr; // empty ranges can't be mapped
+		mapping = (char*) glMapBufferRange(GL_ARRAY_BUFFER, this->vertexSize * head, this->vertexSize * maxCount,
+			GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		return mapping;
+	}
+
+	template<typename... Ts>
+	void StreamBuffer<Ts...>::unmap(size_t count) {
+		if(!persistent && mapping != nullptr) {
+			glBindBuffer(GL_ARRAY_BUFFER, this->bufferId());
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			mapping = nullptr;
+		}
+		head += count;
+	}
+
+
+	template<typename... Ts>
+	IndexBuffer<Ts...>::IndexBuffer() : eboId(0), _indexCount(0), indexBytes(0) {}
 
 	template<typename... Ts>
 	IndexBuffer<Ts...>::~IndexBuffer() {
 		if(eboId == 0) return;
 		glDeleteBuffers(1, &eboId);
+		MemoryStats::addGpu(this->memoryTag(), -(int64_t) indexBytes);
 	}
 
 	template<typename... Ts>
@@ -94,6 +213,8 @@ namespace PixCraft {
 		_indexCount = indexCount;
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eboId);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount*sizeof(unsigned int), data, GL_STATIC_DRAW);
+		MemoryStats::addGpu(this->memoryTag(), (int64_t) (indexCount*sizeof(unsigned int)) - (int64_t) indexBytes);
+		indexBytes = indexCount*sizeof(unsigned int);
 	}
 
 	template<typename... Ts>
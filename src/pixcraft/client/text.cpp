@@ -32,6 +32,7 @@ void TextRenderer::init() {
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1); // Disable byte-alignment restriction
 	
 	glyphAtlas.init(512, 512);
+	MemoryStats::addGpu(MemoryTag::text, glyphAtlas.byteSize());
 	
 	// Preload ASCII characters at least
 	glyphAtlas.bind();
@@ -40,8 +41,12 @@ void TextRenderer::init() {
 	}
 	
 	program.init(ShaderSources::guiVS, ShaderSources::textFS);
+	winSizeLocation = program.uniformLocation("winSize");
+	texLocation = program.uniformLocation("tex");
+	textColorLocation = program.uniformLocation("textColor");
 	buffer.init(0, 2*sizeof(float), 4*sizeof(float));
-	buffer.loadData(nullptr, 6*BUFFER_SIZE, GL_STREAM_DRAW);
+	buffer.memoryTag(MemoryTag::text);
+	buffer.reserve(6*SEGMENT_GLYPHS);
 	checkGlErrors("text renderer initialization");
 }
 
@@ -52,6 +57,10 @@ void TextRenderer::free() {
 	FT_Done_FreeType(ft);
 }
 
+void TextRenderer::reportMemory(MemoryReport& report) {
+	report.addCpu(MemoryTag::text, heapBytes(characters));
+}
+
 void TextRenderer::setViewport(int width, int height) {
 	winWidth = width; winHeight = height;
 }
@@ -95,9 +104,9 @@ void TextRenderer::renderText(std::string str, float startX, float startY, glm::
 	
 	glyphAtlas.bind();
 	
-	program.setUniform("winSize", (float) winWidth, (float) winHeight);
-	program.setUniform("tex", (uint32_t) 0);
-	program.setUniform("textColor", color.r, color.g, color.b, color.a);
+	program.setUniform(winSizeLocation, (float) winWidth, (float) winHeight);
+	program.setUniform(texLocation, (uint32_t) 0);
+	program.setUniform(textColorLocation, color.r, color.g, color.b, color.a);
 	
 	float x = startX;
 	float y = startY;
@@ -107,8 +116,11 @@ void TextRenderer::renderText(std::string str, float startX, float startY, glm::
 	std::string::const_iterator end = str.end();
 	uint32_t cp;
 	
-	std::array<float, QUAD_SIZE*BUFFER_SIZE> quadBuffer;
-	auto bufferIt = quadBuffer.begin();
+	// The quads are written straight into the stream buffer, in batches of at most BUFFER_SIZE glyphs
+	size_t first;
+	size_t batchSize = std::min<size_t>(utf8::distance(it, end), BUFFER_SIZE);
+	float* quads = (float*) buffer.map(6*batchSize, first);
+	float* bufferIt = quads;
 	
 	while(it != end) {
 		cp = utf8::next(it, end);
@@ -123,20 +135,20 @@ void TextRenderer::renderText(std::string str, float startX, float startY, glm::
 		
 		renderGlyphData(bufferIt, characterData.glyphData, x, y);
 		
-		if(bufferIt == quadBuffer.end()) {
-			bufferIt = quadBuffer.begin();
-			buffer.updateData(quadBuffer.data(), quadBuffer.size()/4);
-			glDrawArrays(GL_TRIANGLES, 0, quadBuffer.size()/4);
+		if(bufferIt == quads + QUAD_SIZE*batchSize) {
+			buffer.unmap(6*batchSize);
+			glDrawArrays(GL_TRIANGLES, first, 6*batchSize);
+			batchSize = std::min<size_t>(utf8::distance(it, end), BUFFER_SIZE);
+			quads = (float*) buffer.map(6*batchSize, first);
+			bufferIt = quads;
 		}
 		
 		x += characterData.advance >> 6; // Bitshift by 6 to get value in pixels (2^6 = 64)
 	}
 	
-	if(bufferIt != quadBuffer.begin()) {
-		size_t vertices = (bufferIt - quadBuffer.begin())/4;
-		buffer.updateData(quadBuffer.data(), vertices);
-		glDrawArrays(GL_TRIANGLES, 0, vertices);
-	}
+	size_t vertices = (bufferIt - quads)/4;
+	buffer.unmap(vertices);
+	if(vertices > 0) glDrawArrays(GL_TRIANGLES, first, vertices);
 	
 	buffer.unbind();
 	program.unuse();
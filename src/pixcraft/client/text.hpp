@@ -40,9 +40,12 @@ namespace PixCraft {
 		
 		void renderText(std::string str, float x, float y, glm::vec4 color);
 		
+		void reportMemory(MemoryReport& report);
+	
 	private:
 		static const size_t QUAD_SIZE = 24;
-		static const int BUFFER_SIZE = 32;
+		static const int BUFFER_SIZE = 256; // most glyphs per draw
+		static const int SEGMENT_GLYPHS = 2048; // glyphs per segment of the stream buffer
 		
 		FT_Library ft;
 		FT_Stroker stroker;
@@ -52,7 +55,8 @@ namespace PixCraft {
 		
 		int winWidth, winHeight;
 		ShaderProgram program;
-		VertexBuffer<glm::vec2, glm::vec2> buffer;
+		GLint winSizeLocation, texLocation, textColorLocation;
+		StreamBuffer<glm::vec2, glm::vec2> buffer;
 		int fontHeight;
 		int xHeight;
 		
@@ -92,4 +92,8 @@ void TextureAtlas::bind() {
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, texture);
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+}
+
+size_t TextureAtlas::byteSize() {
+	return width * height * 2; // internalFormat has 2 channels
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <vector>
+#include <cstddef>
 
 #include "glfw.hpp"
 
@@ -22,6 +23,7 @@ namespace PixCraft {
 		float getB(unsigned int textureId);
 		
 		void bind();
+		size_t byteSize();
 		
 	private:
 		GlId texture;
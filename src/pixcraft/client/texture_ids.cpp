@@ -0,0 +1,45 @@
+#include "textures.hpp"
+
+#include <vector>
+#include <string>
+
+// The ids of the textures, separate from their loading so that code without a GL context (e.g. meshing) can use them
+
+namespace PixCraft::TextureManager {
+	namespace {
+		std::vector<std::string> blockTextureFiles;
+		std::vector<std::string> otherTextureFiles;
+		
+		TexId requireBlockTexture(const char* filename) {
+			blockTextureFiles.push_back(std::string(filename));
+			return blockTextureFiles.size() - 1;
+		}
+		
+		TexId requireTexture(const char* filename) {
+			otherTextureFiles.push_back(std::string(filename));
+			return otherTextureFiles.size() - 1;
+		}
+	}
+	
+	const TexId PLACEHOLDER = requireBlockTexture("placeholder");
+	const TexId STONE = requireBlockTexture("stone");
+	const TexId DIRT = requireBlockTexture("dirt");
+	const TexId GRASS_SIDE = requireBlockTexture("grass_side");
+	const TexId GRASS_TOP = requireBlockTexture("grass_top");
+	const TexId TRUNK_SIDE = requireBlockTexture("trunk_side");
+	const TexId TRUNK_INSIDE = requireBlockTexture("trunk_inside");
+	const TexId LEAVES = requireBlockTexture("leaves");
+	const TexId WATER = requireBlockTexture("water");
+	const TexId PLANKS = requireBlockTexture("planks");
+	const TexId LAMP = requireBlockTexture("lamp");
+	
+	const TexId SLIME = requireTexture("entity/slime");
+	
+	const TexId LOGO = requireTexture("gui/logo");
+	const TexId BUTTON = requireTexture("gui/button");
+	
+	unsigned int blockTextureCount() { return blockTextureFiles.size(); }
+	std::string blockTextureName(TexId texId) { return blockTextureFiles[texId]; }
+	unsigned int otherTextureCount() { return otherTextureFiles.size(); }
+	std::string otherTextureName(TexId texId) { return otherTextureFiles[texId]; }
+}
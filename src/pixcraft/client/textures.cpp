@@ -9,58 +9,32 @@
 #include <stb_image.h>
 #include "glfw.hpp"
 #include "../util/glm.hpp"
+#include "../util/memory_stats.hpp"
 
 namespace PixCraft::TextureManager {
 	namespace {
-		std::vector<std::string> blockTextureFiles;
 		GlId blockTextureArray;
 		
-		std::vector<std::string> otherTextureFiles;
 		std::vector<GlId> otherTextures;
 		std::vector<glm::uvec2> otherTextureDim;
-		
-		TexId requireBlockTexture(const char* filename) {
-			blockTextureFiles.push_back(std::string(filename));
-			return blockTextureFiles.size() - 1;
-		}
-		
-		TexId requireTexture(const char* filename) {
-			otherTextureFiles.push_back(std::string(filename));
-			return otherTextureFiles.size() - 1;
-		}
 	}
 	
-	const TexId PLACEHOLDER = requireBlockTexture("placeholder");
-	const TexId STONE = requireBlockTexture("stone");
-	const TexId DIRT = requireBlockTexture("dirt");
-	const TexId GRASS_SIDE = requireBlockTexture("grass_side");
-	const TexId GRASS_TOP = requireBlockTexture("grass_top");
-	const TexId TRUNK_SIDE = requireBlockTexture("trunk_side");
-	const TexId TRUNK_INSIDE = requireBlockTexture("trunk_inside");
-	const TexId LEAVES = requireBlockTexture("leaves");
-	const TexId WATER = requireBlockTexture("water");
-	const TexId PLANKS = requireBlockTexture("planks");
-	
-	const TexId SLIME = requireTexture("entity/slime");
-	
-	const TexId LOGO = requireTexture("gui/logo");
-	const TexId BUTTON = requireTexture("gui/button");
-	
 	void loadTextures() {
 		glGenTextures(1, &blockTextureArray);
 		glBindTexture(GL_TEXTURE_2D_ARRAY, blockTextureArray);
 		glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, BLOCK_TEX_SIZE, BLOCK_TEX_SIZE,
-			blockTextureFiles.size(), 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+			blockTextureCount(), 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
 		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		// Merged faces tile the texture
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		
 		int width, height, nrChannels;
 		stbi_set_flip_vertically_on_load(true);
 		
-		for(unsigned int i = 0; i < blockTextureFiles.size(); ++i) {
-			std::string filename = "res/block/" + blockTextureFiles[i] + ".png";
+		for(unsigned int i = 0; i < blockTextureCount(); ++i) {
+			std::string filename = "res/block/" + blockTextureName(i) + ".png";
 			unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrChannels, 0);
 			if(!data) throw std::runtime_error("Failed to load block texture");
 			if(width != BLOCK_TEX_SIZE || height != BLOCK_TEX_SIZE) throw std::runtime_error("Block texture has incorrect dimensions");
@@ -71,12 +45,14 @@ namespace PixCraft::TextureManager {
 			stbi_image_free(data);
 		}
 		glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+		// Mipmaps add a third to the size
+		MemoryStats::addGpu(MemoryTag::textures, BLOCK_TEX_SIZE*BLOCK_TEX_SIZE*4 * blockTextureCount() * 4/3);
 		
-		otherTextures.assign(otherTextureFiles.size(), 0);
-		glGenTextures(otherTextureFiles.size(), otherTextures.data());
+		otherTextures.assign(otherTextureCount(), 0);
+		glGenTextures(otherTextureCount(), otherTextures.data());
 		
-		for(unsigned int i = 0; i < otherTextureFiles.size(); ++i) {
-			std::string filename = "res/" + otherTextureFiles[i] + ".png";
+		for(unsigned int i = 0; i < otherTextureCount(); ++i) {
+			std::string filename = "res/" + otherTextureName(i) + ".png";
 			unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrChannels, 0);
 			if(!data) throw std::runtime_error("Failed to load texture");
 			
@@ -91,6 +67,7 @@ namespace PixCraft::TextureManager {
 			else if(nrChannels == 4)
 				glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
 			glGenerateMipmap(GL_TEXTURE_2D);
+			MemoryStats::addGpu(MemoryTag::textures, width*height*4 * 4/3);
 			
 			stbi_image_free(data);
 			
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <string>
 
 namespace PixCraft {
 	typedef uint32_t TexId;
@@ -14,6 +15,12 @@ namespace PixCraft {
 		int getTextureWidth(TexId texId);
 		int getTextureHeight(TexId texId);
 		
+		// The ids below, and the files they're loaded from, don't need GL (texture_ids.cpp)
+		unsigned int blockTextureCount();
+		std::string blockTextureName(TexId texId); // under res/block
+		unsigned int otherTextureCount();
+		std::string otherTextureName(TexId texId); // under res
+		
 		const unsigned int BLOCK_TEX_SIZE = 16;
 		
 		// Block textures
@@ -27,6 +34,7 @@ namespace PixCraft {
 		extern const TexId LEAVES;
 		extern const TexId WATER;
 		extern const TexId PLANKS;
+		extern const TexId LAMP;
 		
 		// Other textures
 		extern const TexId SLIME;
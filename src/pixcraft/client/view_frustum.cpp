@@ -2,19 +2,23 @@
 
 #include <cmath>
 
-#include "pixcraft/server/world_module.hpp"
+#if defined(__SSE__) || defined(_M_X64)
+	#include <xmmintrin.h>
+	#define FRUSTUM_SSE
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	#include <arm_neon.h>
+	#define FRUSTUM_NEON
+#endif
+
 #include "pixcraft/util/util.hpp"
 
 using namespace PixCraft;
 
 // Takes a normal and a point in camera space, and returns the corresponding plane in world space.
-// Also computes the n- and p-vertices of AABBs relative to the plane.
 ViewPlane computeViewPlane(glm::vec3 normal, glm::vec3 point, glm::mat4 trans) {
 	glm::vec4 camPlane = glm::vec4(normal, glm::dot(-normal, point));
 	ViewPlane viewPlane;
 	viewPlane.plane = trans * camPlane;
-	viewPlane.nPoint = glm::vec3(CHUNK_SIZE * (viewPlane.plane.x < 0), CHUNK_HEIGHT * (viewPlane.plane.y < 0),
-		CHUNK_SIZE * (viewPlane.plane.z < 0));
 	return viewPlane;
 }
 
@@ -38,22 +42,60 @@ ViewFrustum PixCraft::computeViewFrustum(float fovy, float screenRatio, float ne
 	return vf;
 }
 
-bool PixCraft::isVisible(ViewFrustum& vf, int32_t chunkX, int32_t chunkZ) {
-	glm::vec3 corner(CHUNK_SIZE*chunkX - 0.5, -0.5, CHUNK_SIZE*chunkZ - 0.5);
-	
-	glm::vec3 nPoint;
-	nPoint = corner + vf.left.nPoint;
-	if(glm::dot(glm::vec4(nPoint, 1.0f), vf.left.plane) > 0) return false;
-	nPoint = corner + vf.right.nPoint;
-	if(glm::dot(glm::vec4(nPoint, 1.0f), vf.right.plane) > 0) return false;
-	nPoint = corner + vf.bottom.nPoint;
-	if(glm::dot(glm::vec4(nPoint, 1.0f), vf.bottom.plane) > 0) return false;
-	nPoint = corner + vf.top.nPoint;
-	if(glm::dot(glm::vec4(nPoint, 1.0f), vf.top.plane) > 0) return false;
-	nPoint = corner + vf.far.nPoint;
-	if(glm::dot(glm::vec4(nPoint, 1.0f), vf.far.plane) > 0) return false;
-	nPoint = corner + vf.near.nPoint;
-	if(glm::dot(glm::vec4(nPoint, 1.0f), vf.near.plane) > 0) return false;
-	
-	return true;
-}
\ No newline at end of file
+// The planes' normals point out of the frustum. A box is outside if its n-vertex (the corner farthest
+// along the inward direction) is in front of a plane, and inside if its p-vertex is behind all of them.
+FrustumTest PixCraft::testBox(ViewFrustum& vf, AABB box) {
+	const ViewPlane* planes[6] = { &vf.left, &vf.right, &vf.bottom, &vf.top, &vf.far, &vf.near };
+	FrustumTest result = FrustumTest::inside;
+	for(const ViewPlane* viewPlane : planes) {
+		glm::vec4 plane = viewPlane->plane;
+		glm::vec3 nPoint(plane.x < 0 ? box.max.x : box.min.x, plane.y < 0 ? box.max.y : box.min.y,
+			plane.z < 0 ? box.max.z : box.min.z);
+		if(glm::dot(glm::vec4(nPoint, 1.0f), plane) > 0) return FrustumTest::outside;
+		glm::vec3 pPoint(plane.x < 0 ? box.min.x : box.max.x, plane.y < 0 ? box.min.y : box.max.y,
+			plane.z < 0 ? box.min.z : box.max.z);
+		if(glm::dot(glm::vec4(pPoint, 1.0f), plane) > 0) result = FrustumTest::intersecting;
+	}
+	return result;
+}
+
+uint8_t PixCraft::testBoxes(ViewFrustum& vf, AABB4& boxes) {
+	const ViewPlane* planes[6] = { &vf.left, &vf.right, &vf.bottom, &vf.top, &vf.far, &vf.near };
+	// The choice of n-vertex only depends on the plane, so each plane is tested against the four boxes
+	// with the same vector operations. The sums are done in the same order in every version.
+#if defined(FRUSTUM_SSE)
+	__m128 maxDist = _mm_set1_ps(-INFINITY);
+	for(const ViewPlane* viewPlane : planes) {
+		glm::vec4 plane = viewPlane->plane;
+		__m128 dist = _mm_mul_ps(_mm_set1_ps(plane.x), _mm_loadu_ps(&(plane.x < 0 ? boxes.maxX : boxes.minX).x));
+		dist = _mm_add_ps(dist, _mm_mul_ps(_mm_set1_ps(plane.y), _mm_loadu_ps(&(plane.y < 0 ? boxes.maxY : boxes.minY).x)));
+		dist = _mm_add_ps(dist, _mm_mul_ps(_mm_set1_ps(plane.z), _mm_loadu_ps(&(plane.z < 0 ? boxes.maxZ : boxes.minZ).x)));
+		dist = _mm_add_ps(dist, _mm_set1_ps(plane.w));
+		maxDist = _mm_max_ps(maxDist, dist);
+	}
+	return _mm_movemask_ps(_mm_cmple_ps(maxDist, _mm_setzero_ps()));
+#elif defined(FRUSTUM_NEON)
+	float32x4_t maxDist = vdupq_n_f32(-INFINITY);
+	for(const ViewPlane* viewPlane : planes) {
+		glm::vec4 plane = viewPlane->plane;
+		float32x4_t dist = vmulq_n_f32(vld1q_f32(&(plane.x < 0 ? boxes.maxX : boxes.minX).x), plane.x);
+		dist = vaddq_f32(dist, vmulq_n_f32(vld1q_f32(&(plane.y < 0 ? boxes.maxY : boxes.minY).x), plane.y));
+		dist = vaddq_f32(dist, vmulq_n_f32(vld1q_f32(&(plane.z < 0 ? boxes.maxZ : boxes.minZ).x), plane.z));
+		dist = vaddq_f32(dist, vdupq_n_f32(plane.w));
+		maxDist = vmaxq_f32(maxDist, dist);
+	}
+	const uint32_t laneBits[4] = { 1, 2, 4, 8 };
+	return vaddvq_u32(vandq_u32(vcleq_f32(maxDist, vdupq_n_f32(0.0f)), vld1q_u32(laneBits)));
+#else
+	glm::vec4 maxDist(-INFINITY);
+	for(const ViewPlane* viewPlane : planes) {
+		glm::vec4 plane = viewPlane->plane;
+		glm::vec4 dist = plane.x * (plane.x < 0 ? boxes.maxX : boxes.minX)
+			+ plane.y * (plane.y < 0 ? boxes.maxY : boxes.minY)
+			+ plane.z * (plane.z < 0 ? boxes.maxZ : boxes.minZ)
+			+ plane.w;
+		maxDist = glm::max(maxDist, dist);
+	}
+	return (maxDist.x <= 0) | ((maxDist.y <= 0) << 1) | ((maxDist.z <= 0) << 2) | ((maxDist.w <= 0) << 3);
+#endif
+}
@@ -9,7 +9,6 @@
 namespace PixCraft {
 	struct ViewPlane {
 		glm::vec4 plane;
-		glm::vec3 nPoint;
 	};
 	
 	struct ViewFrustum {
@@ -23,5 +22,20 @@ namespace PixCraft {
 	
 	ViewFrustum computeViewFrustum(float fovy, float screenRatio, float near, float far, glm::vec3 pos, glm::vec3 orient);
 	
-	bool isVisible(ViewFrustum& vf, int32_t chunkX, int32_t chunkZ);
+	struct AABB {
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+	
+	// Four boxes stored component-wise, so that they are tested against each plane at once
+	struct AABB4 {
+		glm::vec4 minX, minY, minZ;
+		glm::vec4 maxX, maxY, maxZ;
+	};
+	
+	enum class FrustumTest { outside, intersecting, inside };
+	
+	FrustumTest testBox(ViewFrustum& vf, AABB box);
+	// Returns a bitmask of the boxes that are at least partly inside the frustum
+	uint8_t testBoxes(ViewFrustum& vf, AABB4& boxes);
 }
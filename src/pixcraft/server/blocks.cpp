@@ -25,20 +25,17 @@ namespace PixCraft::BlockRegistry {
 	
 	const BlockId STONE_ID = registerBlock(new Block());
 	const BlockId DIRT_ID = registerBlock(new Block());
-	const BlockId GRASS_ID = registerBlock(new GrassBlock());
-	const BlockId TRUNK_ID = registerBlock(new TrunkBlock());
+	const BlockId GRASS_ID = registerBlock(new Block());
+	const BlockId TRUNK_ID = registerBlock(new Block());
 	const BlockId LEAVES_ID = registerBlock(new Block());
 	const BlockId WATER_ID = registerBlock(new WaterBlock());
 	const BlockId PLANKS_ID = registerBlock(new Block());
+	const BlockId LAMP_ID = registerBlock(new Block());
 	
 	void defineBlocks() {
-		fromId(STONE_ID).mainTexture(TEX(STONE));
-		fromId(DIRT_ID).mainTexture(TEX(DIRT));
-		fromId(GRASS_ID).define();
-		fromId(TRUNK_ID).define();
-		fromId(LEAVES_ID).mainTexture(TEX(LEAVES)).rendering(BlockRendering::transparentCube);
+		fromId(LEAVES_ID).rendering(BlockRendering::transparentCube).lightOpacity(1);
 		fromId(WATER_ID).define();
-		fromId(PLANKS_ID).mainTexture(TEX(PLANKS));
+		fromId(LAMP_ID).lightEmission(MAX_LIGHT);
 	}
 
 	Block& fromId(BlockId id) {
@@ -52,24 +49,23 @@ namespace PixCraft::BlockRegistry {
 
 
 Block::Block() :
-	_id((BlockId) -1), _rendering(BlockRendering::opaqueCube), _mainTexture(0), _collision(BlockCollision::solidCube) { }
+	_id((BlockId) -1), _rendering(BlockRendering::opaqueCube), _collision(BlockCollision::solidCube),
+	_lightEmission(0), _lightOpacity(0) { }
 
 void Block::define() {}
 
-TexId Block::getFaceTexture(uint8_t face) {
-	return _mainTexture;
-}
-
 bool Block::update(World& world, int32_t x, int32_t y, int32_t z) { return false; }
 
 Block& Block::rendering(BlockRendering rendering) { _rendering = rendering; return *this; }
-Block& Block::mainTexture(TexId texture) { _mainTexture = texture; return *this; }
 Block& Block::collision(BlockCollision collision) { _collision = collision; return *this; }
+Block& Block::lightEmission(uint8_t level) { _lightEmission = level; return *this; }
+Block& Block::lightOpacity(uint8_t opacity) { _lightOpacity = opacity; return *this; }
 
 BlockId Block::id() { return _id; }
 BlockRendering Block::rendering() { return _rendering; }
-TexId Block::mainTexture() { return _mainTexture; }
 BlockCollision Block::collision() { return _collision; }
+uint8_t Block::lightEmission() { return _lightEmission; }
+uint8_t Block::lightOpacity() { return _rendering == BlockRendering::opaqueCube ? MAX_LIGHT : _lightOpacity; }
 
 Block& Block::fromId(BlockId id) {
 	return BlockRegistry::fromId(id);
@@ -78,32 +74,10 @@ Block& Block::fromId(BlockId id) {
 void Block::setId(BlockId id) { _id = id; }
 
 
-void GrassBlock::define() {
-	mainTexture(TEX(GRASS_SIDE));
-}
-
-TexId GrassBlock::getFaceTexture(uint8_t face) {
-	if(face == 4) {
-		return TEX(DIRT);
-	} else if(face == 5) {
-		return TEX(GRASS_TOP);
-	} else {
-		return TEX(GRASS_SIDE);
-	}
-}
-
-void TrunkBlock::define() {
-	mainTexture(TEX(TRUNK_SIDE));
-}
-
-TexId TrunkBlock::getFaceTexture(uint8_t face) {
-	return face >= 4 ? TEX(TRUNK_INSIDE) : TEX(TRUNK_SIDE);
-}
-
 void WaterBlock::define() {
-	mainTexture(TEX(WATER));
 	rendering(BlockRendering::translucentCube);
 	collision(BlockCollision::fluidCube);
+	lightOpacity(2);
 }
 
 bool WaterBlock::update(World& world, int32_t x, int32_t y, int32_t z) {
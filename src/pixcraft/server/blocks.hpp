@@ -4,8 +4,6 @@
 #include <vector>
 #include <memory>
 
-#include "pixcraft/client/textures.hpp"
-
 #include "world_module.hpp"
 
 namespace PixCraft {
@@ -24,6 +22,7 @@ namespace PixCraft {
 		extern const BlockId LEAVES_ID;
 		extern const BlockId WATER_ID;
 		extern const BlockId PLANKS_ID;
+		extern const BlockId LAMP_ID;
 	};
 	
 	enum class BlockRendering {
@@ -42,41 +41,31 @@ namespace PixCraft {
 		virtual ~Block() = default;
 		
 		virtual void define();
-		virtual TexId getFaceTexture(uint8_t face);
 		virtual bool update(World& world, int32_t x, int32_t y, int32_t z);
 		
 		Block& rendering(BlockRendering rendering);
-		Block& mainTexture(TexId texture);
 		Block& collision(BlockCollision collision);
+		Block& lightEmission(uint8_t level);
+		Block& lightOpacity(uint8_t opacity); // light lost when going through the block, besides the usual 1 per block
 		
 		BlockId id();
 		BlockRendering rendering();
-		TexId mainTexture();
 		BlockCollision collision();
+		uint8_t lightEmission();
+		uint8_t lightOpacity(); // opaque cubes always block light
 		
 		static Block& fromId(BlockId id);
 
 	private:
 		BlockId _id;
 		BlockRendering _rendering;
-		TexId _mainTexture;
 		BlockCollision _collision;
+		uint8_t _lightEmission;
+		uint8_t _lightOpacity;
 		
 		void setId(BlockId id);
 	};
 	
-	class GrassBlock : public Block {
-	public:
-		void define() override;
-		TexId getFaceTexture(uint8_t face) override;
-	};
-	
-	class TrunkBlock : public Block {
-	public:
-		void define() override;
-		TexId getFaceTexture(uint8_t face) override;
-	};
-	
 	class WaterBlock : public Block {
 	public:
 		void define() override;
@@ -5,6 +5,7 @@
 
 #include "blocks.hpp"
 #include "world.hpp"
+#include "pixcraft/util/frame_arena.hpp"
 
 using namespace PixCraft;
 
@@ -16,7 +17,7 @@ inline uint8_t xFromIdx(uint32_t idx) { return idx % CHUNK_SIZE; }
 inline uint8_t yFromIdx(uint32_t idx) { return idx / CHUNK_SIZE / CHUNK_SIZE; }
 inline uint8_t zFromIdx(uint32_t idx) { return (idx / CHUNK_SIZE) % CHUNK_SIZE; }
 
-Chunk::Chunk() : world(nullptr), blocks(), opaqueCubeCache() { }
+Chunk::Chunk() : world(nullptr), blocks(), opaqueCubeCache(), light(), sectionBlockCounts() { }
 
 void Chunk::init(World* world2) { world = world2; }
 
@@ -32,8 +33,10 @@ void Chunk::unserialize(const Serializer::Chunk* chunkData) {
 		throw std::runtime_error("Wrong number of blocks in loaded chunk");
 	}
 	std::copy(chunkData->blocks()->begin(), chunkData->blocks()->end(), blocks);
+	std::fill(sectionBlockCounts, sectionBlockCounts + CHUNK_SECTIONS, 0);
 	for(int i = 0; i < CHUNK_BLOCKS; ++i) {
 		opaqueCubeCache[i] = blocks[i] == 0 ? false : Block::fromId(blocks[i]).rendering() == BlockRendering::opaqueCube;
+		if(blocks[i] != 0) sectionBlockCounts[yFromIdx(i) / SECTION_HEIGHT]++;
 	}
 	scheduledUpdates.insert(chunkData->scheduled_updates()->begin(), chunkData->scheduled_updates()->end());
 }
@@ -55,24 +58,29 @@ Block* Chunk::getBlock(uint8_t x, uint8_t y, uint8_t z) {
 
 void Chunk::setBlock(uint8_t x, uint8_t y, uint8_t z, Block& block) {
 	if(INVALID_BLOCK_POS(x, y, z)) throw std::logic_error("Invalid block position in chunk");
-	blocks[blockIdx(x, y, z)] = block.id();
+	storeBlockId(blockIdx(x, y, z), block.id());
 	opaqueCubeCache[blockIdx(x, y, z)] = block.rendering() == BlockRendering::opaqueCube;
 }
 
 void Chunk::removeBlock(uint8_t x, uint8_t y, uint8_t z) {
 	if(INVALID_BLOCK_POS(x, y, z)) throw std::logic_error("Invalid block position in chunk");
-	blocks[blockIdx(x, y, z)] = 0;
+	storeBlockId(blockIdx(x, y, z), 0);
 	opaqueCubeCache[blockIdx(x, y, z)] = false;
 }
 
+bool Chunk::isSectionEmpty(uint8_t section) {
+	return sectionBlockCounts[section] == 0;
+}
+
 void Chunk::requestUpdate(uint8_t x, uint8_t y, uint8_t z) {
 	if(INVALID_BLOCK_POS(x, y, z)) return;
 	scheduledUpdates.insert(blockIdx(x, y, z));
 }
 
 void Chunk::updateBlocks(int32_t chunkX, int32_t chunkZ) {
-	std::unordered_set<uint32_t> updates;
-	scheduledUpdates.swap(updates);
+	// Updates can schedule more updates, which are done in the next frame
+	std::pmr::vector<uint32_t> updates(scheduledUpdates.begin(), scheduledUpdates.end(), &frameArena());
+	scheduledUpdates.clear();
 	for(uint32_t blockIdx : updates) {
 		BlockId id = blocks[blockIdx];
 		if(id != 0) {
@@ -92,7 +100,47 @@ bool Chunk::isOpaqueCube(uint8_t x, uint8_t y, uint8_t z) {
 	return opaqueCubeCache[blockIdx(x, y, z)];
 }
 
+BlockId Chunk::getBlockId(uint8_t x, uint8_t y, uint8_t z) {
+	return blocks[blockIdx(x, y, z)];
+}
+
 void Chunk::setBlockId(uint8_t x, uint8_t y, uint8_t z, BlockId id, bool isOpaqueCube) {
-	blocks[blockIdx(x, y, z)] = id;
+	storeBlockId(blockIdx(x, y, z), id);
 	opaqueCubeCache[blockIdx(x, y, z)] = isOpaqueCube;
 }
+
+uint8_t Chunk::getLight(uint8_t x, uint8_t y, uint8_t z) {
+	return light[blockIdx(x, y, z)];
+}
+
+uint8_t Chunk::getLight(uint8_t x, uint8_t y, uint8_t z, LightChannel channel) {
+	uint8_t packed = light[blockIdx(x, y, z)];
+	return channel == LightChannel::sky ? packed >> 4 : packed & 0xf;
+}
+
+void Chunk::setLight(uint8_t x, uint8_t y, uint8_t z, LightChannel channel, uint8_t level) {
+	uint8_t& packed = light[blockIdx(x, y, z)];
+	if(channel == LightChannel::sky) {
+		packed = (packed & 0xf) | (level << 4);
+	} else {
+		packed = (packed & 0xf0) | level;
+	}
+}
+
+void Chunk::clearLight() {
+	std::fill(light, light + CHUNK_BLOCKS, 0);
+}
+
+void Chunk::storeBlockId(uint32_t idx, BlockId id) {
+	BlockId oldId = blocks[idx];
+	blocks[idx] = id;
+	if(oldId == 0 && id != 0) {
+		sectionBlockCounts[yFromIdx(idx) / SECTION_HEIGHT]++;
+	} else if(oldId != 0 && id == 0) {
+		sectionBlockCounts[yFromIdx(idx) / SECTION_HEIGHT]--;
+	}
+}
+
+void Chunk::reportMemory(MemoryReport& report) {
+	report.addCpu(MemoryTag::blockUpdates, heapBytes(scheduledUpdates));
+}
@@ -6,10 +6,13 @@
 
 #include "world_module.hpp"
 #include "pixcraft/util/serializer_generated.h"
+#include "pixcraft/util/memory_stats.hpp"
 
 namespace PixCraft {
 	#define CHUNK_BLOCKS (CHUNK_SIZE*CHUNK_SIZE*CHUNK_HEIGHT)
 	#define MAX_CHUNK_FACES (CHUNK_BLOCKS*3)
+	#define SECTION_HEIGHT 16
+	#define CHUNK_SECTIONS (CHUNK_HEIGHT/SECTION_HEIGHT)
 	
 	#define INVALID_BLOCK_POS(x, y, z) (x < 0 || x >= CHUNK_SIZE || y < 0 || y >= CHUNK_HEIGHT || z < 0 || z >= CHUNK_SIZE)
 	
@@ -26,18 +29,36 @@ namespace PixCraft {
 		void setBlock(uint8_t x, uint8_t y, uint8_t z, Block& block);
 		void removeBlock(uint8_t x, uint8_t y, uint8_t z);
 		
+		// a section is a 16-block high slice of the chunk, used to skip large empty areas in bulk
+		bool isSectionEmpty(uint8_t section);
+		
 		void requestUpdate(uint8_t x, uint8_t y, uint8_t z);
 		void updateBlocks(int32_t chunkX, int32_t chunkZ);
 		
 		// Fast functions; they do not check for invalid positions, and do not update blocks.
 		bool isOpaqueCube(uint8_t x, uint8_t y, uint8_t z);
+		BlockId getBlockId(uint8_t x, uint8_t y, uint8_t z);
 		void setBlockId(uint8_t x, uint8_t y, uint8_t z, BlockId id, bool isOpaqueCube);
 		
+		// Light levels go from 0 to MAX_LIGHT; both are packed in a byte, with sky light in the high 4 bits.
+		// They are computed by the world's LightEngine, and aren't saved.
+		uint8_t getLight(uint8_t x, uint8_t y, uint8_t z);
+		uint8_t getLight(uint8_t x, uint8_t y, uint8_t z, LightChannel channel);
+		void setLight(uint8_t x, uint8_t y, uint8_t z, LightChannel channel, uint8_t level);
+		void clearLight();
+		
+		// Adds the memory the chunk uses outside of its own storage
+		void reportMemory(MemoryReport& report);
+	
 	private:
 		World* world;
 		
 		BlockId blocks[CHUNK_BLOCKS];
 		bool opaqueCubeCache[CHUNK_BLOCKS];
+		uint8_t light[CHUNK_BLOCKS];
+		uint16_t sectionBlockCounts[CHUNK_SECTIONS];
 		std::unordered_set<uint32_t> scheduledUpdates;
+		
+		void storeBlockId(uint32_t idx, BlockId id);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,223 @@
+#include "light_engine.hpp"
+
+#include "world.hpp"
+#include "chunk.hpp"
+#include "blocks.hpp"
+#include "pixcraft/util/util.hpp"
+#include "pixcraft/util/trace.hpp"
+
+using namespace PixCraft;
+
+namespace {
+	const uint8_t DOWN_SIDE = 4; // index of (0,-1,0) in sideVectors
+	
+	int32_t chunkCoord(int32_t x) {
+		return x >= 0 ? x / CHUNK_SIZE : -((-x - 1) / CHUNK_SIZE) - 1;
+	}
+	
+	// Returns the light level a block receives from a neighbour with the given level, or 0
+	uint8_t spreadLevel(LightChannel channel, uint8_t side, uint8_t level, uint8_t opacity) {
+		if(channel == LightChannel::sky && side == DOWN_SIDE && level == MAX_LIGHT && opacity == 0) return MAX_LIGHT;
+		return opacity + 1 >= level ? 0 : level - 1 - opacity;
+	}
+}
+
+LightEngine::LightEngine(World& world)
+	: world(world), litChunk(nullptr), cachedChunkX(0), cachedChunkZ(0), cachedChunk(nullptr) { }
+
+void LightEngine::lightChunk(int32_t chunkX, int32_t chunkZ) {
+	TRACE_SCOPE("Light chunk");
+	cachedChunk = nullptr; // chunks may have been added or removed since the last search
+	Chunk* chunk = world.findChunk(chunkX, chunkZ);
+	if(chunk == nullptr) return;
+	litChunk = chunk;
+	chunk->clearLight();
+	int32_t baseX = chunkX*CHUNK_SIZE, baseZ = chunkZ*CHUNK_SIZE;
+	
+	// Sky light falls straight down until blocks absorb some of it
+	for(uint8_t relX = 0; relX < CHUNK_SIZE; ++relX) {
+		for(uint8_t relZ = 0; relZ < CHUNK_SIZE; ++relZ) {
+			uint8_t level = MAX_LIGHT;
+			for(int y = CHUNK_HEIGHT - 1; y >= 0 && level > 0; --y) {
+				level = spreadLevel(LightChannel::sky, DOWN_SIDE, level, getOpacity(chunk, relX, y, relZ));
+				chunk->setLight(relX, y, relZ, LightChannel::sky, level);
+			}
+		}
+	}
+	
+	for(LightChannel channel : { LightChannel::sky, LightChannel::block }) {
+		for(uint8_t y = 0; y < CHUNK_HEIGHT; ++y) {
+			for(uint8_t relX = 0; relX < CHUNK_SIZE; ++relX) {
+				for(uint8_t relZ = 0; relZ < CHUNK_SIZE; ++relZ) {
+					if(channel == LightChannel::block) {
+						BlockId id = chunk->getBlockId(relX, y, relZ);
+						if(id == 0 || Block::fromId(id).lightEmission() == 0) continue;
+						chunk->setLight(relX, y, relZ, channel, Block::fromId(id).lightEmission());
+						addQueue.push_back({ baseX + relX, baseZ + relZ, y, 0 });
+						continue;
+					}
+					
+					// Only sky light that can spread sideways needs a search; the columns are already lit
+					uint8_t level = chunk->getLight(relX, y, relZ, channel);
+					if(level <= 1) continue;
+					bool spreads = false;
+					for(uint8_t side = 0; side < 4 && !spreads; ++side) {
+						int nx = relX + sideVectors[side][0], nz = relZ + sideVectors[side][2];
+						spreads = nx < 0 || nx >= CHUNK_SIZE || nz < 0 || nz >= CHUNK_SIZE
+							|| chunk->getLight(nx, y, nz, channel) < level - 1;
+					}
+					if(spreads) addQueue.push_back({ baseX + relX, baseZ + relZ, y, 0 });
+				}
+			}
+		}
+		
+		// Light from the neighbouring chunks comes in through their borders
+		for(uint8_t side = 0; side < 4; ++side) {
+			Chunk* neighbor = world.findChunk(chunkX + sideVectors[side][0], chunkZ + sideVectors[side][2]);
+			if(neighbor == nullptr) continue;
+			for(uint8_t i = 0; i < CHUNK_SIZE; ++i) {
+				// Position of the border block in the neighbouring chunk
+				int relX = sideVectors[side][0] == 0 ? i : (sideVectors[side][0] > 0 ? 0 : CHUNK_SIZE - 1);
+				int relZ = sideVectors[side][2] == 0 ? i : (sideVectors[side][2] > 0 ? 0 : CHUNK_SIZE - 1);
+				int32_t x = baseX + CHUNK_SIZE*sideVectors[side][0] + relX;
+				int32_t z = baseZ + CHUNK_SIZE*sideVectors[side][2] + relZ;
+				for(uint8_t y = 0; y < CHUNK_HEIGHT; ++y) {
+					if(neighbor->getLight(relX, y, relZ, channel) > 1) addQueue.push_back({ x, z, y, 0 });
+				}
+			}
+		}
+		
+		propagate(channel);
+	}
+	litChunk = nullptr;
+}
+
+void LightEngine::blockChanged(int32_t x, int32_t y, int32_t z, uint8_t oldEmission, uint8_t oldOpacity) {
+	if(!World::isValidHeight(y)) return;
+	cachedChunk = nullptr;
+	uint8_t relX, relZ;
+	Chunk* chunk = findChunk(x, z, relX, relZ);
+	if(chunk == nullptr) return;
+	BlockId id = chunk->getBlockId(relX, y, relZ);
+	uint8_t opacity = getOpacity(chunk, relX, y, relZ);
+	
+	for(LightChannel channel : { LightChannel::sky, LightChannel::block }) {
+		uint8_t emission = 0, previousEmission = 0;
+		if(channel == LightChannel::block) {
+			emission = id == 0 ? 0 : Block::fromId(id).lightEmission();
+			previousEmission = oldEmission;
+		}
+		
+		// Remove the light that came from or through the block; the neighbours that don't depend on it fill the gap back
+		uint8_t level = chunk->getLight(relX, y, relZ, channel);
+		if(level > 0 && (opacity > oldOpacity || emission < previousEmission)) {
+			setLight(chunk, x, y, z, channel, 0);
+			removeQueue.push_back({ x, z, (uint8_t) y, level });
+			unpropagate(channel);
+		}
+		
+		if(emission > chunk->getLight(relX, y, relZ, channel)) {
+			setLight(chunk, x, y, z, channel, emission);
+			addQueue.push_back({ x, z, (uint8_t) y, 0 });
+		}
+		// A more transparent block lets the light of its neighbours in
+		if(opacity < oldOpacity) {
+			for(uint8_t side = 0; side < 6; ++side) {
+				int32_t y2 = y + sideVectors[side][1];
+				if(World::isValidHeight(y2))
+					addQueue.push_back({ x + sideVectors[side][0], z + sideVectors[side][2], (uint8_t) y2, 0 });
+			}
+		}
+		propagate(channel);
+	}
+}
+
+void LightEngine::reportMemory(MemoryReport& report) {
+	report.addCpu(MemoryTag::lighting, heapBytes(addQueue) + heapBytes(removeQueue));
+}
+
+Chunk* LightEngine::findChunk(int32_t x, int32_t z, uint8_t& relX, uint8_t& relZ) {
+	int32_t chunkX = chunkCoord(x), chunkZ = chunkCoord(z);
+	if(cachedChunk == nullptr || chunkX != cachedChunkX || chunkZ != cachedChunkZ) {
+		Chunk* chunk = world.findChunk(chunkX, chunkZ);
+		if(chunk == nullptr) return nullptr;
+		cachedChunk = chunk;
+		cachedChunkX = chunkX; cachedChunkZ = chunkZ;
+	}
+	relX = x - chunkX*CHUNK_SIZE;
+	relZ = z - chunkZ*CHUNK_SIZE;
+	return cachedChunk;
+}
+
+uint8_t LightEngine::getOpacity(Chunk* chunk, uint8_t relX, uint8_t y, uint8_t relZ) {
+	BlockId id = chunk->getBlockId(relX, y, relZ);
+	if(id == 0) return 0;
+	if(chunk->isOpaqueCube(relX, y, relZ)) return MAX_LIGHT;
+	return Block::fromId(id).lightOpacity();
+}
+
+void LightEngine::setLight(Chunk* chunk, int32_t x, uint8_t y, int32_t z, LightChannel channel, uint8_t level) {
+	chunk->setLight(x - chunkCoord(x)*CHUNK_SIZE, y, z - chunkCoord(z)*CHUNK_SIZE, channel, level);
+	if(chunk != litChunk) world.markDirty(x, y, z);
+}
+
+void LightEngine::propagate(LightChannel channel) {
+	for(size_t head = 0; head < addQueue.size(); ++head) {
+		LightNode node = addQueue[head];
+		uint8_t relX, relZ;
+		Chunk* chunk = findChunk(node.x, node.z, relX, relZ);
+		if(chunk == nullptr) continue;
+		uint8_t level = chunk->getLight(relX, node.y, relZ, channel);
+		if(level <= 1) continue;
+		
+		for(uint8_t side = 0; side < 6; ++side) {
+			int32_t x = node.x + sideVectors[side][0];
+			int32_t y = node.y + sideVectors[side][1];
+			int32_t z = node.z + sideVectors[side][2];
+			if(!World::isValidHeight(y)) continue;
+			Chunk* neighbor = findChunk(x, z, relX, relZ);
+			if(neighbor == nullptr) continue; // light doesn't go into unloaded chunks
+			uint8_t newLevel = spreadLevel(channel, side, level, getOpacity(neighbor, relX, y, relZ));
+			if(neighbor->getLight(relX, y, relZ, channel) >= newLevel) continue;
+			setLight(neighbor, x, y, z, channel, newLevel);
+			addQueue.push_back({ x, z, (uint8_t) y, 0 });
+		}
+	}
+	addQueue.clear();
+}
+
+void LightEngine::unpropagate(LightChannel channel) {
+	for(size_t head = 0; head < removeQueue.size(); ++head) {
+		LightNode node = removeQueue[head];
+		for(uint8_t side = 0; side < 6; ++side) {
+			int32_t x = node.x + sideVectors[side][0];
+			int32_t y = node.y + sideVectors[side][1];
+			int32_t z = node.z + sideVectors[side][2];
+			if(!World::isValidHeight(y)) continue;
+			uint8_t relX, relZ;
+			Chunk* neighbor = findChunk(x, z, relX, relZ);
+			if(neighbor == nullptr) continue;
+			uint8_t level = neighbor->getLight(relX, y, relZ, channel);
+			if(level == 0) continue;
+			
+			bool dependent = level < node.level
+				|| (channel == LightChannel::sky && side == DOWN_SIDE && node.level == MAX_LIGHT && level == MAX_LIGHT);
+			if(!dependent) {
+				// This light comes from elsewhere, and will spread back into the removed area
+				addQueue.push_back({ x, z, (uint8_t) y, 0 });
+				continue;
+			}
+			setLight(neighbor, x, y, z, channel, 0);
+			removeQueue.push_back({ x, z, (uint8_t) y, level });
+			if(channel == LightChannel::block) {
+				BlockId id = neighbor->getBlockId(relX, y, relZ);
+				uint8_t emission = id == 0 ? 0 : Block::fromId(id).lightEmission();
+				if(emission > 0) {
+					setLight(neighbor, x, y, z, channel, emission);
+					addQueue.push_back({ x, z, (uint8_t) y, 0 });
+				}
+			}
+		}
+	}
+	removeQueue.clear();
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "world_module.hpp"
+#include "pixcraft/util/memory_stats.hpp"
+
+namespace PixCraft {
+	// Spreads sky light and block light through the world with breadth-first searches.
+	// Light loses 1 level per block, plus the opacity of the blocks it enters; full sky light goes down for free.
+	// Changed blocks are marked dirty in the world, so that their neighbours' faces are remeshed.
+	class LightEngine {
+	public:
+		LightEngine(World& world);
+		
+		// Lights a newly generated or loaded chunk, and spreads light between it and its loaded neighbours
+		void lightChunk(int32_t chunkX, int32_t chunkZ);
+		// Relights around a block that changed, given the light properties of the previous block;
+		// only the blocks whose light depended on it are visited.
+		void blockChanged(int32_t x, int32_t y, int32_t z, uint8_t oldEmission, uint8_t oldOpacity);
+		
+		void reportMemory(MemoryReport& report);
+	
+	private:
+		struct LightNode {
+			int32_t x, z;
+			uint8_t y;
+			uint8_t level; // level before removal, for removal nodes
+		};
+		
+		World& world;
+		std::vector<LightNode> addQueue;
+		std::vector<LightNode> removeQueue;
+		
+		// The chunk being lit from scratch, which is remeshed as a whole and needs no dirty blocks
+		Chunk* litChunk;
+		// Last chunk looked up, since searches mostly stay in one chunk
+		int32_t cachedChunkX, cachedChunkZ;
+		Chunk* cachedChunk;
+		
+		Chunk* findChunk(int32_t x, int32_t z, uint8_t& relX, uint8_t& relZ);
+		uint8_t getOpacity(Chunk* chunk, uint8_t relX, uint8_t y, uint8_t relZ);
+		void setLight(Chunk* chunk, int32_t x, uint8_t y, int32_t z, LightChannel channel, uint8_t level);
+		
+		void propagate(LightChannel channel);
+		void unpropagate(LightChannel channel);
+	};
+}
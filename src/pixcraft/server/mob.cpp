@@ -1,6 +1,7 @@
 #include "mob.hpp"
 
 #include <algorithm>
+#include <limits>
 #include <stdexcept>
 
 #include "pixcraft/util/util.hpp"
@@ -13,11 +14,13 @@
 using namespace PixCraft;
 
 const float BUOYANCY = 20.0f;
+const int TICKS_BEFORE_SLEEP = 10;
 
 
 glm::vec3 Mob::pos() { return _pos; }
-void Mob::pos(glm::vec3 pos) { _pos = pos; }
+void Mob::pos(glm::vec3 pos) { _pos = pos; wake(); }
 glm::vec3 Mob::speed() { return _speed; }
+void Mob::speed(glm::vec3 speed) { _speed = speed; }
 
 glm::vec3 Mob::orient() { return _orient; }
 void Mob::orient(glm::vec3 orient) { _orient = orient; }
@@ -37,37 +40,119 @@ std::pair<glm::vec3, glm::vec3> Mob::getBoundingBox() {
 	return std::pair<glm::vec3, glm::vec3>(_pos - hor, _pos + hor + ver);
 }
 
+glm::vec3 Mob::getCenter() {
+	return _pos + glm::vec3(0, height/2, 0);
+}
+
 bool Mob::isInsideBlock(int32_t x, int32_t y, int32_t z) {
 	return cylinderBlockCollision(_pos, radius, height, x, y, z);
 }
 
 float Mob::getWaterHeight() {
+	refreshEnvironment();
+	if(waterTop == -std::numeric_limits<float>::infinity()) return 0;
+	return waterTop - _pos.y;
+}
+
+float Mob::getGroundDistance() {
+	refreshEnvironment();
+	return _pos.y - groundTop;
+}
+
+bool Mob::touchesGround() {
+	return getGroundDistance() <= 0.01f;
+}
+
+float Mob::getCeilingDistance() {
+	refreshEnvironment();
+	return ceilingBottom - (_pos.y + height);
+}
+
+BlockId Mob::getNearbyBlockId(int32_t x, int32_t y, int32_t z) {
+	refreshEnvironment();
+	int32_t sizeX = envMaxX - envMinX + 1;
+	int32_t sizeZ = envMaxZ - envMinZ + 1;
+	int32_t minY = envMinY - 1;
+	int32_t maxY = envMaxY + CEILING_SCAN;
+	if(x < envMinX || x > envMaxX || y < minY || y > maxY || z < envMinZ || z > envMaxZ) {
+		Block* block = world.getBlock(x, y, z);
+		return block == nullptr ? 0 : block->id();
+	}
+	return envBlocks[(x - envMinX) + sizeX*(z - envMinZ) + sizeX*sizeZ*(y - minY)];
+}
+
+void Mob::refreshEnvironment() {
 	glm::vec3 c1, c2;
 	std::tie(c1, c2) = getBoundingBox();
 	int minX, minY, minZ;
 	std::tie(minX, minY, minZ) = getBlockCoordsAt(c1);
 	int maxX, maxY, maxZ;
 	std::tie(maxX, maxY, maxZ) = getBlockCoordsAt(c2);
-	int waterLevel = 0;
-	for(int32_t y = minY; y <= maxY; ++y) {
-		for(int32_t x = minX; x <= maxX; ++x) {
-			for(int32_t z = minZ; z <= maxZ; ++z) {
-				Block* block = world.getBlock(x, y, z);
-				if(block == &Block::fromId(BlockRegistry::WATER_ID)) {
-					waterLevel = y;
-					break;
-				}
-			}
-			if(waterLevel == y) {
-				break;
+	if(envValid && minX == envMinX && minY == envMinY && minZ == envMinZ
+			&& maxX == envMaxX && maxY == envMaxY && maxZ == envMaxZ)
+		return;
+	
+	envValid = true;
+	envMinX = minX; envMinY = minY; envMinZ = minZ;
+	envMaxX = maxX; envMaxY = maxY; envMaxZ = maxZ;
+	
+	// One row under the feet for the ground, the bounding box itself, and a few rows above for the ceiling
+	int32_t sizeX = maxX - minX + 1;
+	int32_t sizeZ = maxZ - minZ + 1;
+	int32_t sizeY = (maxY - minY + 1) + 1 + CEILING_SCAN;
+	if(sizeX*sizeY*sizeZ > ENV_MAX_BLOCKS)
+		throw std::logic_error("Mob is too large for its environment cache");
+	world.fetchBlockIds(minX, minY - 1, minZ, sizeX, sizeY, sizeZ, envBlocks);
+	
+	// Without a ground or a ceiling, they're placed at the end of the rows that were fetched
+	waterTop = -std::numeric_limits<float>::infinity();
+	groundTop = minY - 1.5f;
+	ceilingBottom = maxY + CEILING_SCAN + 0.5f;
+	bool ceilingFound = false;
+	for(int32_t dy = 0; dy < sizeY; ++dy) {
+		int32_t y = minY - 1 + dy;
+		for(int32_t i = 0; i < sizeX*sizeZ; ++i) {
+			BlockId id = envBlocks[i + sizeX*sizeZ*dy];
+			if(id == 0) continue;
+			Block& block = Block::fromId(id);
+			if(y <= minY && block.collision() == BlockCollision::solidCube)
+				groundTop = y + 0.5f;
+			if(y >= minY && y <= maxY && id == BlockRegistry::WATER_ID)
+				waterTop = y + 0.5f;
+			if(y >= maxY && !ceilingFound && block.collision() == BlockCollision::solidCube) {
+				ceilingBottom = y - 0.5f;
+				ceilingFound = true;
 			}
 		}
 	}
-	if(waterLevel == 0) return 0;
-	return waterLevel + 0.5 - _pos.y;
+}
+
+bool Mob::isSleeping() { return sleeping; }
+
+void Mob::wake() {
+	sleeping = false;
+	restTicks = 0;
+}
+
+void Mob::environmentChanged() {
+	envValid = false;
+	wake();
+}
+
+float Mob::sightRange() { return 0; }
+
+void Mob::seeTarget(bool visible, glm::vec3 target) {
+	targetVisible = visible;
+	targetPos = target;
 }
 
 void Mob::update(float dt) {
+	if(sleeping) {
+		// any intent or push shows up as a non-zero speed
+		if(_speed == glm::vec3(0.0f)) return;
+		wake();
+	}
+	
 	if(!canFly) {
 		if(getWaterHeight() > 0) {
 			_speed.y -= dt*(GRAVITY - BUOYANCY);
@@ -82,7 +167,9 @@ void Mob::update(float dt) {
 		float verBarrier = std::max(std::min(std::abs(_speed.y)/30, 0.5f), 0.05f);
 		float margin = 0.001;
 		
-		if(dpos.y < 0) {
+		// The disk only collides with the block row it ends up in, which is free as long as it stays above
+		// the cached ground or below the cached ceiling; the world is only queried when it reaches them
+		if(dpos.y < 0 && -dpos.y >= getGroundDistance()) {
 			glm::vec3 feetPos = _pos + glm::vec3(0, dpos.y, 0);
 			float verDispl = world.collideDiskVer(feetPos, radius, verBarrier, margin);
 			if(verDispl > 0) {
@@ -90,7 +177,7 @@ void Mob::update(float dt) {
 				_speed.y = 0.0;
 				onGround = true;
 			}
-		} else if(dpos.y > 0) {
+		} else if(dpos.y > 0 && dpos.y >= getCeilingDistance()) {
 			glm::vec3 headPos = _pos + glm::vec3(0, dpos.y + height, 0);
 			float verDispl = world.collideDiskVer(headPos, radius, verBarrier, margin);
 			if(verDispl < 0) {
@@ -106,6 +193,20 @@ void Mob::update(float dt) {
 	}
 	
 	_pos += dpos;
+	
+	if(_speed == glm::vec3(0.0f) && touchesGround()) {
+		if(++restTicks >= TICKS_BEFORE_SLEEP) sleeping = true;
+	} else {
+		restTicks = 0;
+	}
+}
+
+void Mob::tick(float dt, bool due) {
+	pendingDt += dt;
+	if(due) {
+		update(pendingDt);
+		pendingDt = 0;
+	}
 }
 
 std::unique_ptr<Mob> Mob::unserialize(World& world, const void* mobData, uint8_t mobType) {
@@ -121,7 +222,8 @@ std::unique_ptr<Mob> Mob::unserialize(World& world, const void* mobData, uint8_t
 
 Mob::Mob(World& world, float height, float radius, bool canFly, bool collidesWithBlocks, glm::vec3 pos, glm::vec3 orient)
 	: world(world), height(height), radius(radius), canFly(canFly), collidesWithBlocks(collidesWithBlocks), onGround(false),
-	  _pos(pos), _orient(orient), _speed(0.0) {}
+	  sleeping(false), restTicks(0), pendingDt(0), _pos(pos), _orient(orient), _speed(0.0),
+	  targetVisible(false), targetPos(0.0), envValid(false) {}
 
 flatbuffers::Offset<Serializer::MobBase> Mob::serializeMobBase(flatbuffers::FlatBufferBuilder& builder) {
 	auto pos = Serializer::Vec3(_pos.x, _pos.y, _pos.z);
@@ -13,9 +13,13 @@ namespace PixCraft {
 	
 	class Mob {
 	public:
+		// how many blocks above the head are looked at to find the ceiling
+		static constexpr int CEILING_SCAN = 3;
+		
 		glm::vec3 pos();
 		void pos(glm::vec3 pos);
 		glm::vec3 speed();
+		void speed(glm::vec3 speed);
 		
 		glm::vec3 orient();
 		void orient(glm::vec3 orient);
@@ -24,10 +28,30 @@ namespace PixCraft {
 		glm::vec3 dirVector();
 		
 		std::pair<glm::vec3, glm::vec3> getBoundingBox();
+		glm::vec3 getCenter(); // of the bounding box
 		bool isInsideBlock(int32_t x, int32_t y, int32_t z);
-		float getWaterHeight();
+		
+		// Environment queries; they read from a small copy of the blocks around the mob,
+		// which is only fetched again when the mob crosses a block boundary or environmentChanged() is called.
+		float getWaterHeight(); // how deep the feet are under water, 0 if not in water
+		float getGroundDistance(); // free space under the feet, looked for down to the row under them
+		bool touchesGround();
+		float getCeilingDistance(); // free space above the head, at most CEILING_SCAN
+		BlockId getNearbyBlockId(int32_t x, int32_t y, int32_t z);
+		
+		// Resting mobs fall asleep and skip physics until their speed changes or wake() is called
+		bool isSleeping();
+		void wake();
+		void environmentChanged();
+		
+		// How far the mob looks for players, 0 if it doesn't; before each update, the world tells it
+		// whether it sees the nearest player in range, and where
+		virtual float sightRange();
+		void seeTarget(bool visible, glm::vec3 target);
 		
 		virtual void update(float dt);
+		// Accumulates dt, and only runs update() with the accumulated time when due is true
+		void tick(float dt, bool due);
 		
 		virtual flatbuffers::Offset<void> serialize(flatbuffers::FlatBufferBuilder& builder) = 0;
 		virtual uint8_t serializedType() = 0;
@@ -43,13 +67,30 @@ namespace PixCraft {
 		bool canFly;
 		bool collidesWithBlocks;
 		bool onGround;
+		bool sleeping;
+		int restTicks;
+		float pendingDt;
 		glm::vec3 _pos;
 		glm::vec3 _orient;
 		glm::vec3 _speed;
+		bool targetVisible;
+		glm::vec3 targetPos;
 		
 		Mob(World& world, float height, float radius, bool canFly, bool collidesWithBlocks, glm::vec3 pos, glm::vec3 orient);
 		
 		flatbuffers::Offset<Serializer::MobBase> serializeMobBase(flatbuffers::FlatBufferBuilder& builder);
 		void unserializeMobBase(const Serializer::MobBase* mobBase);
+		
+	private:
+		// radius < 0.5 and height < 2, so the bounding box spans at most 2×3×2 blocks
+		static const int ENV_MAX_BLOCKS = 2*2*(1 + 3 + CEILING_SCAN);
+		
+		bool envValid;
+		int32_t envMinX, envMinY, envMinZ; // the block box the environment was fetched for
+		int32_t envMaxX, envMaxY, envMaxZ;
+		BlockId envBlocks[ENV_MAX_BLOCKS];
+		float waterTop, groundTop, ceilingBottom;
+		
+		void refreshEnvironment();
 	};
 }
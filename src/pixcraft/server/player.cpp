@@ -38,12 +38,11 @@ glm::vec3 Player::eyePos() { return _pos + glm::vec3(0, EYE_HEIGHT, 0); }
 bool Player::isEyeUnderwater() {
 	int32_t x, y, z;
 	std::tie(x, y, z) = getBlockCoordsAt(eyePos());
-	Block* block = world.getBlock(x, y, z);
-	return block == &Block::fromId(BlockRegistry::WATER_ID);
+	return getNearbyBlockId(x, y, z) == BlockRegistry::WATER_ID;
 }
 
-std::tuple<bool, int,int,int> Player::castRay(float maxDist, bool offset, bool hitFluids) {
-	return world.raycast(eyePos(), dirVector(), maxDist, offset, hitFluids);
+RaycastHit Player::castRay(float maxDist, bool hitFluids) {
+	return world.raycast(eyePos(), dirVector(), maxDist, hitFluids);
 }
 
 
@@ -7,6 +7,7 @@
 
 #include "world_module.hpp"
 #include "mob.hpp"
+#include "world.hpp"
 #include "pixcraft/util/serializer_generated.h"
 
 namespace PixCraft {
@@ -20,7 +21,7 @@ namespace PixCraft {
 		
 		glm::vec3 eyePos();
 		bool isEyeUnderwater();
-		std::tuple<bool, int,int,int> castRay(float maxDist, bool offset, bool hitFluids);
+		RaycastHit castRay(float maxDist, bool hitFluids);
 		
 		MovementMode movementMode();
 		void movementMode(MovementMode mode);
@@ -13,12 +13,18 @@ const float HEIGHT = 0.6;
 const float RADIUS = HEIGHT / sqrt(TAU / 2);
 
 const float SPEED = 3.0f;
+const float SIGHT_RANGE = 16.0f;
 
 Slime::Slime(World& world, glm::vec3 pos)
 	: Mob(world, HEIGHT, RADIUS, false, true, pos, glm::vec3(0.0)) {}
 
+float Slime::sightRange() { return SIGHT_RANGE; }
+
 void Slime::update(float dt) {
 	if(onGround) {
+		// Jump towards the player it sees; forward is -z, turned by orient.y
+		if(targetVisible && (targetPos.x != _pos.x || targetPos.z != _pos.z))
+			_orient.y = std::atan2(_pos.x - targetPos.x, _pos.z - targetPos.z);
 		_speed.y = JUMP_SPEED;
 	} else {
 		glm::mat4 yRot = glm::rotate(glm::mat4(1.0f), _orient.y, glm::vec3(0.0f, 1.0f, 0.0f));
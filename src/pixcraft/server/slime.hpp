@@ -10,6 +10,7 @@ namespace PixCraft {
 	public:
 		Slime(World& world, glm::vec3 pos);
 		
+		float sightRange() override;
 		void update(float dt) override;
 		
 		flatbuffers::Offset<void> serialize(flatbuffers::FlatBufferBuilder& builder) override;
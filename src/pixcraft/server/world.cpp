@@ -1,21 +1,60 @@
 #include "world.hpp"
 
 #include <cmath>
+#include <algorithm>
+#include <limits>
 #include <fstream>
 #include <iostream>
 #include <stdexcept>
+#include <memory>
+#include <filesystem>
 
 #include "blocks.hpp"
 #include "mob.hpp"
 #include "player.hpp"
 
 #include "pixcraft/util/serializer_generated.h"
+#include "pixcraft/util/trace.hpp"
+#include "pixcraft/util/random.hpp"
+#include "pixcraft/util/frame_arena.hpp"
 
 using namespace PixCraft;
 
-World::World() { }
+// Distances from the nearest player past which mobs are simulated at a reduced rate
+const float HALF_RATE_DIST = 32.0f;
+const float QUARTER_RATE_DIST = 64.0f;
+
+namespace {
+	// Writes to a temporary file first, then replaces the world file with it,
+	// so that a crash while writing doesn't leave a broken world behind
+	void writeWorldFile(std::string path, flatbuffers::DetachedBuffer& buffer) {
+		std::string tempPath = path + ".tmp";
+		std::ofstream file(tempPath.c_str(), std::ios::binary);
+		file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+		file.close();
+		std::error_code error;
+		if(file.fail()) {
+			std::filesystem::remove(tempPath, error);
+			std::cerr << "Can't write world file " << tempPath << std::endl;
+			return;
+		}
+		std::filesystem::rename(tempPath, path, error);
+		if(error) std::cerr << "Can't replace world file " << path << ": " << error.message() << std::endl;
+	}
+}
 
-void World::saveToFile(std::string path) {
+World::World() : World(generateSeed()) { }
+World::World(uint64_t seed)
+	: gen(seed), scheduledUpdates(&updatePool), lighting(*this), dirtyBlocks(&updatePool), dirtyChunks(&updatePool), entityTicks(0) { }
+
+uint64_t World::seed() { return gen.seed(); }
+
+World::~World() {
+	Jobs::cancel(generationJobs);
+	Jobs::wait(saveJobs);
+}
+
+flatbuffers::DetachedBuffer World::serialize() {
 	flatbuffers::FlatBufferBuilder builder;
 	
 	std::vector<flatbuffers::Offset<Serializer::Chunk>> chunkOffsets;
@@ -37,13 +76,31 @@ void World::saveToFile(std::string path) {
 	auto world = Serializer::CreateWorld(builder, chunkVector, mobTypeVector, mobVector, gen.seed());
 	
 	builder.Finish(world);
-	std::ofstream file(path.c_str(), std::ios::binary);
-	uint8_t* buf = builder.GetBufferPointer();
-	file.write(reinterpret_cast<const char*>(buf), builder.GetSize());
-	file.close();
+	return builder.Release();
+}
+
+void World::saveToFile(std::string path) {
+	TRACE_SCOPE("Save world");
+	Jobs::wait(saveJobs); // an older snapshot must not be written over this one
+	flatbuffers::DetachedBuffer buffer = serialize();
+	writeWorldFile(path, buffer);
+}
+
+void World::saveToFileInBackground(std::string path) {
+	TRACE_SCOPE("Save world");
+	// Writes are done one at a time and in order; the previous one is usually long done
+	Jobs::wait(saveJobs);
+	// std::function needs a copyable buffer
+	std::shared_ptr<flatbuffers::DetachedBuffer> buffer = std::make_shared<flatbuffers::DetachedBuffer>(serialize());
+	Jobs::submit([path, buffer]() {
+		TRACE_SCOPE("Write world");
+		writeWorldFile(path, *buffer);
+	}, JobPriority::low, &saveJobs);
 }
 
 Player* World::loadFromFile(std::string path) {
+	TRACE_SCOPE("Load world");
+	Jobs::wait(saveJobs); // the file may still be being written
 	std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
 	std::ifstream::pos_type size = file.tellg();
 	file.seekg(0, std::ios::beg);
@@ -55,6 +112,9 @@ Player* World::loadFromFile(std::string path) {
 	
 	auto world = Serializer::GetWorld(buffer.data());
 	
+	// The chunks being generated are from the old seed
+	Jobs::cancel(generationJobs);
+	requestedChunks.clear();
 	loadedChunks.clear();
 	scheduledUpdates.clear();
 	dirtyBlocks.clear();
@@ -77,6 +137,12 @@ Player* World::loadFromFile(std::string path) {
 			scheduledUpdates.insert(key);
 		}
 	}
+	for(auto& pair : loadedChunks) {
+		int32_t chunkX, chunkZ;
+		std::tie(chunkX, chunkZ) = unpackCoords(pair.first);
+		lighting.lightChunk(chunkX, chunkZ);
+	}
+	dirtyBlocks.clear(); // the chunks are all rendered from scratch
 	
 	auto mobsData = world->mobs();
 	auto mobsType = world->mobs_type();
@@ -97,6 +163,18 @@ Player* World::loadFromFile(std::string path) {
 	return player;
 }
 
+void World::reportMemory(MemoryReport& report) {
+	// Chunks being generated are counted with their full size
+	report.addCpu(MemoryTag::chunks, heapBytes(loadedChunks) + heapBytes(requestedChunks) + requestedChunks.size() * sizeof(Chunk));
+	for(auto& pair : loadedChunks) {
+		pair.second.reportMemory(report);
+	}
+	report.addCpu(MemoryTag::blockUpdates, heapBytes(scheduledUpdates) + heapBytes(dirtyBlocks) + heapBytes(dirtyChunks));
+	lighting.reportMemory(report);
+	// Mobs are counted with the size of the base class, their subclasses add little
+	report.addCpu(MemoryTag::entities, heapBytes(mobs) + mobs.size() * sizeof(Mob));
+}
+
 bool World::isValidHeight(int32_t y) {
 	return 0 <= y && y < CHUNK_HEIGHT;
 }
@@ -117,20 +195,67 @@ bool World::isChunkLoaded(int32_t x, int32_t z) {
 	return loadedChunks.count(packCoords(x, z)) == 1;
 }
 
+size_t World::loadedChunkCount() {
+	return loadedChunks.size();
+}
+
 Chunk& World::getChunk(int32_t x, int32_t z) {
 	return loadedChunks.at(packCoords(x, z));
 }
 
+Chunk* World::findChunk(int32_t x, int32_t z) {
+	auto iter = loadedChunks.find(packCoords(x, z));
+	return iter == loadedChunks.end() ? nullptr : &iter->second;
+}
+
 Chunk& World::genChunk(int32_t x, int32_t z) {
 	uint64_t key = packCoords(x, z);
 	loadedChunks.erase(key);
 	Chunk& chunk = loadedChunks[key];
 	chunk.init(this);
 	gen.generateChunk(chunk, x, z);
-	dirtyChunks.insert(key);
+	chunkAdded(x, z);
 	return chunk;
 }
 
+void World::requestChunk(int32_t x, int32_t z) {
+	uint64_t key = packCoords(x, z);
+	if(isChunkLoaded(x, z) || !requestedChunks.insert(key).second) return;
+	std::shared_ptr<Chunk> chunk = std::make_shared<Chunk>();
+	Jobs::submit([this, chunk, x, z]() {
+		gen.generateChunk(*chunk, x, z);
+	}, [this, chunk, key, x, z]() {
+		requestedChunks.erase(key);
+		// It may have been generated by genChunk meanwhile
+		if(!loadedChunks.emplace(key, std::move(*chunk)).second) return;
+		loadedChunks[key].init(this);
+		chunkAdded(x, z);
+	}, JobPriority::high, &generationJobs);
+}
+
+bool World::isChunkRequested(int32_t x, int32_t z) {
+	return requestedChunks.count(packCoords(x, z)) == 1;
+}
+
+size_t World::requestedChunkCount() {
+	return requestedChunks.size();
+}
+
+void World::chunkAdded(int32_t x, int32_t z) {
+	uint64_t key = packCoords(x, z);
+	lighting.lightChunk(x, z);
+	dirtyChunks.insert(key);
+	// The environment of a mob covers the blocks under its bounding box, which can reach across a chunk border
+	int32_t minX = x*CHUNK_SIZE, minZ = z*CHUNK_SIZE;
+	for(auto it = mobs.begin(); it != mobs.end(); ++it) {
+		glm::vec3 c1, c2;
+		std::tie(c1, c2) = (*it)->getBoundingBox();
+		if(getBlockCoordAt(c2.x) >= minX && getBlockCoordAt(c1.x) < minX + CHUNK_SIZE
+				&& getBlockCoordAt(c2.z) >= minZ && getBlockCoordAt(c1.z) < minZ + CHUNK_SIZE)
+			(*it)->environmentChanged();
+	}
+}
+
 std::tuple<Chunk*, uint8_t, uint8_t> World::getBlockFromChunk(int32_t x, int32_t z) {
 	int chunkX, chunkZ;
 	std::tie(chunkX, chunkZ) = getChunkPosAt(x, z);
@@ -149,8 +274,9 @@ void World::markDirty(int32_t x, int32_t y, int32_t z) {
 }
 
 BlockPosSet World::retrieveDirtyBlocks() {
-	BlockPosSet res;
-	res.swap(dirtyBlocks);
+	BlockPosSet res(dirtyBlocks.begin(), dirtyBlocks.end(), dirtyBlocks.size(), BlockPosHash(), std::equal_to<BlockPos>(), &frameArena());
+	// Clearing keeps the buckets, so only clear if needed
+	if(!dirtyBlocks.empty()) dirtyBlocks.clear();
 	return res;
 }
 
@@ -158,9 +284,9 @@ void World::markChunkDirty(int32_t chunkX, int32_t chunkZ) {
 	dirtyChunks.insert(packCoords(chunkX, chunkZ));
 }
 
-std::unordered_set<uint64_t> World::retrieveDirtyChunks() {
-	std::unordered_set<uint64_t> res;
-	res.swap(dirtyChunks);
+ChunkIdxSet World::retrieveDirtyChunks() {
+	ChunkIdxSet res(dirtyChunks.begin(), dirtyChunks.end(), dirtyChunks.size(), std::hash<uint64_t>(), std::equal_to<uint64_t>(), &frameArena());
+	if(!dirtyChunks.empty()) dirtyChunks.clear();
 	return res;
 }
 
@@ -181,8 +307,11 @@ void World::requestUpdatesAround(int32_t x, int32_t y, int32_t z) {
 }
 
 void World::updateBlocks() {
-	std::unordered_set<uint64_t> updates;
-	scheduledUpdates.swap(updates);
+	TRACE_SCOPE("Block updates");
+	// Updates can schedule more updates, which are done in the next frame
+	std::pmr::vector<uint64_t> updates(scheduledUpdates.begin(), scheduledUpdates.end(), &frameArena());
+	if(!scheduledUpdates.empty()) scheduledUpdates.clear();
+	TRACE_COUNTER("Updated chunks", updates.size());
 	for(uint64_t chunkIdx : updates) {
 		int32_t chunkX, chunkZ;
 		std::tie(chunkX, chunkZ) = unpackCoords(chunkIdx);
@@ -212,10 +341,15 @@ void World::setBlock(int32_t x, int32_t y, int32_t z, Block& block) {
 	Chunk* chunk; int relX, relZ;
 	std::tie(chunk, relX, relZ) = getBlockFromChunk(x, z);
 	if(chunk == nullptr) return;
+	Block* oldBlock = chunk->getBlock(relX, y, relZ);
+	uint8_t oldEmission = oldBlock == nullptr ? 0 : oldBlock->lightEmission();
+	uint8_t oldOpacity = oldBlock == nullptr ? 0 : oldBlock->lightOpacity();
 	chunk->setBlock(relX, y, relZ, block);
+	lighting.blockChanged(x, y, z, oldEmission, oldOpacity);
 	markDirty(x, y, z);
 	requestUpdate(x, y, z);
 	requestUpdatesAround(x, y, z);
+	notifyMobsAround(x, y, z);
 }
 
 void World::removeBlock(int32_t x, int32_t y, int32_t z) {
@@ -223,9 +357,46 @@ void World::removeBlock(int32_t x, int32_t y, int32_t z) {
 	Chunk* chunk; int relX, relZ;
 	std::tie(chunk, relX, relZ) = getBlockFromChunk(x, z);
 	if(chunk == nullptr) return;
+	Block* oldBlock = chunk->getBlock(relX, y, relZ);
+	uint8_t oldEmission = oldBlock == nullptr ? 0 : oldBlock->lightEmission();
+	uint8_t oldOpacity = oldBlock == nullptr ? 0 : oldBlock->lightOpacity();
 	chunk->removeBlock(relX, y, relZ);
+	lighting.blockChanged(x, y, z, oldEmission, oldOpacity);
 	markDirty(x, y, z);
 	requestUpdatesAround(x, y, z);
+	notifyMobsAround(x, y, z);
+}
+
+void World::fetchBlockIds(int32_t minX, int32_t minY, int32_t minZ, int32_t sizeX, int32_t sizeY, int32_t sizeZ, BlockId* out) {
+	for(int32_t dz = 0; dz < sizeZ; ++dz) {
+		for(int32_t dx = 0; dx < sizeX; ++dx) {
+			Chunk* chunk; int relX, relZ;
+			std::tie(chunk, relX, relZ) = getBlockFromChunk(minX + dx, minZ + dz);
+			for(int32_t dy = 0; dy < sizeY; ++dy) {
+				int32_t y = minY + dy;
+				BlockId id = 0;
+				if(chunk != nullptr && isValidHeight(y))
+					id = chunk->getBlockId(relX, y, relZ);
+				out[dx + sizeX*dz + sizeX*sizeZ*dy] = id;
+			}
+		}
+	}
+}
+
+void World::fetchLight(int32_t minX, int32_t minY, int32_t minZ, int32_t sizeX, int32_t sizeY, int32_t sizeZ, uint8_t* out) {
+	for(int32_t dz = 0; dz < sizeZ; ++dz) {
+		for(int32_t dx = 0; dx < sizeX; ++dx) {
+			Chunk* chunk; int relX, relZ;
+			std::tie(chunk, relX, relZ) = getBlockFromChunk(minX + dx, minZ + dz);
+			for(int32_t dy = 0; dy < sizeY; ++dy) {
+				int32_t y = minY + dy;
+				uint8_t light = MAX_LIGHT << 4;
+				if(y < 0) light = 0;
+				else if(chunk != nullptr && y < CHUNK_HEIGHT) light = chunk->getLight(relX, y, relZ);
+				out[dx + sizeX*dz + sizeX*sizeZ*dy] = light;
+			}
+		}
+	}
 }
 
 bool World::isOpaqueCube(int32_t x, int32_t y, int32_t z) {
@@ -236,28 +407,100 @@ bool World::isOpaqueCube(int32_t x, int32_t y, int32_t z) {
 	return chunk->isOpaqueCube(relX, y, relZ);
 }
 
-std::tuple<bool, int,int,int> World::raycast(glm::vec3 pos, glm::vec3 dir, float maxDist, bool offset, bool hitFluids) {
-	Ray ray(pos, dir);
-	bool hit = hitFluids ? hasBlock(ray.getX(), ray.getY(), ray.getZ())
-	                     : hasSolidBlock(ray.getX(), ray.getY(), ray.getZ());
-	while(!hit && ray.getDistance() <= maxDist) {
-		ray.nextFace();
-		hit = hitFluids ? hasBlock(ray.getX(), ray.getY(), ray.getZ())
-	                    : hasSolidBlock(ray.getX(), ray.getY(), ray.getZ());;
-	}
-	if(hit && ray.getDistance() <= maxDist) {
-		int32_t x = ray.getX();
-		int32_t y = ray.getY();
-		int32_t z = ray.getZ();
-		if(offset) {
-			int face = ray.getLastFace();
-			x += sideVectors[face][0];
-			y += sideVectors[face][1];
-			z += sideVectors[face][2];
+namespace {
+	// Keeps the last chunk column a ray went through, so that walking inside a chunk needs no map lookup.
+	struct ColumnCursor {
+		Chunk* chunk;
+		int32_t minX, minZ;
+		bool valid;
+	};
+	
+	RaycastHit traceRay(World& world, const RaycastQuery& query, ColumnCursor& cursor) {
+		Ray ray(query.pos, query.dir);
+		while(ray.getDistance() <= query.maxDist) {
+			int32_t x = ray.getX();
+			int32_t y = ray.getY();
+			int32_t z = ray.getZ();
+			if(!cursor.valid || x < cursor.minX || x >= cursor.minX + CHUNK_SIZE
+					|| z < cursor.minZ || z >= cursor.minZ + CHUNK_SIZE) {
+				int32_t chunkX, chunkZ;
+				std::tie(chunkX, chunkZ) = World::getChunkPosAt(x, z);
+				cursor.chunk = world.findChunk(chunkX, chunkZ);
+				cursor.minX = chunkX*CHUNK_SIZE;
+				cursor.minZ = chunkZ*CHUNK_SIZE;
+				cursor.valid = true;
+			}
+			int32_t maxX = cursor.minX + CHUNK_SIZE - 1;
+			int32_t maxZ = cursor.minZ + CHUNK_SIZE - 1;
+			
+			// Find the empty box the ray is in, if any, and jump straight to its exit
+			float exit;
+			if(y < 0) {
+				if(ray.getStepY() <= 0) break;
+				exit = ray.getExitDistance(cursor.minX, y, cursor.minZ, maxX, -1, maxZ);
+			} else if(y >= CHUNK_HEIGHT) {
+				if(ray.getStepY() >= 0) break;
+				exit = ray.getExitDistance(cursor.minX, CHUNK_HEIGHT, cursor.minZ, maxX, y, maxZ);
+			} else if(cursor.chunk == nullptr) {
+				exit = ray.getExitDistance(cursor.minX, 0, cursor.minZ, maxX, CHUNK_HEIGHT - 1, maxZ);
+			} else if(cursor.chunk->isSectionEmpty(y / SECTION_HEIGHT)) {
+				int32_t minY = y - y % SECTION_HEIGHT;
+				exit = ray.getExitDistance(cursor.minX, minY, cursor.minZ, maxX, minY + SECTION_HEIGHT - 1, maxZ);
+			} else {
+				BlockId id = cursor.chunk->getBlockId(x - cursor.minX, y, z - cursor.minZ);
+				if(id != 0) {
+					Block& block = Block::fromId(id);
+					if(query.hitFluids || block.collision() == BlockCollision::solidCube) {
+						return RaycastHit { true, x, y, z, (uint8_t) ray.getLastFace(), ray.getDistance(), &block };
+					}
+				}
+				ray.nextFace();
+				continue;
+			}
+			if(exit > query.maxDist) break;
+			ray.skipTo(exit);
 		}
-		return std::tuple<bool, int,int,int>(true, x, y, z);
-	} else {
-		return std::tuple<bool, int,int,int>(false, 0, 0, 0);
+		return RaycastHit { false, 0, 0, 0, 0, query.maxDist, nullptr };
+	}
+}
+
+RaycastHit World::raycast(glm::vec3 pos, glm::vec3 dir, float maxDist, bool hitFluids) {
+	ColumnCursor cursor = { nullptr, 0, 0, false };
+	return traceRay(*this, RaycastQuery { pos, dir, maxDist, hitFluids }, cursor);
+}
+
+void World::raycast(const std::vector<RaycastQuery>& queries, std::vector<RaycastHit>& hits) {
+	hits.resize(queries.size());
+	ColumnCursor cursor = { nullptr, 0, 0, false };
+	for(size_t i = 0; i < queries.size(); ++i) {
+		hits[i] = traceRay(*this, queries[i], cursor);
+	}
+}
+
+namespace {
+	RaycastQuery sightQuery(glm::vec3 from, glm::vec3 to) {
+		float dist = glm::length(to - from);
+		glm::vec3 dir = dist == 0 ? glm::vec3(0.0f, 1.0f, 0.0f) : (to - from) / dist;
+		return RaycastQuery { from, dir, dist, false };
+	}
+	
+	bool reachesTarget(const RaycastHit& hit, glm::vec3 to) {
+		return !hit.hit || (hit.x == getBlockCoordAt(to.x) && hit.y == getBlockCoordAt(to.y) && hit.z == getBlockCoordAt(to.z));
+	}
+}
+
+bool World::hasLineOfSight(glm::vec3 from, glm::vec3 to) {
+	RaycastQuery query = sightQuery(from, to);
+	return reachesTarget(raycast(query.pos, query.dir, query.maxDist, query.hitFluids), to);
+}
+
+void World::hasLineOfSight(const std::vector<std::pair<glm::vec3, glm::vec3>>& segments, std::vector<uint8_t>& visible) {
+	sightQueries.clear();
+	for(auto& segment : segments) sightQueries.push_back(sightQuery(segment.first, segment.second));
+	raycast(sightQueries, sightHits);
+	visible.resize(segments.size());
+	for(size_t i = 0; i < segments.size(); ++i) {
+		visible[i] = reachesTarget(sightHits[i], segments[i].second);
 	}
 }
 
@@ -387,8 +630,84 @@ bool World::containsMobs(int32_t x, int32_t y, int32_t z) {
 	return false;
 }
 
+void World::notifyMobsAround(int32_t x, int32_t y, int32_t z) {
+	glm::vec3 blockPos(x, y, z);
+	for(auto it = mobs.begin(); it != mobs.end(); ++it) {
+		glm::vec3 c1, c2;
+		std::tie(c1, c2) = (*it)->getBoundingBox();
+		// the mob may be resting on, held up by, or looking up at anything near its bounding box
+		c1 -= glm::vec3(1.5f);
+		c2 += glm::vec3(1.5f, 1.5f + Mob::CEILING_SCAN, 1.5f);
+		if(c1.x <= blockPos.x && blockPos.x <= c2.x && c1.y <= blockPos.y && blockPos.y <= c2.y
+				&& c1.z <= blockPos.z && blockPos.z <= c2.z) {
+			(*it)->environmentChanged();
+		}
+	}
+}
+
 void World::updateEntities(float dt) {
+	observers.clear();
+	playerCenters.clear();
+	for(auto it = mobs.begin(); it != mobs.end(); ++it) {
+		if(dynamic_cast<Player*>(it->get())) {
+			observers.push_back((*it)->pos());
+			playerCenters.push_back((*it)->getCenter());
+		}
+	}
+	
+	// Each mob that looks for players gets the nearest one in range, if it can see it
+	sightSegments.clear();
+	sightMobs.clear();
 	for(auto it = mobs.begin(); it != mobs.end(); ++it) {
-		(*it)->update(dt);
+		Mob& mob = **it;
+		float range = mob.sightRange();
+		if(range <= 0) continue;
+		glm::vec3 center = mob.getCenter();
+		float minDist2 = range*range;
+		glm::vec3* nearest = nullptr;
+		for(glm::vec3& playerCenter : playerCenters) {
+			glm::vec3 diff = playerCenter - center;
+			if(glm::dot(diff, diff) <= minDist2) {
+				minDist2 = glm::dot(diff, diff);
+				nearest = &playerCenter;
+			}
+		}
+		if(nearest == nullptr) {
+			mob.seeTarget(false, center);
+		} else {
+			sightSegments.emplace_back(center, *nearest);
+			sightMobs.push_back(&mob);
+		}
+	}
+	hasLineOfSight(sightSegments, sightVisible);
+	for(size_t i = 0; i < sightMobs.size(); ++i) {
+		sightMobs[i]->seeTarget(sightVisible[i], sightSegments[i].second);
+	}
+	
+	entityTicks++;
+	uint32_t mobIdx = 0;
+	for(auto it = mobs.begin(); it != mobs.end(); ++it, ++mobIdx) {
+		Mob& mob = **it;
+		glm::vec3 pos = mob.pos();
+		
+		int32_t x, y, z;
+		std::tie(x, y, z) = getBlockCoordsAt(pos);
+		int32_t chunkX, chunkZ;
+		std::tie(chunkX, chunkZ) = getChunkPosAt(x, z);
+		if(!isChunkLoaded(chunkX, chunkZ)) continue;
+		
+		float minDist2 = 0;
+		if(!observers.empty() && !dynamic_cast<Player*>(&mob)) {
+			minDist2 = std::numeric_limits<float>::infinity();
+			for(glm::vec3& observer : observers) {
+				glm::vec3 diff = pos - observer;
+				minDist2 = std::min(minDist2, glm::dot(diff, diff));
+			}
+		}
+		uint32_t interval = 1;
+		if(minDist2 >= QUARTER_RATE_DIST*QUARTER_RATE_DIST) interval = 4;
+		else if(minDist2 >= HALF_RATE_DIST*HALF_RATE_DIST) interval = 2;
+		// stagger reduced-rate mobs so they don't all update on the same frame
+		mob.tick(dt, (entityTicks + mobIdx) % interval == 0);
 	}
 }
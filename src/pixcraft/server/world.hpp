@@ -6,41 +6,75 @@
 #include <tuple>
 #include <vector>
 #include <string>
+#include <memory_resource>
 
 #include "pixcraft/util/glm.hpp"
 
 #include "pixcraft/util/util.hpp"
+#include "pixcraft/util/jobs.hpp"
 
 #include "world_module.hpp"
 #include "worldgen.hpp"
 #include "chunk.hpp"
+#include "light_engine.hpp"
 
 namespace PixCraft {
+	struct RaycastQuery {
+		glm::vec3 pos;
+		glm::vec3 dir;
+		float maxDist;
+		bool hitFluids;
+	};
+	
+	struct RaycastHit {
+		bool hit;
+		int32_t x, y, z;
+		uint8_t face; // side of the hit block through which the ray entered it
+		float distance;
+		Block* block;
+	};
+	
 	class World {
 	public:
 		std::vector<std::unique_ptr<Mob>> mobs;
 		
 		World();
+		World(uint64_t seed); // for reproducible worlds
+		~World();
+		
+		uint64_t seed();
 		
 		void saveToFile(std::string path);
+		// Serializes the world, and leaves writing the file to a worker, once the previous write is done
+		void saveToFileInBackground(std::string path);
 		Player* loadFromFile(std::string path);
 		
+		// Adds the CPU memory used by the chunks, block updates, lighting and mobs
+		void reportMemory(MemoryReport& report);
+		
 		// Chunks
 		static bool isValidHeight(int32_t y);
 		static std::pair<int32_t, int32_t> getChunkPosAt(int32_t x, int32_t z);
 		static uint64_t getChunkIdxAt(int32_t x, int32_t z);
 		
 		bool isChunkLoaded(int32_t x, int32_t z);
+		size_t loadedChunkCount();
 		Chunk& getChunk(int32_t x, int32_t z);
+		Chunk* findChunk(int32_t x, int32_t z); // returns nullptr if the chunk isn't loaded
 		Chunk& genChunk(int32_t x, int32_t z);
+		// Generates the terrain of a chunk on a worker; it's added to the world, then lit, in Jobs::runCompletions
+		void requestChunk(int32_t x, int32_t z);
+		bool isChunkRequested(int32_t x, int32_t z);
+		size_t requestedChunkCount();
 		
 		std::tuple<Chunk*, uint8_t, uint8_t> getBlockFromChunk(int32_t x, int32_t z);
 		
 		// Block updates
 		void markDirty(int32_t x, int32_t y, int32_t z);
+		// The sets returned are allocated in the frame arena
 		BlockPosSet retrieveDirtyBlocks();
 		void markChunkDirty(int32_t chunkX, int32_t chunkZ);
-		std::unordered_set<uint64_t> retrieveDirtyChunks();
+		ChunkIdxSet retrieveDirtyChunks();
 		void requestUpdate(int32_t x, int32_t y, int32_t z);
 		void requestUpdatesAround(int32_t x, int32_t y, int32_t z);
 		void updateBlocks();
@@ -51,13 +85,26 @@ namespace PixCraft {
 		void setBlock(int32_t x, int32_t y, int32_t z, Block& block);
 		void removeBlock(int32_t x, int32_t y, int32_t z);
 		
+		// copies the ids of the blocks in a box into out, x first, then z, then y;
+		// blocks outside of loaded chunks or valid heights are read as air (0).
+		void fetchBlockIds(int32_t minX, int32_t minY, int32_t minZ, int32_t sizeX, int32_t sizeY, int32_t sizeZ, BlockId* out);
+		// same for the packed light levels; blocks above the world or in unloaded chunks get full sky light
+		void fetchLight(int32_t minX, int32_t minY, int32_t minZ, int32_t sizeX, int32_t sizeY, int32_t sizeZ, uint8_t* out);
+		
 		// Block collisions
 		bool isOpaqueCube(int32_t x, int32_t y, int32_t z);
 		
-		// sends a ray from pos in dir, on maxDist, and tests for block collisions; returns a tuple with:
-		// { hit?, hitBlockX, hitBlockY, hitBlockZ }
-		// if offset, the air block before the hit block is returned instead.
-		std::tuple<bool, int,int,int> raycast(glm::vec3 pos, glm::vec3 dir, float maxDist, bool offset, bool hitFluids);
+		// sends a ray from pos in dir, on maxDist, and tests for block collisions.
+		// the air block before the hit block can be found by offsetting the hit position by sideVectors[face].
+		RaycastHit raycast(glm::vec3 pos, glm::vec3 dir, float maxDist, bool hitFluids);
+		// casts many rays at once; consecutive rays starting in the same chunk share the chunk lookup,
+		// and empty sections and unloaded chunks are crossed in bulk.
+		void raycast(const std::vector<RaycastQuery>& queries, std::vector<RaycastHit>& hits);
+		
+		// whether no solid block lies between from and to; a block at to itself doesn't hide it
+		bool hasLineOfSight(glm::vec3 from, glm::vec3 to);
+		// same for many segments, cast together with the batch raycast; visible[i] is set for segments[i]
+		void hasLineOfSight(const std::vector<std::pair<glm::vec3, glm::vec3>>& segments, std::vector<uint8_t>& visible);
 		
 		bool hasSolidBlock(int32_t x, int32_t y, int32_t z);
 		
@@ -76,15 +123,39 @@ namespace PixCraft {
 		
 		// Entities
 		bool containsMobs(int32_t x, int32_t y, int32_t z);
+		// tells mobs near a changed block to wake up and refresh their environment
+		void notifyMobsAround(int32_t x, int32_t y, int32_t z);
+		// mobs far from every player are simulated less often, with larger timesteps;
+		// mobs in unloaded chunks are frozen. Mobs with a sight range are first told which player they see.
 		void updateEntities(float dt);
 		
 	private:
 		WorldGenerator gen;
 		
 		std::unordered_map<uint64_t, Chunk> loadedChunks;
-		std::unordered_set<uint64_t> scheduledUpdates;
+		std::unordered_set<uint64_t> requestedChunks;
+		JobCounter generationJobs;
+		JobCounter saveJobs;
+		// The block update sets are emptied every frame; their nodes are kept here to be reused
+		std::pmr::unsynchronized_pool_resource updatePool;
+		ChunkIdxSet scheduledUpdates;
+		LightEngine lighting;
 		
 		BlockPosSet dirtyBlocks;
-		std::unordered_set<uint64_t> dirtyChunks;
+		ChunkIdxSet dirtyChunks;
+		
+		uint32_t entityTicks;
+		std::vector<glm::vec3> observers;
+		// Kept between updates so that casting the mobs' lines of sight doesn't allocate
+		std::vector<glm::vec3> playerCenters;
+		std::vector<std::pair<glm::vec3, glm::vec3>> sightSegments;
+		std::vector<uint8_t> sightVisible;
+		std::vector<Mob*> sightMobs;
+		std::vector<RaycastQuery> sightQueries;
+		std::vector<RaycastHit> sightHits;
+		
+		flatbuffers::DetachedBuffer serialize();
+		// Lights a chunk that was just added, and has it rendered
+		void chunkAdded(int32_t x, int32_t z);
 	};
 }
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstdint>
+
 namespace PixCraft {
 	typedef uint16_t BlockId;
 	class Block;
@@ -12,4 +14,7 @@ namespace PixCraft {
 
 	#define CHUNK_SIZE 16
 	#define CHUNK_HEIGHT 64
+	
+	#define MAX_LIGHT 15
+	enum class LightChannel { sky, block };
 }
@@ -4,6 +4,7 @@
 
 #include "blocks.hpp"
 #include "pixcraft/util/random.hpp"
+#include "pixcraft/util/trace.hpp"
 
 #include "chunk.hpp"
 
@@ -17,6 +18,7 @@ WorldGenerator::WorldGenerator() : WorldGenerator(generateSeed()) { }
 uint64_t WorldGenerator::seed() { return _seed; }
 
 void WorldGenerator::generateChunk(Chunk& chunk, int32_t chunkX, int32_t chunkZ) {
+	TRACE_SCOPE("Generate chunk");
 	for(uint8_t relX = 0; relX < CHUNK_SIZE; ++relX) {
 		for(uint8_t relZ = 0; relZ < CHUNK_SIZE; ++relZ) {
 			int32_t x = chunkX*CHUNK_SIZE + relX;
@@ -38,8 +40,11 @@ void WorldGenerator::generateChunk(Chunk& chunk, int32_t chunkX, int32_t chunkZ)
 		}
 	}
 	
-	std::vector<float> trees = distributeObjects(getFeatureSeed(_seed, FeatureType::trees),
-		chunkX*CHUNK_SIZE - 0.5, chunkZ*CHUNK_SIZE - 0.5, CHUNK_SIZE, 6, 2.5);
+	// Chunks are generated on the job system's workers, so the trees are put on the stack rather than in the frame arena
+	char treeBuffer[TREE_BUFFER_SIZE];
+	std::pmr::monotonic_buffer_resource treeMemory(treeBuffer, sizeof(treeBuffer));
+	std::pmr::vector<float> trees = distributeObjects(getFeatureSeed(_seed, FeatureType::trees),
+		chunkX*CHUNK_SIZE - 0.5, chunkZ*CHUNK_SIZE - 0.5, CHUNK_SIZE, 6, 2.5, &treeMemory);
 	for(size_t i = 0; i < trees.size(); i += 2) {
 		int32_t x = round(trees[i]);
 		int32_t z = round(trees[i + 1]);
@@ -21,6 +21,7 @@ namespace PixCraft {
 		OpenSimplexNoise terrainHeightNoise;
 		
 		static const uint8_t WATER_LEVEL = 30;
+		static const size_t TREE_BUFFER_SIZE = 1024; // bytes, more than the tree positions of a chunk need
 		
 		uint8_t getTerrainHeight(int32_t x, int32_t z);
 		
@@ -0,0 +1,338 @@
+#include "alloc_tracking.hpp"
+
+#include <new>
+#include <mutex>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+
+#include "memory_stats.hpp"
+
+#ifdef PIXCRAFT_ALLOC_TRACKING
+	#ifdef _WIN32
+		#define WIN32_LEAN_AND_MEAN
+		#define NOMINMAX
+		#include <windows.h>
+	#else
+		#include <execinfo.h>
+		#include <cxxabi.h>
+	#endif
+#endif
+
+using namespace PixCraft;
+
+// Everything here may be used by operator new before any constructor runs, so it's all constant-initialized,
+// and nothing is allocated while the mutex is locked, since operator new locks it too.
+namespace PixCraft::AllocTracking {
+	namespace {
+		struct ScopeStats {
+			const char* name; // nullptr for the allocations outside of any scope
+			AllocStats frame;
+			AllocStats lastFrame;
+			AllocStats sinceReport;
+		};
+		
+		struct CallSite {
+			void* frames[ALLOC_CALL_SITE_DEPTH];
+			int depth;
+			uint64_t hash;
+			AllocStats stats;
+		};
+		
+		std::mutex mutex;
+		
+		AllocStats frame, lastFrameStats, sinceReport;
+		std::atomic<uint64_t> freesSinceReport(0);
+		uint64_t framesSinceReport;
+		
+		AllocStats history[ALLOC_HISTORY];
+		size_t frameCount;
+		
+		ScopeStats scopes[ALLOC_MAX_SCOPES];
+		size_t scopeCount;
+		AllocStats droppedScopes; // of scopes beyond ALLOC_MAX_SCOPES
+		
+		// Open addressing, cleared by reports
+		CallSite callSites[ALLOC_MAX_CALL_SITES];
+		size_t callSiteCount;
+		AllocStats droppedSites; // of call sites once the table is 3/4 full
+		
+		// Set while the thread is in a hook or making a report, so that the allocations made there aren't counted
+		thread_local bool untracked = false;
+		thread_local const char* scopeStack[ALLOC_MAX_SCOPE_DEPTH];
+		thread_local int scopeDepth = 0;
+		
+		class Untracked {
+		public:
+			Untracked() : previous(untracked) { untracked = true; }
+			~Untracked() { untracked = previous; }
+		
+		private:
+			bool previous;
+		};
+		
+		void add(AllocStats& stats, size_t bytes) {
+			stats.count++;
+			stats.bytes += bytes;
+		}
+		
+		const char* scopeName(const ScopeStats& scope) {
+			return scope.name != nullptr ? scope.name : "Other";
+		}
+		
+		ScopeStats* findScope(const char* name) {
+			for(size_t i = 0; i < scopeCount; ++i) {
+				ScopeStats& scope = scopes[i];
+				if(scope.name == name || (scope.name != nullptr && name != nullptr && strcmp(scope.name, name) == 0)) return &scope;
+			}
+			if(scopeCount == ALLOC_MAX_SCOPES) return nullptr;
+			ScopeStats& scope = scopes[scopeCount++];
+			scope.name = name;
+			return &scope;
+		}
+		
+		CallSite* findCallSite(void** frames, int depth) {
+			uint64_t hash = 14695981039346656037ULL;
+			for(int i = 0; i < depth; ++i) {
+				hash = (hash ^ (uintptr_t) frames[i]) * 1099511628211ULL;
+			}
+			for(size_t probe = 0; probe < ALLOC_MAX_CALL_SITES; ++probe) {
+				CallSite& site = callSites[(hash + probe) % ALLOC_MAX_CALL_SITES];
+				if(site.depth == 0) {
+					if(callSiteCount >= ALLOC_MAX_CALL_SITES * 3 / 4) return nullptr;
+					std::copy(frames, frames + depth, site.frames);
+					site.depth = depth;
+					site.hash = hash;
+					callSiteCount++;
+					return &site;
+				}
+				if(site.hash == hash && site.depth == depth && std::equal(frames, frames + depth, site.frames)) return &site;
+			}
+			return nullptr;
+		}
+		
+		#ifdef PIXCRAFT_ALLOC_TRACKING
+		int captureStack(void** frames) {
+			// Skips this function; the stack starts at the operator new that was called
+			#ifdef _WIN32
+			return CaptureStackBackTrace(1, ALLOC_CALL_SITE_DEPTH, frames, nullptr);
+			#else
+			void* all[ALLOC_CALL_SITE_DEPTH + 1];
+			int depth = backtrace(all, ALLOC_CALL_SITE_DEPTH + 1);
+			if(depth <= 1) return 0;
+			std::copy(all + 1, all + depth, frames);
+			return depth - 1;
+			#endif
+		}
+		
+		__attribute__((noinline)) void* allocate(size_t size) {
+			void* p = malloc(size != 0 ? size : 1);
+			if(p == nullptr || untracked) return p;
+			Untracked guard;
+			
+			void* frames[ALLOC_CALL_SITE_DEPTH];
+			int depth = captureStack(frames);
+			const char* scope = scopeDepth > 0 ? scopeStack[std::min(scopeDepth, ALLOC_MAX_SCOPE_DEPTH) - 1] : nullptr;
+			
+			std::lock_guard<std::mutex> lock(mutex);
+			add(frame, size);
+			add(sinceReport, size);
+			if(ScopeStats* stats = findScope(scope)) {
+				add(stats->frame, size);
+				add(stats->sinceReport, size);
+			} else {
+				add(droppedScopes, size);
+			}
+			CallSite* site = depth > 0 ? findCallSite(frames, depth) : nullptr;
+			add(site != nullptr ? site->stats : droppedSites, size);
+			return p;
+		}
+		
+		void deallocate(void* p) {
+			if(p == nullptr) return;
+			free(p);
+			if(!untracked) freesSinceReport++;
+		}
+		
+		// Where the frame's code is, as the module and the offset in it, which addr2line takes with -e
+		std::string describeFrame(void* address) {
+			#ifdef _WIN32
+			HMODULE module = nullptr;
+			char path[MAX_PATH] = "?";
+			if(GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+					(LPCSTR) address, &module)) {
+				GetModuleFileNameA(module, path, MAX_PATH);
+			}
+			char offset[32];
+			snprintf(offset, sizeof(offset), "+0x%llx", (unsigned long long) ((uintptr_t) address - (uintptr_t) module));
+			return std::string(path) + offset;
+			#else
+			// e.g. "./pixcraft(_ZN8PixCraft5World9genChunkEii+0x4c) [0x5591c1a2e4ac]", or "./pixcraft(+0x4e4ac) [0x5591c1a2e4ac]"
+			char** symbols = backtrace_symbols(&address, 1);
+			if(symbols == nullptr) return "?";
+			std::string text = symbols[0];
+			free(symbols);
+			size_t open = text.find('(');
+			size_t plus = text.find('+', open);
+			if(open == std::string::npos || plus == std::string::npos || plus == open + 1) return text;
+			int status = 0;
+			char* demangled = abi::__cxa_demangle(text.substr(open + 1, plus - open - 1).c_str(), nullptr, nullptr, &status);
+			if(status == 0) text.replace(open + 1, plus - open - 1, demangled);
+			free(demangled);
+			return text;
+			#endif
+		}
+		#else
+		std::string describeFrame(void* address) {
+			return "?";
+		}
+		#endif
+		
+		std::string formatStats(AllocStats stats) {
+			return std::to_string(stats.count) + " (" + MemoryStats::formatBytes(stats.bytes) + ")";
+		}
+	}
+	
+	#ifdef PIXCRAFT_ALLOC_TRACKING
+	void beginScope(const char* name) {
+		if(scopeDepth < ALLOC_MAX_SCOPE_DEPTH) scopeStack[scopeDepth] = name;
+		scopeDepth++;
+	}
+	
+	void endScope() {
+		scopeDepth--;
+	}
+	#endif
+	
+	void nextFrame() {
+		std::lock_guard<std::mutex> lock(mutex);
+		lastFrameStats = frame;
+		history[frameCount % ALLOC_HISTORY] = frame;
+		frame = AllocStats { 0, 0 };
+		frameCount++;
+		framesSinceReport++;
+		for(size_t i = 0; i < scopeCount; ++i) {
+			scopes[i].lastFrame = scopes[i].frame;
+			scopes[i].frame = AllocStats { 0, 0 };
+		}
+	}
+	
+	AllocStats lastFrame() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return lastFrameStats;
+	}
+	
+	AllocStats maxFrame() {
+		std::lock_guard<std::mutex> lock(mutex);
+		AllocStats max { 0, 0 };
+		for(size_t i = 0; i < std::min(frameCount, (size_t) ALLOC_HISTORY); ++i) {
+			max.count = std::max(max.count, history[i].count);
+			max.bytes = std::max(max.bytes, history[i].bytes);
+		}
+		return max;
+	}
+	
+	std::vector<std::string> lastFrameScopes() {
+		Untracked guard;
+		std::vector<std::string> lines;
+		std::lock_guard<std::mutex> lock(mutex);
+		for(size_t i = 0; i < scopeCount; ++i) {
+			if(scopes[i].lastFrame.count == 0) continue;
+			lines.push_back(std::string(scopeName(scopes[i])) + ": " + formatStats(scopes[i].lastFrame));
+		}
+		return lines;
+	}
+	
+	std::vector<std::string> writeReport(std::string path, size_t topSites) {
+		Untracked guard;
+		std::ofstream file(path.c_str());
+		if(!file) throw std::runtime_error("Can't open allocation report " + path);
+		
+		// Copied out, since the symbols can't be looked up with the mutex locked
+		std::vector<ScopeStats> scopeList;
+		std::vector<CallSite> sites;
+		AllocStats total, unknownSites, unknownScopes;
+		uint64_t frees, frames;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			scopeList.assign(scopes, scopes + scopeCount);
+			for(CallSite& site : callSites) {
+				if(site.depth != 0) sites.push_back(site);
+			}
+			total = sinceReport;
+			unknownSites = droppedSites;
+			unknownScopes = droppedScopes;
+			frees = freesSinceReport.exchange(0);
+			frames = framesSinceReport;
+			
+			sinceReport = droppedSites = droppedScopes = AllocStats { 0, 0 };
+			framesSinceReport = 0;
+			for(size_t i = 0; i < scopeCount; ++i) scopes[i].sinceReport = AllocStats { 0, 0 };
+			std::fill(std::begin(callSites), std::end(callSites), CallSite {});
+			callSiteCount = 0;
+		}
+		
+		std::vector<std::string> summary;
+		summary.push_back(formatStats(total) + " allocations and " + std::to_string(frees) + " frees in "
+			+ std::to_string(frames) + " frames");
+		std::sort(scopeList.begin(), scopeList.end(), [](const ScopeStats& a, const ScopeStats& b) {
+			return a.sinceReport.count > b.sinceReport.count;
+		});
+		for(ScopeStats& scope : scopeList) {
+			if(scope.sinceReport.count == 0) continue;
+			summary.push_back(std::string(scopeName(scope)) + ": " + formatStats(scope.sinceReport));
+		}
+		if(unknownScopes.count != 0) summary.push_back("Other scopes: " + formatStats(unknownScopes));
+		
+		for(std::string& line : summary) file << line << std::endl;
+		
+		std::sort(sites.begin(), sites.end(), [](const CallSite& a, const CallSite& b) {
+			return a.stats.count > b.stats.count;
+		});
+		file << std::endl << "Top call sites, from operator new up (offsets can be resolved with addr2line -f -C -e <executable> <offset>):" << std::endl;
+		for(size_t i = 0; i < std::min(topSites, sites.size()); ++i) {
+			file << std::endl << formatStats(sites[i].stats) << std::endl;
+			for(int j = 0; j < sites[i].depth; ++j) {
+				file << "\t" << describeFrame(sites[i].frames[j]) << std::endl;
+			}
+		}
+		if(unknownSites.count != 0) {
+			file << std::endl << formatStats(unknownSites) << " from call sites beyond the first " << ALLOC_MAX_CALL_SITES * 3 / 4 << std::endl;
+		}
+		return summary;
+	}
+}
+
+#ifdef PIXCRAFT_ALLOC_TRACKING
+// Aligned allocations (over-aligned types) keep the standard library's operators, and aren't counted
+void* operator new(size_t size) {
+	void* p = AllocTracking::allocate(size);
+	if(p == nullptr) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new[](size_t size) {
+	void* p = AllocTracking::allocate(size);
+	if(p == nullptr) throw std::bad_alloc();
+	return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	return AllocTracking::allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+	return AllocTracking::allocate(size);
+}
+
+void operator delete(void* p) noexcept { AllocTracking::deallocate(p); }
+void operator delete[](void* p) noexcept { AllocTracking::deallocate(p); }
+void operator delete(void* p, size_t size) noexcept { AllocTracking::deallocate(p); }
+void operator delete[](void* p, size_t size) noexcept { AllocTracking::deallocate(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { AllocTracking::deallocate(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { AllocTracking::deallocate(p); }
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Allocation tracking, compiled in with -DPIXCRAFT_ALLOC_TRACKING (make alloc_tracking) and out otherwise.
+// The global operator new and delete are replaced to count the allocations of each frame, of each scope
+// (the profiler zones, and the scopes marked with ALLOC_SCOPE), and of each call site.
+// Steady-state play should make none on the main thread; the counts are there to catch it when it starts to.
+#ifdef PIXCRAFT_ALLOC_TRACKING
+	#define ALLOC_CONCAT_IMPL(a, b) a##b
+	#define ALLOC_CONCAT(a, b) ALLOC_CONCAT_IMPL(a, b)
+	// Counts the allocations until the end of the enclosing scope under name, which must be a string literal
+	#define ALLOC_SCOPE(name) PixCraft::AllocTracking::Scope ALLOC_CONCAT(allocScope, __LINE__)(name)
+#else
+	#define ALLOC_SCOPE(name)
+#endif
+
+namespace PixCraft {
+	#define ALLOC_HISTORY 240
+	#define ALLOC_MAX_SCOPES 64
+	#define ALLOC_MAX_SCOPE_DEPTH 16
+	#define ALLOC_MAX_CALL_SITES 4096
+	#define ALLOC_CALL_SITE_DEPTH 8 // frames of the stack that tell call sites apart, from operator new up
+	
+	struct AllocStats {
+		uint64_t count;
+		uint64_t bytes;
+	};
+	
+	namespace AllocTracking {
+		#ifdef PIXCRAFT_ALLOC_TRACKING
+		const bool ENABLED = true;
+		
+		// Scopes nest per thread; allocations outside of any are counted under "Other"
+		void beginScope(const char* name);
+		void endScope();
+		#else
+		const bool ENABLED = false;
+		
+		inline void beginScope(const char* name) { }
+		inline void endScope() { }
+		#endif
+		
+		// Ends the frame of the main thread; allocations of the workers are counted in the frame they happen in
+		void nextFrame();
+		AllocStats lastFrame();
+		AllocStats maxFrame(); // of the last ALLOC_HISTORY frames
+		// Allocations per scope in the last frame, as "name: count (size)", for the scopes that made any
+		std::vector<std::string> lastFrameScopes();
+		
+		// Writes the allocations per scope and the topSites call sites that made the most allocations since the last report,
+		// then starts over; returns a summary of the report
+		std::vector<std::string> writeReport(std::string path, size_t topSites);
+		
+		class Scope {
+		public:
+			Scope(const char* name) { beginScope(name); }
+			~Scope() { endScope(); }
+		};
+	}
+}
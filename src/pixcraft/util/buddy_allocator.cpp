@@ -0,0 +1,77 @@
+#include "buddy_allocator.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+
+using namespace PixCraft;
+
+BuddyAllocator::BuddyAllocator(uint32_t minBlockSize, uint8_t orders)
+	: _minBlockSize(minBlockSize), freeBlocks(orders), _usedSize(0) {
+	if(orders == 0) throw std::logic_error("Buddy allocator needs at least one order");
+	freeBlocks[orders - 1].insert(0);
+}
+
+uint32_t BuddyAllocator::allocate(uint32_t size) {
+	uint8_t order = 0;
+	while(orderSize(order) < size) {
+		if(++order >= freeBlocks.size()) return INVALID;
+	}
+	
+	// Find the smallest free block that fits, and split it down to the right size
+	uint8_t order2 = order;
+	while(freeBlocks[order2].empty()) {
+		if(++order2 >= freeBlocks.size()) return INVALID;
+	}
+	uint32_t offset = *freeBlocks[order2].begin();
+	freeBlocks[order2].erase(freeBlocks[order2].begin());
+	while(order2 > order) {
+		--order2;
+		freeBlocks[order2].insert(offset + orderSize(order2));
+	}
+	
+	usedBlocks[offset] = order;
+	_usedSize += orderSize(order);
+	return offset;
+}
+
+void BuddyAllocator::free(uint32_t offset) {
+	auto iter = usedBlocks.find(offset);
+	if(iter == usedBlocks.end()) throw std::logic_error("Freeing a block that wasn't allocated");
+	uint8_t order = iter->second;
+	usedBlocks.erase(iter);
+	_usedSize -= orderSize(order);
+	addFreeBlock(offset, order);
+}
+
+uint32_t BuddyAllocator::blockSize(uint32_t offset) {
+	return orderSize(usedBlocks.at(offset));
+}
+
+uint32_t BuddyAllocator::capacity() { return orderSize(freeBlocks.size() - 1); }
+uint32_t BuddyAllocator::usedSize() { return _usedSize; }
+uint32_t BuddyAllocator::minBlockSize() { return _minBlockSize; }
+
+void BuddyAllocator::grow() {
+	uint32_t oldCapacity = capacity();
+	uint8_t oldTop = freeBlocks.size() - 1;
+	freeBlocks.emplace_back();
+	addFreeBlock(oldCapacity, oldTop);
+}
+
+uint32_t BuddyAllocator::orderSize(uint8_t order) {
+	return _minBlockSize << order;
+}
+
+void BuddyAllocator::addFreeBlock(uint32_t offset, uint8_t order) {
+	// Merge with the buddy block as long as it is free
+	while(order + 1 < (int) freeBlocks.size()) {
+		uint32_t size = orderSize(order);
+		uint32_t buddy = (offset / size) % 2 == 0 ? offset + size : offset - size;
+		auto iter = freeBlocks[order].find(buddy);
+		if(iter == freeBlocks[order].end()) break;
+		freeBlocks[order].erase(iter);
+		offset = std::min(offset, buddy);
+		++order;
+	}
+	freeBlocks[order].insert(offset);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <set>
+#include <unordered_map>
+
+namespace PixCraft {
+	// Sub-allocates a range of units in blocks of power-of-two sizes, merging freed blocks with their buddies.
+	class BuddyAllocator {
+	public:
+		static const uint32_t INVALID = (uint32_t) -1;
+		
+		BuddyAllocator(uint32_t minBlockSize, uint8_t orders);
+		
+		// Returns the offset of a block of at least the given size, or INVALID if there is no space left
+		uint32_t allocate(uint32_t size);
+		void free(uint32_t offset);
+		uint32_t blockSize(uint32_t offset);
+		
+		uint32_t capacity();
+		uint32_t usedSize();
+		uint32_t minBlockSize();
+		
+		// Doubles the capacity, keeping the current blocks where they are
+		void grow();
+		
+	private:
+		uint32_t _minBlockSize;
+		std::vector<std::set<uint32_t>> freeBlocks; // offsets of the free blocks of each order
+		std::unordered_map<uint32_t, uint8_t> usedBlocks; // order of each allocated block
+		uint32_t _usedSize;
+		
+		uint32_t orderSize(uint8_t order);
+		void addFreeBlock(uint32_t offset, uint8_t order);
+	};
+}
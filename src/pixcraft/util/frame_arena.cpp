@@ -0,0 +1,79 @@
+#include "frame_arena.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+using namespace PixCraft;
+
+FrameArena::FrameArena(size_t initialSize)
+	: current(nullptr), offset(0), liveCount(0), _capacity(0), usedBefore(0), _peakSize(0) {
+	current = newBlock(initialSize, nullptr);
+}
+
+FrameArena::~FrameArena() {
+	while(current != nullptr) {
+		ArenaBlock* previous = current->previous;
+		delete current;
+		current = previous;
+	}
+}
+
+FrameArena::ArenaBlock* FrameArena::newBlock(size_t size, ArenaBlock* previous) {
+	_capacity += size;
+	return new ArenaBlock { std::unique_ptr<char[]>(new char[size]), size, previous };
+}
+
+void FrameArena::endFrame() {
+	if(liveCount != 0) throw std::logic_error("Frame arena memory outlived its frame");
+}
+
+size_t FrameArena::capacity() { return _capacity; }
+size_t FrameArena::usedSize() { return usedBefore + offset; }
+size_t FrameArena::peakSize() { return _peakSize; }
+
+size_t FrameArena::alignedOffset(size_t alignment) {
+	uintptr_t base = (uintptr_t) current->data.get();
+	return ((base + offset + alignment - 1) & ~(uintptr_t) (alignment - 1)) - base;
+}
+
+void* FrameArena::do_allocate(size_t bytes, size_t alignment) {
+	size_t start = alignedOffset(alignment);
+	if(start + bytes > current->size) {
+		usedBefore += offset;
+		current = newBlock(std::max(2 * current->size, bytes + alignment), current);
+		offset = 0;
+		start = alignedOffset(alignment);
+	}
+	offset = start + bytes;
+	liveCount++;
+	_peakSize = std::max(_peakSize, usedSize());
+	return current->data.get() + start;
+}
+
+void FrameArena::do_deallocate(void* p, size_t bytes, size_t alignment) {
+	if(--liveCount == 0) rewind();
+}
+
+bool FrameArena::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+	return this == &other;
+}
+
+void FrameArena::rewind() {
+	offset = 0;
+	usedBefore = 0;
+	if(current->previous == nullptr) return;
+	// Replace the blocks with one that fits them all
+	size_t total = _capacity;
+	while(current != nullptr) {
+		ArenaBlock* previous = current->previous;
+		delete current;
+		current = previous;
+	}
+	_capacity = 0;
+	current = newBlock(total, nullptr);
+}
+
+FrameArena& PixCraft::frameArena() {
+	static FrameArena arena(FRAME_ARENA_INITIAL_SIZE);
+	return arena;
+}
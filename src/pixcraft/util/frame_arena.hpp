@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+
+namespace PixCraft {
+	#define FRAME_ARENA_INITIAL_SIZE (256*1024)
+	
+	// Memory for the containers thrown away within a frame: allocations are carved linearly out of a block,
+	// and deallocations only count down, so the arena starts over from the beginning of its block once all
+	// the memory is given back. If a frame needs more than the block, the extra memory comes from larger blocks,
+	// which are merged into one when the arena is rewound, so later frames don't need the heap at all.
+	// Containers use it through std::pmr, e.g. std::pmr::vector<int> v(&frameArena());
+	class FrameArena : public std::pmr::memory_resource {
+	public:
+		FrameArena(size_t initialSize);
+		~FrameArena();
+		
+		// Checks that no memory outlived the frame
+		void endFrame();
+		
+		size_t capacity(); // of all the blocks
+		size_t usedSize(); // including the memory given back since the last rewind
+		size_t peakSize(); // most memory used at once since the arena was created
+	
+	protected:
+		void* do_allocate(size_t bytes, size_t alignment) override;
+		void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+	
+	private:
+		struct ArenaBlock {
+			std::unique_ptr<char[]> data;
+			size_t size;
+			ArenaBlock* previous;
+		};
+		
+		ArenaBlock* current; // the most recent block; older ones are only kept until the next rewind
+		size_t offset; // in the current block
+		size_t liveCount; // allocations not given back yet
+		size_t _capacity;
+		size_t usedBefore; // used in the older blocks
+		size_t _peakSize;
+		
+		ArenaBlock* newBlock(size_t size, ArenaBlock* previous);
+		// Where an allocation with the given alignment would start in the current block
+		size_t alignedOffset(size_t alignment);
+		void rewind();
+	};
+	
+	// The arena of the main thread; the workers of the job system must not use it.
+	// The client ends a frame after each update and render.
+	FrameArena& frameArena();
+}
@@ -0,0 +1,327 @@
+#include "jobs.hpp"
+
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <condition_variable>
+
+#include "trace.hpp"
+#include "alloc_tracking.hpp"
+
+using namespace PixCraft;
+
+namespace PixCraft {
+	struct Job {
+		std::function<void()> work;
+		std::function<void()> onComplete;
+		JobPriority priority;
+		JobCounter* counter;
+	};
+	
+	class JobScheduler {
+	public:
+		JobScheduler();
+		~JobScheduler();
+		
+		unsigned int threadCount();
+		void submit(std::unique_ptr<Job> job, JobCounter* dependency);
+		void runCompletions();
+		void cancel(JobCounter& counter);
+		void wait(JobCounter& counter);
+	
+	private:
+		struct Worker {
+			std::mutex mutex;
+			std::deque<std::unique_ptr<Job>> queues[JOB_PRIORITIES];
+		};
+		
+		std::vector<std::unique_ptr<Worker>> workers;
+		std::vector<std::thread> threads;
+		std::atomic<size_t> queuedCount; // jobs in the workers' deques
+		std::atomic<size_t> nextWorker; // jobs from outside the workers are spread between them
+		
+		std::mutex sleepMutex;
+		std::condition_variable jobQueued;
+		bool stopping;
+		
+		// Jobs waiting for their dependency; counters are only decremented with this locked, so that no job waits forever
+		std::mutex waitingMutex;
+		std::vector<std::pair<JobCounter*, std::unique_ptr<Job>>> waitingJobs;
+		
+		std::mutex completionsMutex;
+		std::vector<std::unique_ptr<Job>> completions;
+		
+		void push(std::unique_ptr<Job> job);
+		// Takes a job from the given worker's deques, or steals one from the others; -1 only steals
+		std::unique_ptr<Job> take(int workerIdx);
+		void run(std::unique_ptr<Job> job);
+		// Decrements the job's counter, and queues the jobs that depended on it if it's done
+		void finish(std::unique_ptr<Job> job);
+		// Runs a job on the main thread, or yields if there are none
+		void help();
+		void work(int workerIdx);
+	};
+}
+
+namespace {
+	thread_local int currentWorker = -1;
+	
+	JobScheduler& getScheduler() {
+		static JobScheduler scheduler;
+		return scheduler;
+	}
+	
+	template<typename T>
+	void extractJobs(T& jobs, JobCounter& counter, std::vector<std::unique_ptr<Job>>& out) {
+		for(auto iter = jobs.begin(); iter != jobs.end();) {
+			if((*iter)->counter == &counter) {
+				out.push_back(std::move(*iter));
+				iter = jobs.erase(iter);
+			} else {
+				++iter;
+			}
+		}
+	}
+}
+
+JobCounter::JobCounter() : count(0) { }
+
+bool JobCounter::done() { return count.load() == 0; }
+uint32_t JobCounter::pending() { return count.load(); }
+
+
+JobScheduler::JobScheduler() : queuedCount(0), nextWorker(0), stopping(false) {
+	// Leave a core for the main thread
+	unsigned int cores = std::thread::hardware_concurrency();
+	unsigned int count = std::min(cores > 2 ? cores - 1 : 1, (unsigned int) MAX_JOB_THREADS);
+	for(unsigned int i = 0; i < count; ++i) {
+		workers.emplace_back(new Worker());
+	}
+	for(unsigned int i = 0; i < count; ++i) {
+		threads.emplace_back(&JobScheduler::work, this, i);
+	}
+}
+
+JobScheduler::~JobScheduler() {
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	jobQueued.notify_all();
+	for(std::thread& thread : threads) thread.join();
+}
+
+unsigned int JobScheduler::threadCount() {
+	return threads.size();
+}
+
+void JobScheduler::submit(std::unique_ptr<Job> job, JobCounter* dependency) {
+	if(job->counter != nullptr) job->counter->count++;
+	if(dependency != nullptr) {
+		std::lock_guard<std::mutex> lock(waitingMutex);
+		if(dependency->count.load() != 0) {
+			waitingJobs.emplace_back(dependency, std::move(job));
+			return;
+		}
+	}
+	push(std::move(job));
+}
+
+void JobScheduler::push(std::unique_ptr<Job> job) {
+	int workerIdx = currentWorker >= 0 ? currentWorker : nextWorker++ % workers.size();
+	Worker& worker = *workers[workerIdx];
+	queuedCount++;
+	{
+		std::lock_guard<std::mutex> lock(worker.mutex);
+		worker.queues[(int) job->priority].push_back(std::move(job));
+	}
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+	}
+	jobQueued.notify_one();
+}
+
+std::unique_ptr<Job> JobScheduler::take(int workerIdx) {
+	std::unique_ptr<Job> job;
+	size_t workerCount = workers.size();
+	for(int priority = 0; priority < JOB_PRIORITIES; ++priority) {
+		// The newest of the worker's own jobs is the most likely to still be in its cache
+		if(workerIdx >= 0) {
+			Worker& worker = *workers[workerIdx];
+			std::lock_guard<std::mutex> lock(worker.mutex);
+			auto& queue = worker.queues[priority];
+			if(!queue.empty()) {
+				job = std::move(queue.back());
+				queue.pop_back();
+			}
+		}
+		size_t firstVictim = workerIdx >= 0 ? workerIdx + 1 : 0;
+		for(size_t i = 0; !job && i < workerCount; ++i) {
+			size_t victimIdx = (firstVictim + i) % workerCount;
+			if((int) victimIdx == workerIdx) continue;
+			Worker& victim = *workers[victimIdx];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			auto& queue = victim.queues[priority];
+			if(!queue.empty()) {
+				job = std::move(queue.front());
+				queue.pop_front();
+			}
+		}
+		if(job) {
+			queuedCount--;
+			return job;
+		}
+	}
+	return job;
+}
+
+void JobScheduler::run(std::unique_ptr<Job> job) {
+	{
+		ALLOC_SCOPE("Jobs");
+		job->work();
+	}
+	if(job->onComplete) {
+		std::lock_guard<std::mutex> lock(completionsMutex);
+		completions.push_back(std::move(job));
+	} else {
+		finish(std::move(job));
+	}
+}
+
+void JobScheduler::finish(std::unique_ptr<Job> job) {
+	JobCounter* counter = job->counter;
+	job.reset();
+	if(counter == nullptr) return;
+	
+	std::vector<std::unique_ptr<Job>> released;
+	{
+		std::lock_guard<std::mutex> lock(waitingMutex);
+		// The counter may be destroyed as soon as it reaches 0, so it's only compared to afterwards
+		if(counter->count.fetch_sub(1) != 1) return;
+		for(auto iter = waitingJobs.begin(); iter != waitingJobs.end();) {
+			if(iter->first == counter) {
+				released.push_back(std::move(iter->second));
+				iter = waitingJobs.erase(iter);
+			} else {
+				++iter;
+			}
+		}
+	}
+	for(auto& releasedJob : released) push(std::move(releasedJob));
+}
+
+void JobScheduler::runCompletions() {
+	std::vector<std::unique_ptr<Job>> finished;
+	{
+		std::lock_guard<std::mutex> lock(completionsMutex);
+		finished.swap(completions);
+	}
+	for(auto& job : finished) {
+		job->onComplete();
+		finish(std::move(job));
+	}
+}
+
+void JobScheduler::help() {
+	std::unique_ptr<Job> job = take(-1);
+	if(job) {
+		run(std::move(job));
+	} else {
+		std::this_thread::yield();
+	}
+}
+
+void JobScheduler::cancel(JobCounter& counter) {
+	while(true) {
+		std::vector<std::unique_ptr<Job>> dropped;
+		for(auto& worker : workers) {
+			std::lock_guard<std::mutex> lock(worker->mutex);
+			for(auto& queue : worker->queues) {
+				size_t count = dropped.size();
+				extractJobs(queue, counter, dropped);
+				queuedCount -= dropped.size() - count;
+			}
+		}
+		{
+			std::lock_guard<std::mutex> lock(waitingMutex);
+			for(auto iter = waitingJobs.begin(); iter != waitingJobs.end();) {
+				if(iter->second->counter == &counter) {
+					dropped.push_back(std::move(iter->second));
+					iter = waitingJobs.erase(iter);
+				} else {
+					++iter;
+				}
+			}
+		}
+		{
+			std::lock_guard<std::mutex> lock(completionsMutex);
+			extractJobs(completions, counter, dropped);
+		}
+		for(auto& job : dropped) finish(std::move(job));
+		
+		// The jobs still counted are running on the workers
+		if(counter.done()) return;
+		help();
+	}
+}
+
+void JobScheduler::wait(JobCounter& counter) {
+	while(!counter.done()) {
+		std::vector<std::unique_ptr<Job>> finished;
+		{
+			std::lock_guard<std::mutex> lock(completionsMutex);
+			extractJobs(completions, counter, finished);
+		}
+		for(auto& job : finished) {
+			job->onComplete();
+			finish(std::move(job));
+		}
+		if(!counter.done()) help();
+	}
+}
+
+void JobScheduler::work(int workerIdx) {
+	TRACE_THREAD_NAME("Worker");
+	currentWorker = workerIdx;
+	while(true) {
+		std::unique_ptr<Job> job = take(workerIdx);
+		if(job) {
+			run(std::move(job));
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		jobQueued.wait(lock, [this]() { return stopping || queuedCount.load() > 0; });
+		if(stopping) return;
+	}
+}
+
+
+namespace PixCraft::Jobs {
+	unsigned int threadCount() {
+		return getScheduler().threadCount();
+	}
+	
+	void submit(std::function<void()> work, std::function<void()> onComplete, JobPriority priority,
+			JobCounter* counter, JobCounter* dependency) {
+		getScheduler().submit(std::unique_ptr<Job>(new Job { std::move(work), std::move(onComplete), priority, counter }), dependency);
+	}
+	
+	void submit(std::function<void()> work, JobPriority priority, JobCounter* counter, JobCounter* dependency) {
+		submit(std::move(work), nullptr, priority, counter, dependency);
+	}
+	
+	void runCompletions() {
+		getScheduler().runCompletions();
+	}
+	
+	void cancel(JobCounter& counter) {
+		getScheduler().cancel(counter);
+	}
+	
+	void wait(JobCounter& counter) {
+		getScheduler().wait(counter);
+	}
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <atomic>
+#include <functional>
+
+// Runs work on a pool of worker threads shared by the whole game (world generation, meshing, saving).
+// Each worker has its own deques of jobs: it takes the newest of its own jobs first, and when it has none,
+// steals the oldest job of another worker. Jobs of a higher priority are always taken first.
+// The work of a job runs on a worker; its completion, if any, runs on the main thread in runCompletions,
+// which is where results should be applied to the world or the renderer.
+// Submitting never waits for the workers, so it can be done from the GL thread at any time.
+
+namespace PixCraft {
+	#define MAX_JOB_THREADS 4
+	
+	enum class JobPriority : uint8_t {
+		high, // work the player is waiting for, e.g. terrain near them
+		normal,
+		low // background work, e.g. writing saves
+	};
+	#define JOB_PRIORITIES 3
+	
+	class JobScheduler;
+	
+	// Counts the jobs of a group that aren't done, completions included.
+	// A counter must outlive its jobs: owners call Jobs::cancel or Jobs::wait on it before being destroyed.
+	class JobCounter {
+	public:
+		JobCounter();
+		
+		bool done();
+		uint32_t pending();
+	
+	private:
+		friend class JobScheduler;
+		std::atomic<uint32_t> count;
+	};
+	
+	namespace Jobs {
+		// Starts the workers if needed; there is one per core, minus one for the main thread, up to MAX_JOB_THREADS
+		unsigned int threadCount();
+		
+		// Runs work on a worker, then onComplete, if any, on the main thread.
+		// The job is counted by counter, if any, until it's done, and only starts once dependency, if any, is done.
+		void submit(std::function<void()> work, std::function<void()> onComplete, JobPriority priority,
+			JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+		void submit(std::function<void()> work, JobPriority priority, JobCounter* counter = nullptr, JobCounter* dependency = nullptr);
+		
+		// Runs the completions of the jobs finished since the last call; only called by the main thread
+		void runCompletions();
+		
+		// The following are for the main thread, e.g. when the owner of the jobs is destroyed.
+		// Both return once the jobs counted by counter are done, helping the workers meanwhile.
+		// Drops the jobs that didn't start yet, and the completions of the others
+		void cancel(JobCounter& counter);
+		// Runs all the jobs, and their completions
+		void wait(JobCounter& counter);
+	}
+}
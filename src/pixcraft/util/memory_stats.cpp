@@ -0,0 +1,72 @@
+#include "memory_stats.hpp"
+
+#include <sstream>
+#include <iomanip>
+
+using namespace PixCraft;
+
+namespace PixCraft::MemoryStats {
+	namespace {
+		const size_t TAG_COUNT = (size_t) MemoryTag::count;
+		
+		const char* tagNames[TAG_COUNT] = {
+			"Chunks", "Block updates", "Lighting", "Chunk meshes", "Entities", "Particles", "Text", "Textures", "Frame arena", "Other"
+		};
+		
+		std::array<int64_t, TAG_COUNT> gpuBytes {};
+	}
+	
+	void addGpu(MemoryTag tag, int64_t bytes) {
+		gpuBytes[(size_t) tag] += bytes;
+	}
+	
+	MemoryReport gpuReport() {
+		MemoryReport report;
+		for(size_t tag = 0; tag < TAG_COUNT; ++tag) {
+			report.gpu[tag] = gpuBytes[tag];
+		}
+		return report;
+	}
+	
+	const char* tagName(MemoryTag tag) {
+		return tagNames[(size_t) tag];
+	}
+	
+	std::string formatBytes(size_t bytes) {
+		std::stringstream ss;
+		ss << std::fixed << std::setprecision(1);
+		if(bytes >= 1024*1024) {
+			ss << bytes / (1024.0*1024.0) << " MB";
+		} else {
+			ss << bytes / 1024.0 << " KB";
+		}
+		return ss.str();
+	}
+}
+
+void MemoryReport::addCpu(MemoryTag tag, size_t bytes) {
+	cpu[(size_t) tag] += bytes;
+}
+
+size_t MemoryReport::totalCpu() {
+	size_t total = 0;
+	for(size_t bytes : cpu) total += bytes;
+	return total;
+}
+
+size_t MemoryReport::totalGpu() {
+	size_t total = 0;
+	for(size_t bytes : gpu) total += bytes;
+	return total;
+}
+
+std::vector<std::string> MemoryReport::lines() {
+	std::vector<std::string> lines;
+	for(size_t tag = 0; tag < (size_t) MemoryTag::count; ++tag) {
+		if(cpu[tag] == 0 && gpu[tag] == 0) continue;
+		lines.push_back(std::string(MemoryStats::tagName((MemoryTag) tag)) + ": "
+			+ MemoryStats::formatBytes(cpu[tag]) + " CPU, " + MemoryStats::formatBytes(gpu[tag]) + " GPU");
+	}
+	lines.push_back("Total: " + MemoryStats::formatBytes(totalCpu()) + " CPU, " + MemoryStats::formatBytes(totalGpu()) + " GPU");
+	return lines;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <unordered_map>
+
+namespace PixCraft {
+	enum class MemoryTag {
+		chunks, blockUpdates, lighting, chunkMeshes, entities, particles, text, textures, frameArena, other,
+		count
+	};
+	
+	// Bytes used by each subsystem, on the CPU and on the GPU
+	struct MemoryReport {
+		std::array<size_t, (size_t) MemoryTag::count> cpu {};
+		std::array<size_t, (size_t) MemoryTag::count> gpu {};
+		
+		void addCpu(MemoryTag tag, size_t bytes);
+		size_t totalCpu();
+		size_t totalGpu();
+		// One line per subsystem using memory, then the totals
+		std::vector<std::string> lines();
+	};
+	
+	// The CPU side of a report is filled by the subsystems, which measure their containers when asked.
+	// GPU memory can't be queried back, so it is counted here as buffers and textures are allocated and freed.
+	namespace MemoryStats {
+		void addGpu(MemoryTag tag, int64_t bytes);
+		// Starts a report with the current GPU usage
+		MemoryReport gpuReport();
+		const char* tagName(MemoryTag tag);
+		// In KB or MB, e.g. "12.5 KB"
+		std::string formatBytes(size_t bytes);
+	}
+	
+	// Estimates of the heap memory owned by containers; node-based ones count a pointer per node and per bucket
+	template<typename T, typename A>
+	size_t heapBytes(const std::vector<T, A>& vector) {
+		return vector.capacity() * sizeof(T);
+	}
+	
+	template<typename K, typename H, typename E, typename A>
+	size_t heapBytes(const std::unordered_set<K, H, E, A>& set) {
+		return set.bucket_count() * sizeof(void*) + set.size() * (sizeof(K) + sizeof(void*));
+	}
+	
+	template<typename K, typename V, typename H, typename E, typename A>
+	size_t heapBytes(const std::unordered_map<K, V, H, E, A>& map) {
+		return map.bucket_count() * sizeof(void*) + map.size() * (sizeof(std::pair<const K, V>) + sizeof(void*));
+	}
+}
@@ -21,7 +21,8 @@ uint64_t PixCraft::randFromPosition(uint64_t seed, int32_t x, int32_t z) {
 	return wyhash64(seed, packCoords(x, z));
 }
 
-std::vector<float> PixCraft::distributeObjects(uint64_t seed, float minX, float minZ, float chunkSize, float minDist, float size) {
+std::pmr::vector<float> PixCraft::distributeObjects(uint64_t seed, float minX, float minZ, float chunkSize, float minDist, float size,
+		std::pmr::memory_resource* memory) {
 	int32_t minX2 = minX - size;
 	int32_t minZ2 = minZ - size;
 	int32_t maxX2 = minX + chunkSize + size;
@@ -34,14 +35,14 @@ std::vector<float> PixCraft::distributeObjects(uint64_t seed, float minX, float
 	int32_t maxX3 = (int32_t) ceil(maxX2 / tileSize);
 	int32_t maxZ3 = (int32_t) ceil(maxZ2 / tileSize);
 	
-	std::vector<float> objects;
+	std::pmr::vector<float> objects(memory);
 	for(int32_t x = minX3; x < maxX3; ++x) {
 		for(int32_t z = minZ3; z < maxZ3; ++z) {
 			uint8_t c1 = randFromPosition(seed, x, z) % 4;
 			uint8_t c2 = randFromPosition(seed, x+1, z) % 4;
 			uint8_t c3 = randFromPosition(seed, x, z+1) % 4;
 			uint8_t c4 = randFromPosition(seed, x+1, z+1) % 4;
-			std::vector<float> tile = poissonDiskTiles[(c1 << 6) | (c2 << 4) | (c3 << 2) | c4];
+			const std::vector<float>& tile = poissonDiskTiles[(c1 << 6) | (c2 << 4) | (c3 << 2) | c4];
 			for(size_t i = 0; i < tile.size(); i += 2) {
 				float pointX = (x + tile[i]) * tileSize;
 				float pointZ = (z + tile[i + 1]) * tileSize;
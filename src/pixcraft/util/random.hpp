@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <vector>
+#include <memory_resource>
 
 #include "wyhash.h"
 
@@ -23,5 +24,7 @@ namespace PixCraft {
 
 	// Samples a Poisson-disk distribution with radius minDist, returning the interleaved coordinates of a number of points,
 	// such that objects with a given size placed at these points overlap the square with corner (minX, minZ) and size chunkSize.
-	std::vector<float> distributeObjects(uint64_t seed, float minX, float minZ, float chunkSize, float minDist, float size);
+	// The points are allocated from memory, e.g. a buffer on the caller's stack.
+	std::pmr::vector<float> distributeObjects(uint64_t seed, float minX, float minZ, float chunkSize, float minDist, float size,
+		std::pmr::memory_resource* memory = std::pmr::get_default_resource());
 }
@@ -0,0 +1,177 @@
+#include "trace.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace PixCraft;
+
+namespace PixCraft::Trace {
+	namespace {
+		typedef std::chrono::steady_clock Clock;
+		const Clock::time_point epoch = Clock::now();
+		
+		struct TraceEvent {
+			const char* name;
+			int64_t start;
+			int64_t value; // duration in ns, or counter value
+			bool isCounter;
+		};
+		
+		// An event in a ring buffer; its fields are atomic because dumps read them while the thread may be overwriting them
+		struct TraceSlot {
+			std::atomic<const char*> name;
+			std::atomic<int64_t> start;
+			std::atomic<int64_t> value;
+			std::atomic<bool> isCounter;
+		};
+		
+		// Only its thread writes to a buffer; dumps read it concurrently, and drop the events that may have been overwritten
+		struct ThreadBuffer {
+			std::unique_ptr<TraceSlot[]> events;
+			std::atomic<uint64_t> head; // number of events written so far
+			uint32_t tid;
+			const char* name;
+			std::atomic<bool> finished; // its thread exited, so it can be given to a new thread
+		};
+		
+		std::mutex buffersMutex;
+		std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+		uint32_t nextTid = 1;
+		
+		ThreadBuffer* registerThread() {
+			std::lock_guard<std::mutex> lock(buffersMutex);
+			for(auto& buffer : buffers) {
+				if(buffer->finished.load(std::memory_order_acquire)) {
+					buffer->head.store(0, std::memory_order_relaxed);
+					buffer->tid = nextTid++;
+					buffer->name = nullptr;
+					buffer->finished.store(false, std::memory_order_relaxed);
+					return buffer.get();
+				}
+			}
+			buffers.emplace_back(new ThreadBuffer());
+			ThreadBuffer* buffer = buffers.back().get();
+			buffer->events.reset(new TraceSlot[TRACE_BUFFER_EVENTS]);
+			buffer->head.store(0, std::memory_order_relaxed);
+			buffer->tid = nextTid++;
+			buffer->name = nullptr;
+			buffer->finished.store(false, std::memory_order_relaxed);
+			return buffer;
+		}
+		
+		struct ThreadBufferHandle {
+			ThreadBuffer* buffer = nullptr;
+			
+			~ThreadBufferHandle() {
+				if(buffer != nullptr) buffer->finished.store(true, std::memory_order_release);
+			}
+		};
+		
+		thread_local ThreadBufferHandle threadBuffer;
+		
+		ThreadBuffer& getThreadBuffer() {
+			if(threadBuffer.buffer == nullptr) threadBuffer.buffer = registerThread();
+			return *threadBuffer.buffer;
+		}
+		
+		void record(TraceEvent event) {
+			ThreadBuffer& buffer = getThreadBuffer();
+			uint64_t head = buffer.head.load(std::memory_order_relaxed);
+			// A dump that sees any of the writes below also sees head, and so knows this slot is being overwritten
+			std::atomic_thread_fence(std::memory_order_release);
+			TraceSlot& slot = buffer.events[head % TRACE_BUFFER_EVENTS];
+			slot.name.store(event.name, std::memory_order_relaxed);
+			slot.start.store(event.start, std::memory_order_relaxed);
+			slot.value.store(event.value, std::memory_order_relaxed);
+			slot.isCounter.store(event.isCounter, std::memory_order_relaxed);
+			buffer.head.store(head + 1, std::memory_order_release);
+		}
+		
+		void writeName(std::ofstream& file, const char* name) {
+			file << '"';
+			for(const char* c = name; *c != '\0'; ++c) {
+				if(*c == '"' || *c == '\\') file << '\\';
+				file << *c;
+			}
+			file << '"';
+		}
+	}
+	
+	int64_t now() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch).count();
+	}
+	
+	void complete(const char* name, int64_t start, int64_t end) {
+		record({ name, start, end - start, false });
+	}
+	
+	void counter(const char* name, int64_t value) {
+		record({ name, now(), value, true });
+	}
+	
+	void threadName(const char* name) {
+		getThreadBuffer().name = name;
+	}
+	
+	size_t writeChromeTrace(std::string path) {
+		std::ofstream file(path.c_str());
+		if(!file) throw std::runtime_error("Can't open trace file " + path);
+		file << std::fixed << std::setprecision(3);
+		file << "{\"traceEvents\":[" << std::endl;
+		
+		size_t count = 0;
+		bool first = true;
+		auto separate = [&]() {
+			if(!first) file << "," << std::endl;
+			first = false;
+		};
+		
+		std::lock_guard<std::mutex> lock(buffersMutex);
+		std::vector<TraceEvent> events;
+		for(auto& buffer : buffers) {
+			uint64_t end = buffer->head.load(std::memory_order_acquire);
+			uint64_t start = end > TRACE_BUFFER_EVENTS ? end - TRACE_BUFFER_EVENTS : 0;
+			events.clear();
+			for(uint64_t i = start; i < end; ++i) {
+				TraceSlot& slot = buffer->events[i % TRACE_BUFFER_EVENTS];
+				events.push_back({ slot.name.load(std::memory_order_relaxed), slot.start.load(std::memory_order_relaxed),
+					slot.value.load(std::memory_order_relaxed), slot.isCounter.load(std::memory_order_relaxed) });
+			}
+			// The thread may have kept writing over the oldest events while they were copied, including the event
+			// at newEnd, which may be half written
+			std::atomic_thread_fence(std::memory_order_acquire);
+			uint64_t newEnd = buffer->head.load(std::memory_order_acquire);
+			size_t skipped = newEnd + 1 > start + TRACE_BUFFER_EVENTS ? std::min(newEnd + 1 - start - TRACE_BUFFER_EVENTS, end - start) : 0;
+			
+			if(buffer->name != nullptr) {
+				separate();
+				file << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->tid << ",\"args\":{\"name\":";
+				writeName(file, buffer->name);
+				file << "}}";
+			}
+			for(size_t i = skipped; i < events.size(); ++i) {
+				TraceEvent& event = events[i];
+				separate();
+				file << "{\"ph\":\"" << (event.isCounter ? "C" : "X") << "\",\"name\":";
+				writeName(file, event.name);
+				file << ",\"pid\":1,\"tid\":" << buffer->tid << ",\"ts\":" << event.start / 1000.0;
+				if(event.isCounter) {
+					file << ",\"args\":{\"value\":" << event.value << "}}";
+				} else {
+					file << ",\"dur\":" << event.value / 1000.0 << "}";
+				}
+				count++;
+			}
+		}
+		
+		file << std::endl << "]}" << std::endl;
+		return count;
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Timeline tracing, compiled in with -DPIXCRAFT_TRACING (make tracing) and out otherwise.
+// Each thread records its events in its own ring buffer, which keeps the latest TRACE_BUFFER_EVENTS.
+#ifdef PIXCRAFT_TRACING
+	#define TRACE_CONCAT_IMPL(a, b) a##b
+	#define TRACE_CONCAT(a, b) TRACE_CONCAT_IMPL(a, b)
+	// Records the time until the end of the enclosing scope; the name must be a string literal
+	#define TRACE_SCOPE(name) PixCraft::Trace::Scope TRACE_CONCAT(traceScope, __LINE__)(name)
+	#define TRACE_COUNTER(name, value) PixCraft::Trace::counter(name, (int64_t) (value))
+	#define TRACE_THREAD_NAME(name) PixCraft::Trace::threadName(name)
+#else
+	#define TRACE_SCOPE(name)
+	#define TRACE_COUNTER(name, value)
+	#define TRACE_THREAD_NAME(name)
+#endif
+
+namespace PixCraft {
+	#define TRACE_BUFFER_EVENTS 65536
+	
+	namespace Trace {
+		#ifdef PIXCRAFT_TRACING
+		const bool ENABLED = true;
+		#else
+		const bool ENABLED = false;
+		#endif
+		
+		int64_t now(); // in ns
+		void complete(const char* name, int64_t start, int64_t end);
+		void counter(const char* name, int64_t value);
+		void threadName(const char* name);
+		
+		// Writes the events of all threads in the Chrome trace format, which Perfetto and chrome://tracing can open,
+		// and returns how many there were
+		size_t writeChromeTrace(std::string path);
+		
+		class Scope {
+		public:
+			Scope(const char* name) : name(name), start(now()) { }
+			~Scope() { complete(name, start, now()); }
+		
+		private:
+			const char* name;
+			int64_t start;
+		};
+	}
+}
@@ -2,6 +2,7 @@
 
 #include <cmath>
 #include <cstdio>
+#include <algorithm>
 #include <limits>
 #include <stdexcept>
 
@@ -125,6 +126,7 @@ int PixCraft::Ray::getY() { return y; }
 int PixCraft::Ray::getZ() { return z; }
 float PixCraft::Ray::getDistance() { return dist; }
 int PixCraft::Ray::getLastFace() { return lastFace; }
+int PixCraft::Ray::getStepY() { return stepY; }
 
 void PixCraft::Ray::nextFace() {
 	if(tMaxX < tMaxY && tMaxX < tMaxZ) { // next face on X axis
@@ -145,6 +147,49 @@ void PixCraft::Ray::nextFace() {
 	}
 }
 
+float PixCraft::Ray::getExitDistance(int minX, int minY, int minZ, int maxX, int maxY, int maxZ) {
+	// The ray leaves the box on the last face it crosses along the axis that runs out of cells first.
+	float exitX = std::numeric_limits<float>::infinity();
+	float exitY = std::numeric_limits<float>::infinity();
+	float exitZ = std::numeric_limits<float>::infinity();
+	if(stepX != 0) exitX = tMaxX + (stepX > 0 ? maxX - x : x - minX)*tDeltaX;
+	if(stepY != 0) exitY = tMaxY + (stepY > 0 ? maxY - y : y - minY)*tDeltaY;
+	if(stepZ != 0) exitZ = tMaxZ + (stepZ > 0 ? maxZ - z : z - minZ)*tDeltaZ;
+	return std::min(exitX, std::min(exitY, exitZ));
+}
+
+void PixCraft::Ray::skipTo(float t) {
+	float lastX = -1, lastY = -1, lastZ = -1;
+	if(tMaxX <= t) {
+		int n = (int) ((t - tMaxX) / tDeltaX) + 1;
+		lastX = tMaxX + (n-1)*tDeltaX;
+		tMaxX += n*tDeltaX;
+		x += n*stepX;
+	}
+	if(tMaxY <= t) {
+		int n = (int) ((t - tMaxY) / tDeltaY) + 1;
+		lastY = tMaxY + (n-1)*tDeltaY;
+		tMaxY += n*tDeltaY;
+		y += n*stepY;
+	}
+	if(tMaxZ <= t) {
+		int n = (int) ((t - tMaxZ) / tDeltaZ) + 1;
+		lastZ = tMaxZ + (n-1)*tDeltaZ;
+		tMaxZ += n*tDeltaZ;
+		z += n*stepZ;
+	}
+	if(lastX > dist && lastX >= lastY && lastX >= lastZ) {
+		dist = lastX;
+		lastFace = 2 + stepX;
+	} else if(lastY > dist && lastY >= lastZ) {
+		dist = lastY;
+		lastFace = 4 + (1-stepY)/2;
+	} else if(lastZ > dist) {
+		dist = lastZ;
+		lastFace = 1 + stepZ;
+	}
+}
+
 
 std::tuple<int,int,int> PixCraft::getBlockCoordsAt(glm::vec3 pos) {
 	return std::tuple<int,int,int>(getBlockCoordAt(pos.x), getBlockCoordAt(pos.y), getBlockCoordAt(pos.z));
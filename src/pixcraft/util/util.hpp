@@ -4,6 +4,7 @@
 #include <tuple>
 #include <utility>
 #include <unordered_set>
+#include <memory_resource>
 
 #include "pixcraft/util/glm.hpp"
 
@@ -16,11 +17,13 @@ namespace PixCraft {
 	
 	struct BlockPosHash : public std::unary_function<BlockPos, std::size_t> {
 		std::size_t operator()(const BlockPos& k) const {
-			return std::get<0>(k) ^ std::get<1>(k) ^ std::get<2>(k);
+			// Light updates mark whole areas dirty, which a plain xor would put in few buckets
+			return ((size_t) std::get<0>(k) * 73856093) ^ ((size_t) std::get<1>(k) * 19349663) ^ ((size_t) std::get<2>(k) * 83492791);
 		}
 	};
 	
-	typedef std::unordered_set<BlockPos, BlockPosHash> BlockPosSet;
+	typedef std::pmr::unordered_set<BlockPos, BlockPosHash> BlockPosSet;
+	typedef std::pmr::unordered_set<uint64_t> ChunkIdxSet;
 	
 	glm::mat4 globalToLocalRot(glm::vec3 orient);
 	glm::mat4 localToGlobalRot(glm::vec3 orient);
@@ -61,8 +64,14 @@ namespace PixCraft {
 		int getZ();
 		float getDistance();
 		int getLastFace();
+		int getStepY();
 		
 		void nextFace();
+		
+		// returns the distance at which the ray leaves the box of cells [min, max] it is currently in
+		float getExitDistance(int minX, int minY, int minZ, int maxX, int maxY, int maxZ);
+		// crosses every face up to distance t at once, as if nextFace() had been called repeatedly
+		void skipTo(float t);
 
 	private:
 		float tDeltaX, tDeltaY, tDeltaZ;
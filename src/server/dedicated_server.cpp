@@ -0,0 +1,179 @@
+// Headless server, built by "make server": runs a world at a fixed tick rate, without a window, GL or GLFW.
+// Usage: pixcraft_server [--world <world.bin>] [--seed <seed>] [--tps <ticks per second>] [--radius <chunks>] [--ticks <count>]
+// The chunks within the radius of the spawn and of the players in the world are kept loaded.
+// The world is loaded from its file if it exists, saved in the background every few minutes, and saved on exit,
+// which happens after the given number of ticks, or on Ctrl+C.
+
+#include <cstdint>
+#include <cstdlib>
+#include <csignal>
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <string>
+#include <tuple>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <stdexcept>
+
+#include "pixcraft/util/glm.hpp"
+#include "pixcraft/util/version.hpp"
+#include "pixcraft/util/jobs.hpp"
+#include "pixcraft/util/frame_arena.hpp"
+#include "pixcraft/server/world.hpp"
+#include "pixcraft/server/blocks.hpp"
+#include "pixcraft/server/player.hpp"
+#include "pixcraft/server/slime.hpp"
+
+using namespace PixCraft;
+
+#define SERVER_DEFAULT_TPS 20
+#define SERVER_DEFAULT_RADIUS 8
+#define SERVER_MAX_CATCH_UP_TICKS 10 // ticks run back to back when the server fell behind, before giving up on them
+#define SERVER_STATUS_SECONDS 10
+#define SERVER_AUTOSAVE_SECONDS 300
+
+namespace {
+	typedef std::chrono::steady_clock Clock;
+	
+	const glm::vec3 spawnPos(8.0f, 50.0f, 8.0f);
+	
+	volatile std::sig_atomic_t stopRequested = 0;
+	
+	void requestStop(int signal) {
+		stopRequested = 1;
+	}
+	
+	bool fileExists(const std::string& path) {
+		return std::ifstream(path.c_str()).good();
+	}
+	
+	// Requests the chunks missing around the spawn and the players; they're added in Jobs::runCompletions
+	void loadChunks(World& world, int radius) {
+		std::vector<glm::vec3> centers { spawnPos };
+		for(auto& mob : world.mobs) {
+			if(dynamic_cast<Player*>(mob.get())) centers.push_back(mob->pos());
+		}
+		for(glm::vec3& center : centers) {
+			int32_t centerX, centerZ;
+			std::tie(centerX, centerZ) = World::getChunkPosAt((int32_t) std::floor(center.x), (int32_t) std::floor(center.z));
+			for(int32_t chunkX = centerX - radius; chunkX <= centerX + radius; ++chunkX) {
+				for(int32_t chunkZ = centerZ - radius; chunkZ <= centerZ + radius; ++chunkZ) {
+					if(!world.isChunkLoaded(chunkX, chunkZ) && !world.isChunkRequested(chunkX, chunkZ)) {
+						world.requestChunk(chunkX, chunkZ);
+					}
+				}
+			}
+		}
+	}
+	
+	void tick(World& world, int radius, float dt) {
+		Jobs::runCompletions();
+		loadChunks(world, radius);
+		world.updateBlocks();
+		world.updateEntities(dt);
+		// The client meshes the changed blocks and chunks; here nothing uses them, but they must still be taken
+		// every tick so that the sets don't grow
+		world.retrieveDirtyBlocks();
+		world.retrieveDirtyChunks();
+		frameArena().endFrame();
+	}
+}
+
+int main(int argc, char** argv) {
+	std::string worldPath;
+	uint64_t seed = 0;
+	bool hasSeed = false;
+	int ticksPerSecond = SERVER_DEFAULT_TPS;
+	int radius = SERVER_DEFAULT_RADIUS;
+	int64_t maxTicks = -1;
+	for(int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if(arg == "--world" && i + 1 < argc) worldPath = argv[++i];
+		else if(arg == "--seed" && i + 1 < argc) { seed = strtoull(argv[++i], nullptr, 10); hasSeed = true; }
+		else if(arg == "--tps" && i + 1 < argc) ticksPerSecond = std::max(1, atoi(argv[++i]));
+		else if(arg == "--radius" && i + 1 < argc) radius = std::max(0, atoi(argv[++i]));
+		else if(arg == "--ticks" && i + 1 < argc) maxTicks = std::max(0, atoi(argv[++i]));
+		else std::cout << "Unknown argument " << arg << std::endl;
+	}
+	
+	std::signal(SIGINT, requestStop);
+	std::signal(SIGTERM, requestStop);
+	
+	try {
+		std::cout << "PixCraft server " << getVersionString() << std::endl;
+		BlockRegistry::defineBlocks();
+		
+		std::unique_ptr<World> world(hasSeed ? new World(seed) : new World());
+		if(!worldPath.empty() && fileExists(worldPath)) {
+			world->loadFromFile(worldPath);
+			std::cout << "Loaded world from " << worldPath << "." << std::endl;
+		} else {
+			// Same as the client's new worlds; world files have a player, which the client takes control of when loading them
+			world->mobs.emplace_back(new Player(*world, spawnPos));
+			world->mobs.emplace_back(new Slime(*world, glm::vec3(0.0f, 50.0f, 0.0f)));
+		}
+		std::cout << "Running at " << ticksPerSecond << " ticks per second, with seed " << world->seed()
+			<< " and " << Jobs::threadCount() << " worker threads." << std::endl;
+		
+		const Clock::duration tickDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / ticksPerSecond));
+		const float dt = 1.0f / ticksPerSecond;
+		Clock::time_point nextTick = Clock::now();
+		Clock::time_point lastSave = nextTick;
+		int64_t tickNo = 0;
+		
+		// Tick times since the last status
+		int64_t statusTicks = 0, skippedTicks = 0;
+		double totalTickMs = 0.0, maxTickMs = 0.0;
+		Clock::time_point lastStatus = nextTick;
+		
+		while(!stopRequested && tickNo != maxTicks) {
+			Clock::time_point start = Clock::now();
+			tick(*world, radius, dt);
+			Clock::time_point end = Clock::now();
+			tickNo++;
+			
+			double tickMs = std::chrono::duration<double, std::milli>(end - start).count();
+			statusTicks++;
+			totalTickMs += tickMs;
+			maxTickMs = std::max(maxTickMs, tickMs);
+			
+			if(end - lastStatus >= std::chrono::seconds(SERVER_STATUS_SECONDS)) {
+				std::cout << std::fixed << std::setprecision(2) << "Tick " << tickNo << ": " << world->loadedChunkCount() << " chunks, "
+					<< world->mobs.size() << " mobs, " << totalTickMs / statusTicks << " ms per tick on average, " << maxTickMs << " at most";
+				if(skippedTicks != 0) std::cout << ", " << skippedTicks << " ticks skipped";
+				std::cout << std::endl;
+				statusTicks = skippedTicks = 0;
+				totalTickMs = maxTickMs = 0.0;
+				lastStatus = end;
+			}
+			if(!worldPath.empty() && end - lastSave >= std::chrono::seconds(SERVER_AUTOSAVE_SECONDS)) {
+				world->saveToFileInBackground(worldPath);
+				lastSave = end;
+			}
+			
+			// Ticks that are late run right away, so that the simulation keeps up with the clock, unless it's too far behind
+			nextTick += tickDuration;
+			if(end - nextTick > SERVER_MAX_CATCH_UP_TICKS * tickDuration) {
+				int64_t skipped = (end - nextTick) / tickDuration;
+				skippedTicks += skipped;
+				nextTick += skipped * tickDuration;
+			}
+			std::this_thread::sleep_until(nextTick);
+		}
+		
+		if(!worldPath.empty()) {
+			world->saveToFile(worldPath);
+			std::cout << "Saved world to " << worldPath << "." << std::endl;
+		}
+	} catch(std::runtime_error& err) {
+		std::cout << "A runtime error occured: " << err.what() << std::endl;
+		return 1;
+	}
+	
+	return 0;
+}